@@ -99,6 +99,10 @@ union side_arg_static {
 		side_ptr_t(const void) ptr;
 		side_ptr_t(const void) length_ptr;
 	} SIDE_PACKED side_vla_gather;
+	struct {
+		side_ptr_t(const void) ptr;
+		side_ptr_t(const void) length_ptr;
+	} SIDE_PACKED side_iovec_gather;
 	side_padding(32);
 } SIDE_PACKED;
 side_check_size(union side_arg_static, 32);
@@ -135,6 +139,34 @@ struct side_arg_dynamic_vla_visitor {
 } SIDE_PACKED;
 side_check_size(struct side_arg_dynamic_vla_visitor, 68);
 
+/*
+ * Registered dynamic structure shape. The shape is a libside-owned
+ * copy of the dynamic structure passed at registration: field names,
+ * types and attributes. Its values are ignored. The id is unique
+ * within the process for the lifetime of the library, allowing tracers
+ * to emit the shape once per stream and refer to it by id afterwards.
+ */
+struct side_dynamic_struct_schema {
+	uint64_t id;
+	side_ptr_t(const struct side_arg_dynamic_struct) shape;
+} SIDE_PACKED;
+side_check_size(struct side_dynamic_struct_schema, 24);
+
+/*
+ * Value of a dynamic structure field described by a schema. The value
+ * layout (integer size, bool size, string unit size, ...) is the one
+ * of the corresponding schema field type.
+ */
+union side_arg_dynamic_value {
+	union side_bool_value bool_value;
+	uint8_t byte_value;
+	side_ptr_t(const void) string_value;	/* const {uint8_t, uint16_t, uint32_t} * */
+	union side_integer_value integer_value;
+	union side_float_value float_value;
+	side_padding(32);
+} SIDE_PACKED;
+side_check_size(union side_arg_dynamic_value, 32);
+
 union side_arg_dynamic {
 	/* Dynamic basic types */
 	struct side_type_null side_null;
@@ -162,6 +194,11 @@ union side_arg_dynamic {
 	/* Dynamic compound types */
 	side_ptr_t(const struct side_arg_dynamic_struct) side_dynamic_struct;
 	side_ptr_t(const struct side_arg_dynamic_vla) side_dynamic_vla;
+	struct {
+		side_ptr_t(const struct side_dynamic_struct_schema) schema;
+		side_ptr_t(const union side_arg_dynamic_value) values;
+		uint32_t len;
+	} SIDE_PACKED side_dynamic_struct_schema;
 
 	/* Pointer to non-const structure. Content modified by libside. */
 	side_ptr_t(struct side_arg_dynamic_struct_visitor) side_dynamic_struct_visitor;
@@ -40,8 +40,11 @@
  *   the data should be fetched.
  *
  *   This type system can be used as an event field, or nested within
- *   the stack-copy type system. Nesting of gather-vla within
- *   gather-array and gather-vla types is not allowed.
+ *   the stack-copy type system. Gather-vla elements of gather-array
+ *   and gather-vla types are described by a gather-struct holding the
+ *   gather-vla as a field: the gather-struct size is the record stride,
+ *   and the gather-vla length and elements are located relative to the
+ *   start of each record.
  *
  *   This type system is has the least overhead of the 3 type systems.
  *
@@ -152,6 +155,13 @@ enum side_type_label {
 	SIDE_TYPE_DYNAMIC_VLA,
 	SIDE_TYPE_DYNAMIC_VLA_VISITOR,
 
+	/*
+	 * Labels added after the initial ABI are appended here, so the
+	 * numeric value of existing labels never changes.
+	 */
+	SIDE_TYPE_GATHER_IOVEC,
+	SIDE_TYPE_DYNAMIC_STRUCT_SCHEMA,
+
 	_NR_SIDE_TYPE_LABEL,	/* Last entry. */
 };
 
@@ -335,6 +345,34 @@ struct side_type_gather_vla {
 } SIDE_PACKED;
 side_check_size(struct side_type_gather_vla, 9 + sizeof(struct side_type_vla));
 
+/*
+ * Segment of a gather iovec, laid out in application memory. Its
+ * layout does not depend on the architecture, unlike "struct iovec".
+ */
+struct side_iovec {
+	side_ptr_t(const void) base;
+	uint64_t len;		/* bytes */
+} SIDE_PACKED;
+side_check_size(struct side_iovec, 24);
+
+/*
+ * Scatter-gather list of "struct side_iovec" segments. The segment
+ * array is located at offset from the base pointer (inline array with
+ * direct access, pointer to array with pointer access), and the number
+ * of segments is fetched through length_type. Only the first
+ * capture_max bytes of the segment payload are recorded, or the whole
+ * payload if capture_max is 0.
+ */
+struct side_type_gather_iovec {
+	uint64_t offset;	/* bytes */
+	side_enum_t(enum side_type_gather_access_mode, uint8_t) access_mode;
+	uint64_t capture_max;	/* bytes */
+	/* Use side_length() for length_type. */
+	side_ptr_t(const struct side_type) length_type;
+	side_array_t(const struct side_attr) attributes;
+} SIDE_PACKED;
+side_check_size(struct side_type_gather_iovec, 53);
+
 struct side_type_gather {
 	union {
 		struct side_type_gather_bool side_bool;
@@ -345,6 +383,7 @@ struct side_type_gather {
 		struct side_type_gather_enum side_enum;
 		struct side_type_gather_array side_array;
 		struct side_type_gather_vla side_vla;
+		struct side_type_gather_iovec side_iovec;
 		struct side_type_gather_struct side_struct;
 		side_padding(61);
 	} SIDE_PACKED u;
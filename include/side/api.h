@@ -53,6 +53,7 @@
 #define side_attr_string _side_attr_string
 #define side_attr_string16 _side_attr_string16
 #define side_attr_string32 _side_attr_string32
+#define side_attr_format _side_attr_format
 
 /* Fields. */
 #define side_field_list _side_field_list
@@ -307,6 +308,9 @@
 #define side_field_gather_vla _side_field_gather_vla
 #define side_arg_gather_vla _side_arg_gather_vla
 
+#define side_field_gather_iovec _side_field_gather_iovec
+#define side_arg_gather_iovec _side_arg_gather_iovec
+
 /* Dynamic. */
 #define side_unwrap_dynamic_field(_type, _name, _val)	\
 	_side_arg_dynamic_field(_name, side_unwrap_dynamic(_type, _val))
@@ -387,6 +391,27 @@
 
 #define side_arg_dynamic_struct(...) _side_arg_dynamic_struct(__VA_ARGS__)
 
+#define side_arg_dynamic_define_struct_schema_values(_identifier, _values) \
+	_side_arg_dynamic_define_struct_schema_values(_identifier, SIDE_PARAM(_values))
+#define side_arg_dynamic_struct_schema(_schema, _values) \
+	_side_arg_dynamic_struct_schema(_schema, _values, SIDE_ARRAY_SIZE(_values))
+
+#define side_dynamic_value_list _side_dynamic_value_list
+#define side_dynamic_value_bool _side_dynamic_value_bool
+#define side_dynamic_value_byte _side_dynamic_value_byte
+#define side_dynamic_value_pointer _side_dynamic_value_pointer
+#define side_dynamic_value_u8 _side_dynamic_value_u8
+#define side_dynamic_value_u16 _side_dynamic_value_u16
+#define side_dynamic_value_u32 _side_dynamic_value_u32
+#define side_dynamic_value_u64 _side_dynamic_value_u64
+#define side_dynamic_value_s8 _side_dynamic_value_s8
+#define side_dynamic_value_s16 _side_dynamic_value_s16
+#define side_dynamic_value_s32 _side_dynamic_value_s32
+#define side_dynamic_value_s64 _side_dynamic_value_s64
+#define side_dynamic_value_float_binary32 _side_dynamic_value_float_binary32
+#define side_dynamic_value_float_binary64 _side_dynamic_value_float_binary64
+#define side_dynamic_value_string _side_dynamic_value_string
+
 
 #define side_arg_dynamic_define_struct_visitor _side_arg_dynamic_define_struct_visitor
 #define side_arg_dynamic_struct_visitor(...) _side_arg_dynamic_struct_visitor(__VA_ARGS__)
@@ -502,6 +527,10 @@
 	_side_type_gather_vla(SIDE_PARAM(_elem_type_gather), _offset, _access_mode, \
 			      SIDE_PARAM(_length_type_gather), SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list()))
 
+#define side_type_gather_iovec(_offset, _access_mode, _length_type_gather, _capture_max, _attr...) \
+	_side_type_gather_iovec(_offset, _access_mode, SIDE_PARAM(_length_type_gather), _capture_max, \
+				SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list()))
+
 /* Variant. */
 #define side_define_variant _side_define_variant
 #define side_arg_define_variant _side_arg_define_variant
@@ -569,15 +598,19 @@
 
 /* Event. */
 #define side_event_call(_identifier, _sav)		\
-	_side_event_call(side_call, _identifier, SIDE_PARAM(_sav))
+	SIDE_EVENT_CALL_SITE(_side_event_call(side_call, _identifier, SIDE_PARAM(_sav)))
 
 #define side_event_call_variadic(_identifier, _sav, _var_fields, _attr...) \
-	_side_event_call_variadic(side_call_variadic, _identifier,	\
+	SIDE_EVENT_CALL_SITE(_side_event_call_variadic(side_call_variadic, _identifier, \
 				  SIDE_PARAM(_sav), SIDE_PARAM(_var_fields), \
-				  SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list()))
+				  SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list())))
 
 #define side_event _side_event
 #define side_event_variadic _side_event_variadic
+#define side_event_lazy _side_event_lazy
+#define side_event_call_batch _side_event_call_batch
+#define side_arg_fill(_identifier, _sav, _len, _args)			\
+	_side_arg_fill(_identifier, _sav, _len, SIDE_PARAM(_args))
 
 #define side_static_event _side_static_event
 #define side_static_event_variadic _side_static_event_variadic
@@ -587,6 +620,30 @@
 #define side_export_event_variadic _side_export_event_variadic
 #define side_declare_event _side_declare_event
 
+/*
+ * Span events have the "start" and "duration" u64 fields expected by
+ * side_span(). Span events are also declared with
+ * side_declare_span_event() to be used by side_span() from other
+ * compile units.
+ */
+#define side_static_span_event(_identifier, _provider, _event, _loglevel, _attr...) \
+	typedef struct side_span side_span_type__##_identifier;	\
+	side_static_event(_identifier, _provider, _event, _loglevel,	\
+		side_field_list(side_field_u64("start"), side_field_u64("duration")), ##_attr)
+#define side_hidden_span_event(_identifier, _provider, _event, _loglevel, _attr...) \
+	typedef struct side_span side_span_type__##_identifier;	\
+	side_hidden_event(_identifier, _provider, _event, _loglevel,	\
+		side_field_list(side_field_u64("start"), side_field_u64("duration")), ##_attr)
+#define side_export_span_event(_identifier, _provider, _event, _loglevel, _attr...) \
+	typedef struct side_span side_span_type__##_identifier;	\
+	side_export_event(_identifier, _provider, _event, _loglevel,	\
+		side_field_list(side_field_u64("start"), side_field_u64("duration")), ##_attr)
+#define side_declare_span_event(_identifier)				\
+	typedef struct side_span side_span_type__##_identifier;	\
+	side_declare_event(_identifier)
+
+#define side_span _side_span
+
 /*
  * Define SIDE_STATIC_CHECK_DISABLE to opt-out from static checking,
  * in case it does not work on your specific compiler or slows down
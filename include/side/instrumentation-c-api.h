@@ -77,6 +77,13 @@
 #define _side_attr_string16(_val)	__side_attr_string(_val, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uint16_t))
 #define _side_attr_string32(_val)	__side_attr_string(_val, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uint32_t))
 
+/*
+ * Format events: printf-style format string of an event whose fields are
+ * the format arguments. Arguments are captured in binary, and formatting
+ * is left to the consumer.
+ */
+#define _side_attr_format(_fmt)		_side_attr("lang.c.format", _side_attr_string(_fmt))
+
 /* Stack-copy enumeration type definitions */
 
 #define side_define_enum(_identifier, _mappings, _attr...) \
@@ -1013,6 +1020,26 @@ enum {
 #define _side_field_gather_vla(_name, _elem_type_gather, _offset, _access_mode, _length_type_gather, _attr...) \
 	_side_field(_name, _side_type_gather_vla(SIDE_PARAM(_elem_type_gather), _offset, _access_mode, SIDE_PARAM(_length_type_gather), SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list())))
 
+#define _side_type_gather_iovec(_offset, _access_mode, _length_type_gather, _capture_max, _attr...) \
+	{ \
+		.type = SIDE_ENUM_INIT(SIDE_TYPE_GATHER_IOVEC), \
+		.u = { \
+			.side_gather = { \
+				.u = { \
+					.side_iovec = { \
+						.offset = _offset, \
+						.access_mode = SIDE_ENUM_INIT(_access_mode), \
+						.capture_max = _capture_max, \
+						.length_type = SIDE_PTR_INIT(_length_type_gather), \
+						.attributes = SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list()), \
+					}, \
+				}, \
+			}, \
+		}, \
+	}
+#define _side_field_gather_iovec(_name, _offset, _access_mode, _length_type_gather, _capture_max, _attr...) \
+	_side_field(_name, _side_type_gather_iovec(_offset, _access_mode, SIDE_PARAM(_length_type_gather), _capture_max, SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list())))
+
 #define _side_elem(...) \
 	SIDE_COMPOUND_LITERAL(const struct side_type, __VA_ARGS__)
 
@@ -1117,6 +1144,7 @@ enum {
 #define _side_arg_gather_struct(_ptr)		{ .type = SIDE_ENUM_INIT(SIDE_TYPE_GATHER_STRUCT), .flags = 0, .u = { .side_static = { .side_struct_gather_ptr = SIDE_PTR_INIT(_ptr) } } }
 #define _side_arg_gather_array(_ptr)		{ .type = SIDE_ENUM_INIT(SIDE_TYPE_GATHER_ARRAY), .flags = 0, .u = { .side_static = { .side_array_gather_ptr = SIDE_PTR_INIT(_ptr) } } }
 #define _side_arg_gather_vla(_ptr, _length_ptr)	{ .type = SIDE_ENUM_INIT(SIDE_TYPE_GATHER_VLA), .flags = 0, .u = { .side_static = { .side_vla_gather = { .ptr = SIDE_PTR_INIT(_ptr), .length_ptr = SIDE_PTR_INIT(_length_ptr) } } } }
+#define _side_arg_gather_iovec(_ptr, _length_ptr)	{ .type = SIDE_ENUM_INIT(SIDE_TYPE_GATHER_IOVEC), .flags = 0, .u = { .side_static = { .side_iovec_gather = { .ptr = SIDE_PTR_INIT(_ptr), .length_ptr = SIDE_PTR_INIT(_length_ptr) } } } }
 
 /* Dynamic field arguments */
 
@@ -1359,6 +1387,41 @@ enum {
 		}, \
 	}
 
+#define _side_arg_dynamic_struct_schema(_schema, _values, _len) \
+	{ \
+		.type = SIDE_ENUM_INIT(SIDE_TYPE_DYNAMIC_STRUCT_SCHEMA), \
+		.flags = 0, \
+		.u = { \
+			.side_dynamic = { \
+				.side_dynamic_struct_schema = { \
+					.schema = SIDE_PTR_INIT(_schema), \
+					.values = SIDE_PTR_INIT(_values), \
+					.len = _len, \
+				}, \
+			}, \
+		}, \
+	}
+
+#define _side_arg_dynamic_define_struct_schema_values(_identifier, _values) \
+	const union side_arg_dynamic_value _identifier[] = { _values }
+
+#define _side_dynamic_value_list(...)	__VA_ARGS__
+
+#define _side_dynamic_value_bool(_val)		{ .bool_value = { .side_bool8 = !!(_val) } }
+#define _side_dynamic_value_byte(_val)		{ .byte_value = (uint8_t) (_val) }
+#define _side_dynamic_value_pointer(_val)	{ .integer_value = { .side_uptr = (uintptr_t) (_val) } }
+#define _side_dynamic_value_u8(_val)		{ .integer_value = { .side_u8 = (uint8_t) (_val) } }
+#define _side_dynamic_value_u16(_val)		{ .integer_value = { .side_u16 = (uint16_t) (_val) } }
+#define _side_dynamic_value_u32(_val)		{ .integer_value = { .side_u32 = (uint32_t) (_val) } }
+#define _side_dynamic_value_u64(_val)		{ .integer_value = { .side_u64 = (uint64_t) (_val) } }
+#define _side_dynamic_value_s8(_val)		{ .integer_value = { .side_s8 = (int8_t) (_val) } }
+#define _side_dynamic_value_s16(_val)		{ .integer_value = { .side_s16 = (int16_t) (_val) } }
+#define _side_dynamic_value_s32(_val)		{ .integer_value = { .side_s32 = (int32_t) (_val) } }
+#define _side_dynamic_value_s64(_val)		{ .integer_value = { .side_s64 = (int64_t) (_val) } }
+#define _side_dynamic_value_float_binary32(_val)	{ .float_value = { .side_float_binary32 = (_val) } }
+#define _side_dynamic_value_float_binary64(_val)	{ .float_value = { .side_float_binary64 = (_val) } }
+#define _side_dynamic_value_string(_val)	{ .string_value = SIDE_PTR_INIT(_val) }
+
 #define _side_arg_dynamic_struct_visitor(_dynamic_struct_visitor) \
 	{ \
 		.type = SIDE_ENUM_INIT(SIDE_TYPE_DYNAMIC_STRUCT_VISITOR), \
@@ -1423,21 +1486,107 @@ enum {
 #define _side_arg_list(...)	__VA_ARGS__
 
 #define side_event_enabled(_identifier) \
-	side_unlikely(__atomic_load_n(&side_event_state__##_identifier.enabled, \
+	side_unlikely(__atomic_load_n(&side_event_enabled__##_identifier, \
 					__ATOMIC_RELAXED))
 
+/*
+ * Out-of-line event calls. When SIDE_EVENT_OUTLINE is defined,
+ * side_event_call(), side_event_call_variadic() and the enabled branch
+ * of side_event() and side_event_variadic() call a cold, non-inlined
+ * stub generated for each call site, which constructs the arguments and
+ * invokes the tracer callbacks. The instrumented function
+ * only keeps the enabled state check and a call, which reduces the
+ * i-cache and iTLB footprint of instrumentation in hot code. The stub is
+ * a lambda in C++ and a nested function in GNU C. Compilers supporting
+ * neither (e.g. Clang in C mode) keep the argument construction inline.
+ */
+#if defined(SIDE_EVENT_OUTLINE) && defined(__cplusplus)
+# define SIDE_EVENT_CALL_SITE(...)					\
+	[&]() __attribute__((cold, noinline)) { __VA_ARGS__ }()
+#elif defined(SIDE_EVENT_OUTLINE) && defined(__GNUC__) && !defined(__clang__)
+# define SIDE_EVENT_CALL_SITE(...)					\
+	({								\
+		__attribute__((cold, noinline)) void side_event_call_site(void) \
+		{							\
+			__VA_ARGS__					\
+		}							\
+		side_event_call_site();					\
+	})
+#else
+# define SIDE_EVENT_CALL_SITE(...)	__VA_ARGS__
+#endif
+
+/*
+ * C++ event calls recycle the dynamic literal arena when their outermost
+ * scope ends, whether or not tracer callbacks are invoked.
+ */
+#ifdef __cplusplus
+# define SIDE_ARENA_SCOPE	libside::arena_scope side_arena_scope;
+#else
+# define SIDE_ARENA_SCOPE
+#endif
+
 #define _side_event(_identifier, _sav)					\
 	if (side_event_enabled(_identifier))				\
-		_side_event_call(side_call, _identifier, SIDE_PARAM(_sav))
+		SIDE_EVENT_CALL_SITE(_side_event_call(side_call, _identifier, SIDE_PARAM(_sav)))
 
 #define _side_event_variadic(_identifier, _sav, _var, _attr...) \
 	if (side_event_enabled(_identifier))				\
-		_side_event_call_variadic(side_call_variadic, _identifier, \
+		SIDE_EVENT_CALL_SITE(_side_event_call_variadic(side_call_variadic, _identifier, \
 					SIDE_PARAM(_sav), SIDE_PARAM(_var), \
-					SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list()))
+					SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list())))
+
+#define _side_event_call_batch(_identifier, _side_arg_vecs, _nr_vecs)	\
+	do {								\
+		SIDE_ARENA_SCOPE					\
+		side_call_batch(&(side_event_state__##_identifier).parent, _side_arg_vecs, _nr_vecs); \
+	} while (0)
+
+#define _side_event_lazy(_identifier, _fill, _priv)			\
+	if (side_event_enabled(_identifier))				\
+		do {							\
+			SIDE_ARENA_SCOPE				\
+			side_call_lazy(&(side_event_state__##_identifier).parent, _fill, _priv); \
+		} while (0)
+
+/*
+ * Initialize the arguments passed to a side_arg_vec_fill_func for event
+ * `_identifier'. The static checker compares the argument types and
+ * count against the event fields. Without it, only the argument count
+ * is checked against `_len', and a mismatch aborts at runtime.
+ */
+#define _side_arg_fill(_identifier, _sav, _len, _args)			\
+	do {								\
+		const struct side_arg side_fill_sav[] = { _args };	\
+		if (SIDE_ARRAY_SIZE(side_fill_sav) != (_len))		\
+			abort();					\
+		__builtin_memcpy((_sav), side_fill_sav, sizeof(side_fill_sav)); \
+	} while (0)
+
+/*
+ * Declare a span for the rest of the enclosing scope. The enabled state
+ * is checked once at scope entry, and the span event is emitted with
+ * the scope duration when the scope is exited.
+ *
+ * A disabled span costs two branches, not one: the enabled state check
+ * at entry, and a test of the span state pointer (kept in a register or
+ * on the stack) at scope exit, which is always predicted correctly when
+ * the event stays disabled. Scope exit cannot know whether the span was
+ * started without it, short of reading the clock unconditionally.
+ *
+ * Only span events (see side_static_span_event()) are accepted: the
+ * span variable type is declared along with span events, so using
+ * another event fails to compile.
+ */
+#define _side_span(_identifier)						\
+	side_span_type__##_identifier SIDE_MAKE_ID(side_span) __attribute__((cleanup(side_span_end))) = \
+		side_event_enabled(_identifier) ?			\
+			side_span_begin(&(side_event_state__##_identifier).parent) : \
+			side_span_disabled()
 
 #define _side_event_call(_call, _identifier, _sav) \
 	{ \
+		SIDE_ARENA_SCOPE \
 		const struct side_arg side_sav[] = { _sav }; \
 		const struct side_arg_vec side_arg_vec = { \
 			.sav = SIDE_PTR_INIT(side_sav), \
@@ -1448,6 +1597,7 @@ enum {
 
 #define _side_event_call_variadic(_call, _identifier, _sav, _var_fields, _attr...) \
 	{ \
+		SIDE_ARENA_SCOPE \
 		const struct side_arg side_sav[] = { _sav }; \
 		const struct side_arg_vec side_arg_vec = { \
 			.sav = SIDE_PTR_INIT(side_sav), \
@@ -1464,6 +1614,7 @@ enum {
 
 #define _side_statedump_event_call(_call, _identifier, _key, _sav) \
 	{ \
+		SIDE_ARENA_SCOPE \
 		const struct side_arg side_sav[] = { _sav }; \
 		const struct side_arg_vec side_arg_vec = { \
 			.sav = SIDE_PTR_INIT(side_sav), \
@@ -1477,6 +1628,7 @@ enum {
 
 #define _side_statedump_event_call_variadic(_call, _identifier, _key, _sav, _var_fields, _attr...) \
 	{ \
+		SIDE_ARENA_SCOPE \
 		const struct side_arg side_sav[] = { _sav }; \
 		const struct side_arg_vec side_arg_vec = { \
 			.sav = side_ptr_init(side_sav), \
@@ -1505,19 +1657,33 @@ enum {
  *      Clang complains about redeclared sections.
  */
 #define _side_define_event(_forward_decl_linkage, _linkage, _identifier, _provider, _event, _loglevel, _fields, _flags, _attr...) \
+	_side_define_event_description(_forward_decl_linkage, _linkage, _identifier, _provider, _event, _loglevel, \
+			SIDE_PARAM(_fields), _flags, ##_attr);			\
+	static const struct side_event_description __attribute__((section("side_event_description_ptr"), used)) \
+	*side_event_ptr__##_identifier = &(_identifier)
+
+/*
+ * Define an event without listing it for automatic registration: it
+ * must be registered explicitly with side_events_register().
+ */
+#define _side_define_event_description(_forward_decl_linkage, _linkage, _identifier, _provider, _event, _loglevel, _fields, _flags, _attr...) \
 	SIDE_PUSH_DIAGNOSTIC()						\
 	SIDE_DIAGNOSTIC(ignored "-Wsection")				\
 	_forward_decl_linkage struct side_event_description __attribute__((section("side_event_description"))) \
 		_identifier;							\
-	_forward_decl_linkage struct side_event_state_0 __attribute__((section("side_event_state"))) \
+	_forward_decl_linkage uintptr_t __attribute__((section("side_event_enabled"))) \
+		side_event_enabled__##_identifier;			\
+	_forward_decl_linkage struct side_event_state_1 __attribute__((section("side_event_state"))) \
 		side_event_state__##_identifier;				\
-	_linkage struct side_event_state_0 __attribute__((section("side_event_state"))) \
+	_linkage uintptr_t __attribute__((section("side_event_enabled"))) \
+		side_event_enabled__##_identifier = 0;			\
+	_linkage struct side_event_state_1 __attribute__((section("side_event_state"))) \
 		side_event_state__##_identifier = {			\
 		.parent = {						\
 			.version = SIDE_EVENT_STATE_ABI_VERSION,	\
 		},							\
 		.nr_callbacks = 0,					\
-		.enabled = 0,						\
+		.enabled = &side_event_enabled__##_identifier,		\
 		.callbacks = (const struct side_callback *) &side_empty_callback[0], \
 		.desc = &(_identifier),					\
 	};								\
@@ -1538,8 +1704,6 @@ enum {
 		.side_end_abi_tag_0 = {},				\
 		.end = {}						\
 	};								\
-	static const struct side_event_description __attribute__((section("side_event_description_ptr"), used)) \
-	*side_event_ptr__##_identifier = &(_identifier);		\
 	SIDE_POP_DIAGNOSTIC() SIDE_EXPECT_SEMICOLON()
 
 /*
@@ -1579,7 +1743,8 @@ enum {
 
 #define _side_declare_event(_identifier)				\
 	extern "C" struct side_event_description _identifier;		\
-	extern "C" struct side_event_state_0 side_event_state_##_identifier
+	extern "C" uintptr_t side_event_enabled__##_identifier;		\
+	extern "C" struct side_event_state_1 side_event_state__##_identifier
 #else
 #define _side_static_event(_identifier, _provider, _event, _loglevel, _fields, _attr...) \
 	_side_define_event(static, static, _identifier, _provider, _event, _loglevel, SIDE_PARAM(_fields), \
@@ -1612,7 +1777,8 @@ enum {
 			   SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list()))
 
 #define _side_declare_event(_identifier) \
-	extern struct side_event_state_0 side_event_state_##_identifier; \
+	extern uintptr_t side_event_enabled__##_identifier; \
+	extern struct side_event_state_1 side_event_state__##_identifier; \
 	extern struct side_event_description _identifier
 #endif	/* __cplusplus */
 
@@ -0,0 +1,414 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#ifndef _SIDE_INSTRUMENTATION_CXX_API_H
+#define _SIDE_INSTRUMENTATION_CXX_API_H
+
+#if !defined(__cplusplus) || (__cplusplus < 202002L)
+# error "side/instrumentation-cxx-api.h requires C++20"
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ranges>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+/*
+ * Template events are checked by the compiler, without the
+ * preprocessor-based checker of the C macro API, which dominates the
+ * preprocessing time of instrumented translation units. Translation
+ * units instrumented only with this API can define
+ * SIDE_STATIC_CHECK_DISABLE before including this header to opt-out
+ * from it. C macro API instrumentation is statically checked otherwise.
+ */
+#include <side/trace.h>
+
+/*
+ * SIDE C++ template instrumentation API.
+ *
+ * Header-only C++20 layer on top of the SIDE ABI, where the event
+ * description is expressed as a type:
+ *
+ *   using my_event = side::event<"myprovider", "myevent",
+ *   	side::u32<"a">, side::string<"b">>;
+ *
+ *   my_event::emit(42, "hello");
+ *
+ * The event description, its field array and the event state are
+ * constant-initialized static data, so defining an event does not
+ * require any dynamic initialization or heap allocation at program
+ * startup, unlike the C macro API when compound literals are allocated
+ * on the heap (see SIDE_COMPOUND_LITERAL). The number and types of the
+ * arguments passed to emit() and call() are checked by the compiler
+ * against the field types, and null or duplicated field names are
+ * rejected with static assertions, which replaces the
+ * side/static-check.h checks for events defined with this API.
+ *
+ * Contiguous ranges (std::span, std::vector, std::array, std::string,
+ * std::string_view, ...) are passed by reference without copy nor
+ * per-element argument construction with side::span<"name", T>, which
+ * is described as a gather VLA of T, and with side::string_view<"name">,
+ * which is described as a gather VLA of bytes because the text is not
+ * required to be null-terminated.
+ *
+ * Events are registered with the other events of the executable or
+ * shared object by side_event_description_ptr_init(). Field types are
+ * limited to basic types and contiguous ranges, without attributes.
+ * Events requiring other compound, gather or dynamic types should use
+ * the C macro API.
+ */
+
+#define SIDE_CXX_NO_ATTR()	{ SIDE_PTR_INIT(nullptr), 0 }
+/* Allow SIDE_CXX_NO_ATTR() as attribute list of statically checked macros. */
+#define SIDE_SC_EMIT_SIDE_CXX_NO_ATTR	SIDE_CXX_NO_ATTR
+
+namespace side {
+
+	/* String literal usable as template argument. */
+	template <std::size_t N>
+	struct string_literal {
+		constexpr string_literal(const char (&str)[N])
+		{
+			for (std::size_t i = 0; i < N; i++)
+				value[i] = str[i];
+		}
+
+		char value[N];
+	};
+
+#define SIDE_CXX_DEFINE_FIELD(_name, _value_type, _type, _arg)			\
+	template <string_literal Name>						\
+	struct _name {								\
+		using value_type = _value_type;					\
+		static constexpr struct side_event_field field =		\
+			_side_field(Name.value, SIDE_PARAM(_type));		\
+		static struct side_arg arg(const value_type &v)		\
+		{								\
+			return _arg(v);						\
+		}								\
+	}
+
+	SIDE_CXX_DEFINE_FIELD(boolean, bool, _side_type_bool(SIDE_CXX_NO_ATTR()), _side_arg_bool);
+	SIDE_CXX_DEFINE_FIELD(byte, uint8_t, _side_type_byte(SIDE_CXX_NO_ATTR()), _side_arg_byte);
+	SIDE_CXX_DEFINE_FIELD(u8, uint8_t,
+		_side_type_integer(SIDE_TYPE_U8, false, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uint8_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_u8);
+	SIDE_CXX_DEFINE_FIELD(u16, uint16_t,
+		_side_type_integer(SIDE_TYPE_U16, false, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uint16_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_u16);
+	SIDE_CXX_DEFINE_FIELD(u32, uint32_t,
+		_side_type_integer(SIDE_TYPE_U32, false, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uint32_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_u32);
+	SIDE_CXX_DEFINE_FIELD(u64, uint64_t,
+		_side_type_integer(SIDE_TYPE_U64, false, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uint64_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_u64);
+	SIDE_CXX_DEFINE_FIELD(s8, int8_t,
+		_side_type_integer(SIDE_TYPE_S8, true, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(int8_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_s8);
+	SIDE_CXX_DEFINE_FIELD(s16, int16_t,
+		_side_type_integer(SIDE_TYPE_S16, true, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(int16_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_s16);
+	SIDE_CXX_DEFINE_FIELD(s32, int32_t,
+		_side_type_integer(SIDE_TYPE_S32, true, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(int32_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_s32);
+	SIDE_CXX_DEFINE_FIELD(s64, int64_t,
+		_side_type_integer(SIDE_TYPE_S64, true, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(int64_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_s64);
+	SIDE_CXX_DEFINE_FIELD(pointer, const void *,
+		_side_type_integer(SIDE_TYPE_POINTER, false, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uintptr_t), 0, SIDE_CXX_NO_ATTR()),
+		_side_arg_pointer);
+#if __HAVE_FLOAT32
+	SIDE_CXX_DEFINE_FIELD(float_binary32, _Float32,
+		__side_type_float(SIDE_TYPE_FLOAT_BINARY32, SIDE_TYPE_FLOAT_WORD_ORDER_HOST, sizeof(_Float32), SIDE_CXX_NO_ATTR()),
+		_side_arg_float_binary32);
+#endif
+#if __HAVE_FLOAT64
+	SIDE_CXX_DEFINE_FIELD(float_binary64, _Float64,
+		__side_type_float(SIDE_TYPE_FLOAT_BINARY64, SIDE_TYPE_FLOAT_WORD_ORDER_HOST, sizeof(_Float64), SIDE_CXX_NO_ATTR()),
+		_side_arg_float_binary64);
+#endif
+	SIDE_CXX_DEFINE_FIELD(string, const char *,
+		__side_type_string(SIDE_TYPE_STRING_UTF8, SIDE_TYPE_BYTE_ORDER_HOST, sizeof(uint8_t), SIDE_CXX_NO_ATTR()),
+		_side_arg_string);
+
+#undef SIDE_CXX_DEFINE_FIELD
+
+	/*
+	 * Reference to the elements of a contiguous range. The range must
+	 * outlive the event call. Ranges longer than UINT32_MAX elements
+	 * are truncated.
+	 */
+	template <typename T>
+	struct range_ref {
+		template <std::ranges::contiguous_range R>
+			requires std::ranges::sized_range<R>
+				&& std::is_same_v<std::remove_cv_t<std::ranges::range_value_t<R>>, T>
+		range_ref(const R &range)
+			: data(std::ranges::data(range)),
+			  length(std::ranges::size(range) > std::numeric_limits<uint32_t>::max() ?
+				std::numeric_limits<uint32_t>::max() : (uint32_t) std::ranges::size(range))
+		{
+		}
+
+		const T *data;
+		uint32_t length;
+	};
+
+	namespace detail {
+		template <typename T>
+		constexpr struct side_type gather_elem_type()
+		{
+			static_assert(std::is_arithmetic_v<T> || std::is_same_v<T, std::byte>,
+				"Unsupported range element type");
+			if constexpr (std::is_same_v<T, std::byte> || std::is_same_v<T, char>) {
+				struct side_type type = _side_type_gather_byte(0, SIDE_TYPE_GATHER_ACCESS_DIRECT,
+					SIDE_CXX_NO_ATTR());
+				return type;
+			} else if constexpr (std::is_same_v<T, bool>) {
+				struct side_type type = __side_type_gather_bool(SIDE_TYPE_BYTE_ORDER_HOST, 0,
+					sizeof(bool), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT, SIDE_CXX_NO_ATTR());
+				return type;
+			} else if constexpr (std::is_floating_point_v<T>) {
+				struct side_type type = __side_type_gather_float(SIDE_TYPE_FLOAT_WORD_ORDER_HOST, 0,
+					sizeof(T), SIDE_TYPE_GATHER_ACCESS_DIRECT, SIDE_CXX_NO_ATTR());
+				return type;
+			} else {
+				struct side_type type = _side_type_gather_integer(SIDE_TYPE_GATHER_INTEGER,
+					std::is_signed_v<T>, SIDE_TYPE_BYTE_ORDER_HOST, 0, sizeof(T), 0, 0,
+					SIDE_TYPE_GATHER_ACCESS_DIRECT, SIDE_CXX_NO_ATTR());
+				return type;
+			}
+		}
+
+		inline constexpr struct side_type gather_length_type =
+			_side_type_gather_integer(SIDE_TYPE_GATHER_INTEGER, false, SIDE_TYPE_BYTE_ORDER_HOST,
+				0, sizeof(uint32_t), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT, SIDE_CXX_NO_ATTR());
+
+		/*
+		 * Compile-time checks of the event fields, matching the
+		 * rules of side/static-check.h.
+		 */
+		template <typename Field>
+		constexpr const char *field_name()
+		{
+			return side_ptr_get(Field::field.field_name);
+		}
+
+		constexpr bool field_name_equal(const char *a, const char *b)
+		{
+			for (; *a && *a == *b; a++, b++)
+				;
+			return *a == *b;
+		}
+
+		template <typename... Fields>
+		constexpr bool has_null_field_name()
+		{
+			return ((field_name<Fields>()[0] == '\0') || ...);
+		}
+
+		template <typename... Fields>
+		constexpr bool has_duplicated_field_names()
+		{
+			const char *names[] = { field_name<Fields>()..., nullptr };
+
+			for (std::size_t i = 0; i < sizeof...(Fields); i++) {
+				for (std::size_t j = i + 1; j < sizeof...(Fields); j++) {
+					if (field_name_equal(names[i], names[j]))
+						return true;
+				}
+			}
+			return false;
+		}
+	};
+
+	template <string_literal Name, typename T>
+	struct span {
+		using value_type = range_ref<T>;
+
+		static constexpr struct side_type elem_type = detail::gather_elem_type<T>();
+		static constexpr struct side_event_field field =
+			_side_field(Name.value, _side_type_gather_vla(&elem_type, 0,
+				SIDE_TYPE_GATHER_ACCESS_DIRECT, &detail::gather_length_type, SIDE_CXX_NO_ATTR()));
+		static struct side_arg arg(const value_type &v)
+		{
+			return _side_arg_gather_vla(v.data, &v.length);
+		}
+	};
+
+	template <string_literal Name>
+	using string_view = span<Name, char>;
+
+	/*
+	 * Event descriptions have hidden visibility: like events defined
+	 * with side_static_event(), each executable and shared object
+	 * registers its own instance of the event.
+	 */
+	template <enum side_loglevel Loglevel, string_literal Provider, string_literal Event, typename... Fields>
+	class basic_event {
+		static_assert(!detail::has_null_field_name<Fields...>(), "Null field name");
+		static_assert(!detail::has_duplicated_field_names<Fields...>(), "Duplicated field names");
+
+	public:
+		static bool enabled()
+		{
+			(void) &register_desc_ptr;
+			return side_unlikely(__atomic_load_n(&enabled_word, __ATOMIC_RELAXED));
+		}
+
+		/* Invoke tracer callbacks. The caller checks enabled(). */
+		static void call(typename Fields::value_type... values)
+		{
+			const struct side_arg sav[nr_fields ? nr_fields : 1] = { Fields::arg(values)... };
+			const struct side_arg_vec side_arg_vec = {
+				.sav = SIDE_PTR_INIT(sav),
+				.len = nr_fields,
+			};
+
+			(void) &register_desc_ptr;
+			side_call(&state.parent, &side_arg_vec);
+		}
+
+		static void emit(typename Fields::value_type... values)
+		{
+			if (enabled())
+				call(values...);
+		}
+
+		/*
+		 * Invoke "make_values" only if the event is enabled. It
+		 * returns a tuple of the field values, which stays alive
+		 * until the tracer callbacks return.
+		 */
+		template <typename F>
+		static void emit_lazy(F &&make_values)
+		{
+			if (enabled())
+				std::apply(call, std::forward<F>(make_values)());
+		}
+
+		static struct side_event_description *description()
+		{
+			(void) &register_desc_ptr;
+			return &desc;
+		}
+
+	private:
+		static constexpr uint32_t nr_fields = sizeof...(Fields);
+		static constexpr struct side_event_field fields[nr_fields ? nr_fields : 1] = { Fields::field... };
+
+		__attribute__((visibility("hidden"))) static uintptr_t enabled_word;
+		__attribute__((visibility("hidden"))) static struct side_event_state_1 state;
+		__attribute__((visibility("hidden"))) static struct side_event_description desc;
+
+		/*
+		 * GCC ignores the section attribute on templated variables.
+		 * Emit the pointer to the event description into the
+		 * side_event_description_ptr section from assembly instead.
+		 * The pointer is part of the COMDAT group of the event
+		 * description, so it is kept exactly once per executable or
+		 * shared object. The section type is quoted rather than
+		 * written @progbits, as '@' starts a comment on ARM. This
+		 * function is never called.
+		 */
+		__attribute__((used, noinline)) static void register_desc_ptr()
+		{
+			asm volatile (
+				".pushsection side_event_description_ptr, \"awG\", \"progbits\", %c0, comdat\n\t"
+				".balign %c1\n\t"
+				".dc.a %c0\n\t"
+				".popsection"
+				: : "i" (&desc), "i" (__alignof__(struct side_event_description *)));
+		}
+	};
+
+	/*
+	 * GCC ignores the section attribute on templated variables: the
+	 * enabled word is not grouped with those of the side_event_enabled
+	 * section.
+	 */
+	template <enum side_loglevel Loglevel, string_literal Provider, string_literal Event, typename... Fields>
+	constinit uintptr_t basic_event<Loglevel, Provider, Event, Fields...>::enabled_word = 0;
+
+	/*
+	 * The callbacks pointer initializer is an address constant but not
+	 * a C++ constant expression, so the state cannot be declared
+	 * constinit. It is nevertheless statically initialized.
+	 */
+	template <enum side_loglevel Loglevel, string_literal Provider, string_literal Event, typename... Fields>
+	struct side_event_state_1 basic_event<Loglevel, Provider, Event, Fields...>::state = {
+		.parent = {
+			.version = SIDE_EVENT_STATE_ABI_VERSION,
+		},
+		.nr_callbacks = 0,
+		.enabled = &enabled_word,
+		.callbacks = (const struct side_callback *) &side_empty_callback[0],
+		.desc = &desc,
+	};
+
+	template <enum side_loglevel Loglevel, string_literal Provider, string_literal Event, typename... Fields>
+	constinit struct side_event_description basic_event<Loglevel, Provider, Event, Fields...>::desc = {
+		.side_begin_abi_tag_0 = {},
+		.struct_size = offsetof(struct side_event_description, end),
+		.version = SIDE_EVENT_DESCRIPTION_ABI_VERSION,
+		.state = SIDE_PTR_INIT(&state.parent),
+		.provider_name = SIDE_PTR_INIT(Provider.value),
+		.event_name = SIDE_PTR_INIT(Event.value),
+		.fields = { SIDE_PTR_INIT(fields), nr_fields },
+		.attributes = SIDE_CXX_NO_ATTR(),
+		.flags = 0,
+		.nr_side_type_label = _NR_SIDE_TYPE_LABEL,
+		.nr_side_attr_type = _NR_SIDE_ATTR_TYPE,
+		.loglevel = SIDE_ENUM_INIT(Loglevel),
+		.side_end_abi_tag_0 = {},
+		.end = {}
+	};
+
+	/* Events with the debug loglevel. */
+	template <string_literal Provider, string_literal Event, typename... Fields>
+	using event = basic_event<SIDE_LOGLEVEL_DEBUG, Provider, Event, Fields...>;
+
+	/*
+	 * Span events have the same "start" and "duration" fields as the
+	 * C span events. A scope object checks the enabled state once on
+	 * construction, and emits the span event with the duration of its
+	 * lifetime on destruction.
+	 */
+	template <enum side_loglevel Loglevel, string_literal Provider, string_literal Event>
+	class basic_span_event : public basic_event<Loglevel, Provider, Event, u64<"start">, u64<"duration">> {
+		using base = basic_event<Loglevel, Provider, Event, u64<"start">, u64<"duration">>;
+
+	public:
+		class scope {
+		public:
+			scope() : is_enabled(base::enabled()), start(0)
+			{
+				if (is_enabled)
+					start = side_span_timestamp();
+			}
+
+			~scope()
+			{
+				if (is_enabled)
+					base::call(start, side_span_timestamp() - start);
+			}
+
+			scope(const scope &) = delete;
+			scope &operator=(const scope &) = delete;
+
+		private:
+			bool is_enabled;
+			uint64_t start;
+		};
+	};
+
+	template <string_literal Provider, string_literal Event>
+	using span_event = basic_span_event<SIDE_LOGLEVEL_DEBUG, Provider, Event>;
+};
+
+#endif /* _SIDE_INSTRUMENTATION_CXX_API_H */
@@ -70,14 +70,14 @@
  * Private helpers for C++.
  *
  * Class libside::stack_copy<T>: A wrapper around std::initializer_list<T>.  It
- * copies the values in the intializer list in a buffer allocated on the stack.
+ * copies the values in the intializer list in a buffer provided by the caller.
  * The rationale is the following:
  *
  *   Dynamic compound literals are used in function scopes, i.e., the storage is
  *   on the stack. C++ does not support them well.
  *
- *   To overcome this issue, the compound literals are memcpy onto an allocated
- *   buffer on the stack using alloca(3).
+ *   To overcome this issue, the compound literals are memcpy onto a buffer
+ *   allocated from the per-thread libside arena (see side_arena_alloc()).
  *
  *   See the following paragraphs taken from GCC documentation for the rationale:
  *
@@ -101,7 +101,7 @@
  * Function libside::initializer_list_size<T>: Return the number of elements in
  * an initializer list.  This can be used either at compile time or at runtime.
  * The rationale for its usage is the same as libside::stack_copy<T>, only it
- * allows finding the number of the elements allocated in the stack buffer.
+ * allows finding the number of the elements copied in the buffer.
  * Furthermore, there is a bug in GCC 13 where taking the address of a temporary
  * address in a sizeof operator triggers a compile error.  This work around
  * does not seems to be affected.
@@ -178,21 +178,26 @@ namespace libside {
 
 /*
  * Dynamic compound literals in C are the same as the static ones.  For C++, the
- * values are copied from a std::initializer_list onto a buffer allocated on the
- * stack.
- *
- * NOTE: For C++, the allocation on the stack is made with alloca(3), resulting
- * in increase of the stack size for every dynamic literal created within a
- * function.  If such creation is done within a loop, the behavior is undefined.
+ * values are copied from a std::initializer_list onto a buffer allocated from
+ * the per-thread libside arena.
+ *
+ * NOTE: For C++, the arena is recycled when the outermost event call returns,
+ * so stack usage stays constant and dynamic arguments can be used within loops.
+ * This shortens the lifetime of dynamic literals compared to C: they are valid
+ * until the calling thread emits its next event. Dynamic objects defined ahead
+ * of an event statement (e.g. with side_arg_dynamic_define_vec()) must be
+ * defined again for each event they are passed to. Literals which do not fit in
+ * the 16 kB per-thread buffer are allocated from the heap, and are released
+ * with the arena as well: defining dynamic objects in a loop which does not emit
+ * events, e.g. ahead of a disabled event, accumulates memory until the thread
+ * emits an event or exits, so define them after the side_event_enabled() check.
  * Currently, dynamic literals are only used for dynamic attribute lists, which
- * are used by all dynamic arguments.  Users should avoid using dynamic
- * arguments in loops.  To overcome this limit, users can call a helper noinline
- * function that does the instrumentation.
+ * are used by all dynamic arguments.
  */
 #ifdef __cplusplus
 #  define SIDE_DYNAMIC_LITERAL_ARRAY(_type, ...)			\
 	{								\
-		SIDE_PTR_INIT(libside::stack_copy<std::remove_const<_type>::type>((std::remove_const<_type>::type *)__builtin_alloca(sizeof(_type) * libside::initializer_list_size<_type>({__VA_ARGS__})), { __VA_ARGS__ })), \
+		SIDE_PTR_INIT(libside::stack_copy<std::remove_const<_type>::type>((std::remove_const<_type>::type *)side_arena_alloc(sizeof(_type) * libside::initializer_list_size<_type>({__VA_ARGS__}), alignof(_type)), { __VA_ARGS__ })), \
 		libside::initializer_list_size<_type>({__VA_ARGS__}),		\
 	}
 #else
@@ -872,6 +872,9 @@ SIDE_SC_DEFINE_TYPE(variadic);
 #undef side_attr_string32
 #define SIDE_SC_EMIT_side_attr_string32 _side_attr_string32
 
+#undef side_attr_format
+#define SIDE_SC_EMIT_side_attr_format _side_attr_format
+
 /* Dispatch: field_list */
 #undef side_field_list
 #define SIDE_SC_CHECK_side_field_list(_lst...)	\
@@ -1743,6 +1746,20 @@ SIDE_SC_DEFINE_TYPE(gather_vla);
 #define SIDE_SC_CHECK_side_arg_gather_vla(...) ,SIDE_SC_TYPE(gather_vla)
 #define SIDE_SC_EMIT_side_arg_gather_vla _side_arg_gather_vla
 
+/* Dispatch: gather_iovec */
+SIDE_SC_DEFINE_TYPE(gather_iovec);
+
+#undef side_field_gather_iovec
+#define SIDE_SC_CHECK_side_field_gather_iovec(...) ,SIDE_SC_TYPE(gather_iovec)
+#define SIDE_SC_NAME_OF_side_field_gather_iovec SIDE_SC_EXTRACT_FIELD_NAME
+#define SIDE_SC_EMIT_side_field_gather_iovec(_name, _offset, _access_mode, _length_type_gather, _capture_max, _attr...) \
+	_side_field_gather_iovec(_name, _offset, _access_mode, SIDE_SC_EMIT_##_length_type_gather, _capture_max, \
+			SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list()))
+
+#undef side_arg_gather_iovec
+#define SIDE_SC_CHECK_side_arg_gather_iovec(...) ,SIDE_SC_TYPE(gather_iovec)
+#define SIDE_SC_EMIT_side_arg_gather_iovec _side_arg_gather_iovec
+
 /* Dispatch: variant */
 SIDE_SC_DEFINE_TYPE(variant);
 
@@ -2046,6 +2063,11 @@ SIDE_SC_DEFINE_TYPE(dynamic);
 #define SIDE_SC_CHECK_side_arg_dynamic_struct(...) ,SIDE_SC_TYPE(dynamic)
 #define SIDE_SC_EMIT_side_arg_dynamic_struct(...) _side_arg_dynamic_struct(__VA_ARGS__)
 
+#undef side_arg_dynamic_struct_schema
+#define SIDE_SC_CHECK_side_arg_dynamic_struct_schema(...) ,SIDE_SC_TYPE(dynamic)
+#define SIDE_SC_EMIT_side_arg_dynamic_struct_schema(_schema, _values) \
+	_side_arg_dynamic_struct_schema(_schema, _values, SIDE_ARRAY_SIZE(_values))
+
 #undef side_arg_dynamic_struct_visitor
 #define SIDE_SC_CHECK_side_arg_dynamic_struct_visitor(...) ,SIDE_SC_TYPE(dynamic)
 #define SIDE_SC_EMIT_side_arg_dynamic_struct_visitor(...) _side_arg_dynamic_struct_visitor(__VA_ARGS__)
@@ -2541,6 +2563,13 @@ SIDE_SC_DEFINE_TYPE(dynamic);
 	_side_type_gather_vla(SIDE_SC_EMIT_SUB_##_elem_type_gather, _offset, _access_mode, SIDE_SC_EMIT_SUB_##_length_type_gather, \
 			SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list()))
 
+/* Dispatch: type_gather_iovec */
+#undef side_type_gather_iovec
+#define SIDE_SC_CHECK_side_type_gather_iovec(...) ,SIDE_SC_TYPE(gather_iovec)
+#define SIDE_SC_EMIT_side_type_gather_iovec(_offset, _access_mode, _length_type_gather, _capture_max, _attr...) \
+	_side_type_gather_iovec(_offset, _access_mode, SIDE_SC_EMIT_SUB_##_length_type_gather, _capture_max, \
+			SIDE_DEFAULT_ATTR(_, ##_attr, side_attr_list()))
+
 /* Dispatch: define_variant */
 #undef side_define_variant
 #define side_define_variant(_identifier, _selector, _options, _attr...) \
@@ -2708,14 +2737,14 @@ SIDE_SC_DEFINE_TYPE(dynamic);
 /* Dispatch: event_call */
 #undef side_event_call
 #define side_event_call(_identifier, _sav)				\
-	_side_event_call(side_call, _identifier, SIDE_SC_EMIT_##_sav);	\
+	SIDE_EVENT_CALL_SITE(_side_event_call(side_call, _identifier, SIDE_SC_EMIT_##_sav)); \
 	SIDE_SC_CHECK_EVENT_CALL(_identifier, _sav)
 
 /* Dispatch: event_call_variadic */
 #undef side_event_call_variadic
 #define side_event_call_variadic(_identifier, _sav, _var_fields, _attr...) \
-	_side_event_call_variadic(side_call_variadic, _identifier, SIDE_SC_EMIT_##_sav, SIDE_SC_EMIT_##_var_fields, \
-				SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list())); \
+	SIDE_EVENT_CALL_SITE(_side_event_call_variadic(side_call_variadic, _identifier, SIDE_SC_EMIT_##_sav, SIDE_SC_EMIT_##_var_fields, \
+				SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list()))); \
 	SIDE_SC_CHECK_EVENT_CALL_VARIADIC(_identifier, _sav)
 
 /* Dispatch: statedump_event_call */
@@ -2736,18 +2765,24 @@ SIDE_SC_DEFINE_TYPE(dynamic);
 #define side_event(_identifier, _sav)					\
 	do {								\
 		if (side_event_enabled(_identifier)) {			\
-			_side_event_call(side_call, _identifier, SIDE_SC_EMIT_##_sav); \
+			SIDE_EVENT_CALL_SITE(_side_event_call(side_call, _identifier, SIDE_SC_EMIT_##_sav)); \
 			SIDE_SC_CHECK_EVENT_CALL(_identifier, _sav);	\
 		}							\
 	} while(0)
 
+/* Dispatch: arg_fill */
+#undef side_arg_fill
+#define side_arg_fill(_identifier, _sav, _len, _args)			\
+	_side_arg_fill(_identifier, _sav, _len, SIDE_SC_EMIT_##_args);	\
+	SIDE_SC_CHECK_EVENT_CALL(_identifier, _args)
+
 /* Dispatch: event_variadic */
 #undef side_event_variadic
 #define side_event_variadic(_identifier, _sav, _var, _attr...)		\
 	do {								\
 		if (side_event_enabled(_identifier)) {			\
-			_side_event_call_variadic(side_call_variadic, _identifier, SIDE_SC_EMIT_##_sav, SIDE_SC_EMIT_##_var, \
-						SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list())); \
+			SIDE_EVENT_CALL_SITE(_side_event_call_variadic(side_call_variadic, _identifier, SIDE_SC_EMIT_##_sav, SIDE_SC_EMIT_##_var, \
+						SIDE_DEFAULT_ATTR(_, ##_attr, side_dynamic_attr_list()))); \
 			SIDE_SC_CHECK_EVENT_CALL_VARIADIC(_identifier, _sav); \
 		}							\
 	} while(0)
@@ -13,6 +13,7 @@
 #include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <time.h>
 #include <side/macros.h>
 #include <side/endian.h>
 
@@ -34,7 +35,10 @@
  *   when changing the layout of "struct side_event_state_N".
  */
 
-#define SIDE_EVENT_STATE_ABI_VERSION		0
+#define SIDE_EVENT_STATE_ABI_VERSION		1
+
+/* Alignment of the "side_event_enabled" section: a cache line. */
+#define SIDE_EVENT_ENABLED_ALIGN		64
 
 #include <side/abi/event-description.h>
 #include <side/abi/type-argument.h>
@@ -60,6 +64,11 @@ struct side_event_state {
 	uint32_t version;	/* Event state ABI version. */
 };
 
+/*
+ * Event state of instrumentation built against headers of event state
+ * ABI version 0, which keeps the enabled word inline. Still accepted
+ * by the library.
+ */
 struct side_event_state_0 {
 	struct side_event_state parent;		/* Required first field. */
 	uint32_t nr_callbacks;
@@ -68,6 +77,22 @@ struct side_event_state_0 {
 	struct side_event_description *desc;
 };
 
+/*
+ * The enabled word is read by every instrumentation site, whereas the
+ * other fields are updated on callback registration. Enabled words are
+ * kept apart in the dense "side_event_enabled" section, so updates to
+ * the state of an event do not invalidate the cache lines holding the
+ * enabled words of other events. The other fields have the same layout
+ * as in struct side_event_state_0.
+ */
+struct side_event_state_1 {
+	struct side_event_state parent;		/* Required first field. */
+	uint32_t nr_callbacks;
+	uintptr_t *enabled;
+	const struct side_callback *callbacks;
+	struct side_event_description *desc;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -84,10 +109,145 @@ void side_call_variadic(const struct side_event_state *state,
 	const struct side_arg_vec *side_arg_vec,
 	const struct side_arg_dynamic_struct *var_struct);
 
+/*
+ * Emit "nr_vecs" instances of a non-variadic event at once. The
+ * dispatch overhead (library state checks, RCU read-side critical
+ * section, callback iteration) is paid once for the batch. Tracer
+ * callbacks registered with side_tracer_callback_batch_register()
+ * receive the whole batch, other callbacks are called once per event.
+ */
+void side_call_batch(const struct side_event_state *state,
+	const struct side_arg_vec *side_arg_vecs, uint32_t nr_vecs);
+
+/*
+ * Lazily evaluated event arguments. The fill callback is invoked only
+ * once the event is known to have consumers, and must initialize the
+ * "len" arguments, one per event field, e.g. with side_arg_fill().
+ * Data referenced by the arguments must stay valid until
+ * side_call_lazy() returns, e.g. by keeping it in the object pointed
+ * to by "priv". The arguments are kept on the stack: events with more
+ * than 256 fields are not emitted.
+ */
+typedef void (*side_arg_vec_fill_func)(struct side_arg *sav, uint32_t len, void *priv);
+
+void side_call_lazy(const struct side_event_state *state,
+	side_arg_vec_fill_func fill, void *priv);
+
+/*
+ * Scoped span events, see side_span(). The span event fields are the
+ * scope entry "start" time and its "duration", in nanoseconds from
+ * CLOCK_MONOTONIC. The state is NULL if the event was disabled at
+ * scope entry.
+ */
+struct side_span {
+	const struct side_event_state *state;
+	uint64_t start;
+};
+
+static inline
+uint64_t side_span_timestamp(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+static inline
+struct side_span side_span_begin(const struct side_event_state *state)
+{
+	struct side_span span = {
+		.state = state,
+		.start = side_span_timestamp(),
+	};
+
+	return span;
+}
+
+static inline
+struct side_span side_span_disabled(void)
+{
+	struct side_span span = {
+		.state = NULL,
+		.start = 0,
+	};
+
+	return span;
+}
+
+static inline
+void side_span_end(struct side_span *span)
+{
+	if (side_likely(!span->state))
+		return;
+	{
+		uint64_t duration = side_span_timestamp() - span->start;
+		const struct side_arg side_sav[] = {
+			_side_arg_u64(span->start),
+			_side_arg_u64(duration),
+		};
+		const struct side_arg_vec side_arg_vec = {
+			.sav = SIDE_PTR_INIT(side_sav),
+			.len = SIDE_ARRAY_SIZE(side_sav),
+		};
+
+		side_call(span->state, &side_arg_vec);
+	}
+}
+
+/*
+ * Allocate from the calling thread's dynamic literal arena. Used by
+ * C++ dynamic literals (SIDE_DYNAMIC_LITERAL_ARRAY). The memory is
+ * recycled when the outermost event call scope ends, so it must not be
+ * used after the thread emits an event. The 16 kB per-thread buffer is
+ * allocated on first use; larger allocations come from the heap until
+ * the arena is recycled.
+ */
+void *side_arena_alloc(size_t len, size_t align);
+
+/*
+ * Event call scope delimiting the lifetime of C++ dynamic literals.
+ * The C++ event call macros open a scope around argument construction
+ * and the call (see SIDE_ARENA_SCOPE), so the arena is recycled even
+ * when the call returns early. C instrumentation does not use them.
+ */
+void side_arena_scope_begin(void);
+void side_arena_scope_end(void);
+
 struct side_events_register_handle *side_events_register(struct side_event_description **events,
 		uint32_t nr_events);
 void side_events_unregister(struct side_events_register_handle *handle);
 
+/*
+ * Stable 64-bit fingerprint of the event description, computed on
+ * first query and cached while the event is registered. It covers the provider and event names,
+ * flags, loglevel, and the complete type description of the fields,
+ * including attributes and enumeration mappings, but not the addresses
+ * of the description objects. Events with identical descriptions have
+ * the same fingerprint across processes and executions, which lets
+ * consumers cache decoders and metadata by fingerprint.
+ *
+ * Can be invoked from tracer event notification callbacks. Returns
+ * SIDE_ERROR_NOENT if the event is not registered.
+ */
+int side_event_description_fingerprint(const struct side_event_description *desc,
+		uint64_t *fingerprint);
+
+/*
+ * Dynamic structure schemas let runtimes emitting the same dynamic
+ * structure shape repeatedly register it once, and then pass only
+ * field values with side_arg_dynamic_struct_schema(). Only dynamic
+ * basic field types are allowed in a schema. The shape is copied,
+ * including field names and attributes (keys and string values), and
+ * its values are ignored. Returns NULL on error.
+ *
+ * The schema must not be unregistered while events referencing it may
+ * still be emitted.
+ */
+const struct side_dynamic_struct_schema *side_dynamic_struct_schema_register(
+		const struct side_arg_dynamic_struct *shape);
+void side_dynamic_struct_schema_unregister(const struct side_dynamic_struct_schema *schema);
+
 /*
  * Userspace tracer registration API. This allows userspace tracers to
  * register event notification callbacks to be notified of the currently
@@ -106,15 +266,84 @@ typedef void (*side_tracer_callback_variadic_func)(const struct side_event_descr
 			const struct side_arg_vec *side_arg_vec,
 			const struct side_arg_dynamic_struct *var_struct,
 			void *priv, void *caller_addr);
+typedef void (*side_tracer_callback_batch_func)(const struct side_event_description *desc,
+			const struct side_arg_vec *side_arg_vecs, uint32_t nr_vecs,
+			void *priv, void *caller_addr);
 
 int side_tracer_request_key(uint64_t *key);
 
+/*
+ * Cumulative number of RCU grace periods waited for by libside, and of
+ * membarrier system calls issued, since the library was loaded.
+ */
+void side_tracer_rcu_stats(uint64_t *nr_grace_periods, uint64_t *nr_membarrier);
+
+/*
+ * Bytes of memory currently allocated for instrumentation, by use.
+ * Tracers report the size of their own buffers with
+ * side_tracer_memory_usage_add(), passing a negative value when
+ * releasing them.
+ */
+struct side_memory_usage {
+	uint64_t callbacks;	/* Callback arrays and callback statistics. */
+	uint64_t rcu;		/* RCU per-CPU grace period state. */
+	uint64_t statedump;	/* Pending statedump notification queues. */
+	uint64_t registration;	/* Events, tracer, statedump and schema handles. */
+	uint64_t tracer;	/* Reported by tracers. */
+	uint64_t arena;		/* Dynamic literal arena buffers of live threads. */
+};
+
+void side_tracer_memory_usage(struct side_memory_usage *usage);
+void side_tracer_memory_usage_add(int64_t bytes);
+
+/*
+ * Sampled timing of tracer callbacks. When enabled, one side_call() out
+ * of sample_period, counted per thread, measures the time spent in each
+ * callback it invokes. side_call_batch() counts as one side_call(),
+ * and each invocation of a batch callback as one sample. Samples are
+ * aggregated per (event, callback, priv, key), in tables of 64 entries
+ * shared by the CPUs of each last-level cache (4 KB per LLC, allocated
+ * on first enable); samples of further tuples on an LLC are dropped. A sample_period of 0 disables
+ * sampling; statistics gathered so far are kept.
+ *
+ * The first enable also registers the "side:callback_stats" event, and
+ * the "side_callback_stats" statedump, which emits it once per callback.
+ *
+ * side_tracer_callback_stats_iterate() invokes cb for each callback
+ * with at least one sample. cb must not register or unregister events.
+ */
+struct side_callback_stats {
+	const struct side_event_description *desc;
+	union {
+		side_tracer_callback_func call;
+		side_tracer_callback_variadic_func call_variadic;
+	} u;
+	void *priv;
+	uint64_t key;
+	uint64_t nr_samples;
+	uint64_t total_ns;
+	uint64_t max_ns;
+};
+
+int side_tracer_callback_stats_enable(uint32_t sample_period);
+int side_tracer_callback_stats_iterate(void (*cb)(const struct side_callback_stats *stats, void *priv),
+		void *priv);
+
 int side_tracer_callback_register(struct side_event_description *desc,
 		side_tracer_callback_func call,
 		void *priv, uint64_t key);
 int side_tracer_callback_variadic_register(struct side_event_description *desc,
 		side_tracer_callback_variadic_func call_variadic,
 		void *priv, uint64_t key);
+/*
+ * Register "call" along with "call_batch", which is invoked instead of
+ * "call" by side_call_batch(). Unregister with
+ * side_tracer_callback_unregister().
+ */
+int side_tracer_callback_batch_register(struct side_event_description *desc,
+		side_tracer_callback_func call,
+		side_tracer_callback_batch_func call_batch,
+		void *priv, uint64_t key);
 int side_tracer_callback_unregister(struct side_event_description *desc,
 		side_tracer_callback_func call,
 		void *priv, uint64_t key);
@@ -122,16 +351,70 @@ int side_tracer_callback_variadic_unregister(struct side_event_description *desc
 		side_tracer_callback_variadic_func call_variadic,
 		void *priv, uint64_t key);
 
+/*
+ * Raw capture of gather events, for tracers which defer decoding to
+ * the consumer side.
+ *
+ * side_gather_capture_plan_create() precomputes a bounded copy plan
+ * from the event description. It returns NULL if the event has fields
+ * whose layout cannot be known from the description alone (pointer
+ * access, strings, VLAs, iovecs, stack-copy compound and dynamic
+ * types), or is variadic.
+ *
+ * From the tracer callback, side_gather_capture() copies the raw bytes
+ * referenced by the arguments into buf, which must hold at least
+ * side_gather_capture_plan_size() bytes. It returns SIDE_ERROR_INVAL,
+ * without reading application memory, if the argument types do not
+ * match the event description. On the consumer side,
+ * side_gather_capture_decode() rebuilds nr_sav arguments referencing
+ * the captured buffer. Gather offsets of the decoded arguments are
+ * relative to the captured copy: visit them against the description
+ * returned by side_gather_capture_plan_description(), which lives as
+ * long as the plan. The captured buffer must outlive the decoded
+ * arguments.
+ */
+struct side_gather_capture_plan;
+
+struct side_gather_capture_plan *side_gather_capture_plan_create(const struct side_event_description *desc);
+void side_gather_capture_plan_destroy(struct side_gather_capture_plan *plan);
+size_t side_gather_capture_plan_size(const struct side_gather_capture_plan *plan);
+const struct side_event_description *side_gather_capture_plan_description(const struct side_gather_capture_plan *plan);
+int side_gather_capture(const struct side_gather_capture_plan *plan,
+		const struct side_arg_vec *side_arg_vec,
+		void *buf, size_t len);
+int side_gather_capture_decode(const struct side_gather_capture_plan *plan,
+		const void *buf, size_t len,
+		struct side_arg *sav, uint32_t nr_sav);
+
+/*
+ * SIDE_TRACER_NOTIFICATION_EXIT is sent once, with no events, at
+ * process exit in fast exit mode only (see side_fast_exit_enable()),
+ * to the tracers registered with SIDE_TRACER_NOTIFICATION_FLAG_EXIT.
+ * It is sent before any event is unregistered and no further
+ * notification follows, so tracers should flush their buffers there.
+ */
 enum side_tracer_notification {
 	SIDE_TRACER_NOTIFICATION_INSERT_EVENTS,
 	SIDE_TRACER_NOTIFICATION_REMOVE_EVENTS,
+	SIDE_TRACER_NOTIFICATION_EXIT,
 };
 
-/* Callback is invoked with side library internal lock held. */
+enum side_tracer_notification_flag {
+	SIDE_TRACER_NOTIFICATION_FLAG_EXIT = (1 << 0),
+};
+
+/*
+ * Callback is invoked with side library internal lock held.
+ * side_tracer_event_notification_register() registers with no flags.
+ */
 struct side_tracer_handle *side_tracer_event_notification_register(
 		void (*cb)(enum side_tracer_notification notif,
 			struct side_event_description **events, uint32_t nr_events, void *priv),
 		void *priv);
+struct side_tracer_handle *side_tracer_event_notification_register_flags(
+		void (*cb)(enum side_tracer_notification notif,
+			struct side_event_description **events, uint32_t nr_events, void *priv),
+		void *priv, uint32_t flags);
 void side_tracer_event_notification_unregister(struct side_tracer_handle *handle);
 
 /*
@@ -214,10 +497,23 @@ int side_tracer_statedump_request_cancel(uint64_t key);
 void side_init(void) __attribute__((constructor));
 void side_exit(void) __attribute__((destructor));
 
+/*
+ * Opt into fast exit: at process exit, tracers which opted in are sent
+ * SIDE_TRACER_NOTIFICATION_EXIT and the side API then stops, without
+ * unregistering events nor freeing memory which the OS reclaims
+ * anyway. Also enabled by setting SIDE_FAST_EXIT in the environment.
+ * With the environment variable only, the exit handler is registered
+ * by the first events registration: if it comes from a shared object
+ * constructor, events still go through regular teardown unless the
+ * main program calls this function.
+ */
+void side_fast_exit_enable(void);
+
 /*
  * The following constructors/destructors perform automatic registration
  * of the declared side events. Those may have to be called explicitly
- * in a statically linked library.
+ * in a statically linked library. The side library itself is built with
+ * SIDE_LIBRARY_BUILD and registers its own events explicitly.
  */
 
 /*
@@ -234,6 +530,22 @@ int side_event_description_ptr_registered
 struct side_events_register_handle *side_events_handle
 	__attribute__((weak, visibility("hidden")));
 
+/*
+ * Align the side_event_enabled section on a cache line, so the enabled
+ * words of its first events do not share a cache line with the data
+ * preceding it. The comdat group keeps a single instance per
+ * shared-object (or for the whole main program).
+ */
+__asm__ (
+	".pushsection side_event_enabled, \"awG\", \"progbits\", side_event_enabled_align, comdat\n\t"
+	".balign " SIDE_STR(SIDE_EVENT_ENABLED_ALIGN) "\n\t"
+	".weak side_event_enabled_align\n\t"
+	".hidden side_event_enabled_align\n\t"
+	"side_event_enabled_align:\n\t"
+	".popsection\n\t"
+);
+
+#ifndef SIDE_LIBRARY_BUILD
 static void
 side_event_description_ptr_init(void)
 	__attribute__((no_instrument_function))
@@ -260,8 +572,17 @@ side_event_description_ptr_exit(void)
 	side_events_handle = NULL;
 }
 
+#endif /* SIDE_LIBRARY_BUILD */
+
 #ifdef __cplusplus
 }
+
+namespace libside {
+	struct arena_scope {
+		arena_scope() { side_arena_scope_begin(); }
+		~arena_scope() { side_arena_scope_end(); }
+	};
+};
 #endif
 
 #endif /* _SIDE_TRACE_H */
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <side/trace.h>
+
+#include "arena.h"
+
+#define SIDE_ARENA_ALIGN	16
+
+struct side_arena_chunk {
+	struct side_arena_chunk *next;
+	char buf[] __attribute__((aligned(SIDE_ARENA_ALIGN)));
+};
+
+__thread struct side_arena side_arena;
+uint64_t side_arena_memory_usage;
+
+static pthread_key_t side_arena_key;
+static pthread_once_t side_arena_key_once = PTHREAD_ONCE_INIT;
+
+static
+void side_arena_reset_overflow(void)
+{
+	struct side_arena_chunk *chunk, *next;
+
+	for (chunk = side_arena.overflow; chunk; chunk = next) {
+		next = chunk->next;
+		free(chunk);
+	}
+	side_arena.overflow = NULL;
+}
+
+/* Called on thread exit. */
+static
+void side_arena_thread_exit(void *arg __attribute__((unused)))
+{
+	side_arena_reset_overflow();
+	if (side_arena.buf)
+		(void) __atomic_sub_fetch(&side_arena_memory_usage, SIDE_ARENA_SIZE, __ATOMIC_RELAXED);
+	free(side_arena.buf);
+	side_arena.buf = NULL;
+	side_arena.offset = 0;
+}
+
+static
+void side_arena_key_init(void)
+{
+	if (pthread_key_create(&side_arena_key, side_arena_thread_exit))
+		abort();
+}
+
+static
+void side_arena_thread_init(void)
+{
+	void *buf;
+
+	if (posix_memalign(&buf, SIDE_ARENA_ALIGN, SIDE_ARENA_SIZE))
+		abort();
+	(void) pthread_once(&side_arena_key_once, side_arena_key_init);
+	if (pthread_setspecific(side_arena_key, &side_arena))
+		abort();
+	side_arena.buf = (char *) buf;
+	(void) __atomic_add_fetch(&side_arena_memory_usage, SIDE_ARENA_SIZE, __ATOMIC_RELAXED);
+}
+
+/*
+ * Allocations which do not fit in the arena buffer are kept on a list
+ * until the arena is reset, rather than reusing the buffer: literals
+ * allocated earlier may still be in use.
+ */
+static
+void *side_arena_alloc_overflow(size_t len)
+{
+	struct side_arena_chunk *chunk;
+
+	if (posix_memalign((void **) &chunk, SIDE_ARENA_ALIGN, sizeof(struct side_arena_chunk) + len))
+		abort();
+	chunk->next = side_arena.overflow;
+	side_arena.overflow = chunk;
+	return chunk->buf;
+}
+
+void side_arena_scope_begin(void)
+{
+	side_arena.nesting++;
+}
+
+void side_arena_scope_end(void)
+{
+	if (!--side_arena.nesting) {
+		side_arena.offset = 0;
+		if (side_unlikely(side_arena.overflow))
+			side_arena_reset_overflow();
+	}
+}
+
+void *side_arena_alloc(size_t len, size_t align)
+{
+	size_t offset;
+
+	if (!align || (align & (align - 1)) || align > SIDE_ARENA_ALIGN) {
+		fprintf(stderr, "ERROR: Unsupported arena allocation (len: %zu, align: %zu)\n",
+			len, align);
+		abort();
+	}
+	if (side_unlikely(!side_arena.buf))
+		side_arena_thread_init();
+	offset = (side_arena.offset + align - 1) & ~(align - 1);
+	if (offset > SIDE_ARENA_SIZE || len > SIDE_ARENA_SIZE - offset)
+		return side_arena_alloc_overflow(len);
+	side_arena.offset = offset + len;
+	return &side_arena.buf[offset];
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#ifndef _SIDE_ARENA_H
+#define _SIDE_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SIDE_ARENA_SIZE		16384
+
+struct side_arena_chunk;
+
+/*
+ * Per-thread bump allocator backing C++ dynamic literals. The buffer is
+ * allocated on the first dynamic literal of the thread and freed when
+ * the thread exits. Allocations which do not fit in the buffer come
+ * from the heap. The arena, including heap allocations, is reset when
+ * the outermost C++ event call scope ends (see side_arena_scope_end()).
+ */
+struct side_arena {
+	size_t offset;
+	unsigned int nesting;	/* Event call scope nesting depth. */
+	char *buf;		/* SIDE_ARENA_SIZE bytes, NULL until first use. */
+	struct side_arena_chunk *overflow;	/* Heap allocations. */
+};
+
+extern __thread struct side_arena side_arena __attribute__((visibility("hidden")));
+/* Bytes allocated for the arena buffers of live threads. */
+extern uint64_t side_arena_memory_usage __attribute__((visibility("hidden")));
+
+
+#endif /* _SIDE_ARENA_H */
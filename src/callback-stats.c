@@ -0,0 +1,421 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <side/trace.h>
+
+#include "callback-stats.h"
+#include "smp.h"
+
+/*
+ * Number of entries per last-level cache, power of 2. With 64 bytes
+ * entries, each LLC costs 4 KB once statistics are first enabled.
+ * Samples of tuples beyond the table size on an LLC are dropped.
+ */
+#define SIDE_CALLBACK_STATS_TABLE_SIZE	64
+
+enum side_callback_stats_entry_state {
+	SIDE_CALLBACK_STATS_ENTRY_FREE = 0,
+	SIDE_CALLBACK_STATS_ENTRY_CLAIMED = 1,
+	SIDE_CALLBACK_STATS_ENTRY_READY = 2,
+};
+
+/*
+ * One table per LLC, shared by its CPUs: entries stay in a cache close
+ * to the CPUs updating them, without a table per CPU. Entries are
+ * claimed on first sample of an (event, callback, key) tuple on an
+ * LLC, and then updated with relaxed atomic operations. A thread
+ * migrated between getting the CPU number and updating the entry still
+ * accounts its sample correctly, only on a remote entry.
+ * Entries which are being claimed are skipped by lookups, which can
+ * lead to duplicate entries for a tuple. Duplicates are merged when
+ * iterating.
+ */
+struct side_callback_stats_entry {
+	uint32_t state;		/* enum side_callback_stats_entry_state */
+	const struct side_event_description *desc;
+	side_tracer_callback_func call;
+	void *priv;
+	uint64_t key;
+	uint64_t nr_samples;
+	uint64_t total_ns;
+	uint64_t max_ns;
+} __attribute__((aligned(64)));
+
+struct side_callback_stats_table {
+	struct side_callback_stats_entry entries[SIDE_CALLBACK_STATS_TABLE_SIZE];
+};
+
+/*
+ * Not registered along with the other events of this library, but when
+ * statistics are first enabled, so processes which never enable them
+ * do not expose this event to tracers.
+ */
+_side_define_event_description(static, static, side_callback_stats_event, "side", "callback_stats",
+	SIDE_LOGLEVEL_INFO,
+	_side_field_list(
+		_side_field_string("provider"),
+		_side_field_string("event"),
+		_side_field_pointer("callback"),
+		_side_field_pointer("priv"),
+		_side_field_u64("key"),
+		_side_field_u64("nr_samples"),
+		_side_field_u64("total_ns"),
+		_side_field_u64("max_ns"),
+	),
+	0, side_attr_list()
+);
+
+static struct side_event_description *side_callback_stats_events[] = {
+	&side_callback_stats_event,
+};
+
+uint32_t side_callback_stats_period;
+__thread uint32_t side_callback_stats_countdown;
+
+/* Allocated on first enable, freed by side_callback_stats_exit(). */
+static struct side_callback_stats_table *side_callback_stats_tables;
+static int side_callback_stats_nr_tables;
+
+static struct side_events_register_handle *side_callback_stats_events_handle;
+static struct side_statedump_request_handle *side_callback_stats_statedump_handle;
+
+/* Protects table allocation, iteration and removal of entries. */
+static pthread_mutex_t side_callback_stats_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Serializes enable and exit. Not taken by the statedump, so it can be
+ * held while registering the event and the statedump.
+ */
+static pthread_mutex_t side_callback_stats_enable_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static
+uint32_t side_callback_stats_hash(const struct side_event_description *desc,
+		side_tracer_callback_func call, void *priv, uint64_t key)
+{
+	uint64_t h;
+
+	h = (uint64_t) (uintptr_t) desc;
+	h = (h ^ (uint64_t) (uintptr_t) call) * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ (uint64_t) (uintptr_t) priv) * 0x9E3779B97F4A7C15ULL;
+	h = (h ^ key) * 0x9E3779B97F4A7C15ULL;
+	return (uint32_t) (h >> 32);
+}
+
+static
+bool side_callback_stats_entry_match(const struct side_callback_stats_entry *entry,
+		const struct side_event_description *desc,
+		side_tracer_callback_func call, void *priv, uint64_t key)
+{
+	return entry->desc == desc && entry->call == call &&
+		entry->priv == priv && entry->key == key;
+}
+
+void side_callback_stats_record(const struct side_event_description *desc,
+		side_tracer_callback_func call, void *priv, uint64_t key,
+		uint64_t ns)
+{
+	struct side_callback_stats_table *tables, *table;
+	struct side_callback_stats_entry *entry;
+	uint32_t hash, i;
+	uint64_t max;
+	int llc;
+
+	tables = __atomic_load_n(&side_callback_stats_tables, __ATOMIC_ACQUIRE);
+	if (side_unlikely(!tables))
+		return;
+	/* get_cpu_llc() maps a failed sched_getcpu() to LLC 0. */
+	llc = get_cpu_llc(sched_getcpu());
+	if (side_unlikely(llc >= side_callback_stats_nr_tables))
+		llc = 0;
+	table = &tables[llc];
+	hash = side_callback_stats_hash(desc, call, priv, key);
+	for (i = 0; i < SIDE_CALLBACK_STATS_TABLE_SIZE; i++) {
+		uint32_t state;
+
+		entry = &table->entries[(hash + i) & (SIDE_CALLBACK_STATS_TABLE_SIZE - 1)];
+		state = __atomic_load_n(&entry->state, __ATOMIC_ACQUIRE);
+		if (state == SIDE_CALLBACK_STATS_ENTRY_READY) {
+			if (side_callback_stats_entry_match(entry, desc, call, priv, key))
+				goto update;
+			continue;
+		}
+		if (state == SIDE_CALLBACK_STATS_ENTRY_FREE) {
+			uint32_t expected = SIDE_CALLBACK_STATS_ENTRY_FREE;
+
+			if (!__atomic_compare_exchange_n(&entry->state, &expected,
+					SIDE_CALLBACK_STATS_ENTRY_CLAIMED, false,
+					__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+				continue;
+			entry->desc = desc;
+			entry->call = call;
+			entry->priv = priv;
+			entry->key = key;
+			__atomic_store_n(&entry->state, SIDE_CALLBACK_STATS_ENTRY_READY, __ATOMIC_RELEASE);
+			goto update;
+		}
+	}
+	/* Table full: drop the sample. */
+	return;
+
+update:
+	(void) __atomic_add_fetch(&entry->nr_samples, 1, __ATOMIC_RELAXED);
+	(void) __atomic_add_fetch(&entry->total_ns, ns, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&entry->max_ns, __ATOMIC_RELAXED);
+	while (ns > max) {
+		if (__atomic_compare_exchange_n(&entry->max_ns, &max, ns, false,
+				__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			break;
+	}
+}
+
+static
+int side_callback_stats_compare(const void *a, const void *b)
+{
+	const struct side_callback_stats *sa = (const struct side_callback_stats *) a,
+		*sb = (const struct side_callback_stats *) b;
+
+	if (sa->desc != sb->desc)
+		return (uintptr_t) sa->desc < (uintptr_t) sb->desc ? -1 : 1;
+	if (sa->u.call != sb->u.call)
+		return (uintptr_t) sa->u.call < (uintptr_t) sb->u.call ? -1 : 1;
+	if (sa->priv != sb->priv)
+		return (uintptr_t) sa->priv < (uintptr_t) sb->priv ? -1 : 1;
+	if (sa->key != sb->key)
+		return sa->key < sb->key ? -1 : 1;
+	return 0;
+}
+
+/* Called with side_callback_stats_lock held. */
+static
+int _side_callback_stats_iterate(void (*cb)(const struct side_callback_stats *stats, void *priv),
+		void *priv)
+{
+	struct side_callback_stats *array;
+	size_t nr = 0, i, j;
+	int llc;
+
+	if (!side_callback_stats_tables)
+		return SIDE_ERROR_OK;
+	array = (struct side_callback_stats *) calloc((size_t) side_callback_stats_nr_tables * SIDE_CALLBACK_STATS_TABLE_SIZE,
+			sizeof(struct side_callback_stats));
+	if (!array)
+		return SIDE_ERROR_NOMEM;
+	for (llc = 0; llc < side_callback_stats_nr_tables; llc++) {
+		struct side_callback_stats_table *table = &side_callback_stats_tables[llc];
+
+		for (i = 0; i < SIDE_CALLBACK_STATS_TABLE_SIZE; i++) {
+			struct side_callback_stats_entry *entry = &table->entries[i];
+			struct side_callback_stats *stats = &array[nr];
+
+			if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) != SIDE_CALLBACK_STATS_ENTRY_READY)
+				continue;
+			stats->desc = entry->desc;
+			stats->u.call = entry->call;
+			stats->priv = entry->priv;
+			stats->key = entry->key;
+			stats->nr_samples = __atomic_load_n(&entry->nr_samples, __ATOMIC_RELAXED);
+			stats->total_ns = __atomic_load_n(&entry->total_ns, __ATOMIC_RELAXED);
+			stats->max_ns = __atomic_load_n(&entry->max_ns, __ATOMIC_RELAXED);
+			nr++;
+		}
+	}
+	/* Merge per-LLC and duplicate entries. */
+	qsort(array, nr, sizeof(struct side_callback_stats), side_callback_stats_compare);
+	for (i = 0; i < nr; i = j) {
+		struct side_callback_stats merged = array[i];
+
+		for (j = i + 1; j < nr && !side_callback_stats_compare(&array[i], &array[j]); j++) {
+			merged.nr_samples += array[j].nr_samples;
+			merged.total_ns += array[j].total_ns;
+			if (array[j].max_ns > merged.max_ns)
+				merged.max_ns = array[j].max_ns;
+		}
+		cb(&merged, priv);
+	}
+	free(array);
+	return SIDE_ERROR_OK;
+}
+
+static
+void side_callback_stats_statedump_event(const struct side_callback_stats *stats, void *priv)
+{
+	side_statedump_event_call(side_callback_stats_event, priv,
+		side_arg_list(
+			side_arg_string(side_ptr_get(stats->desc->provider_name)),
+			side_arg_string(side_ptr_get(stats->desc->event_name)),
+			side_arg_pointer(stats->u.call),
+			side_arg_pointer(stats->priv),
+			side_arg_u64(stats->key),
+			side_arg_u64(stats->nr_samples),
+			side_arg_u64(stats->total_ns),
+			side_arg_u64(stats->max_ns),
+		)
+	);
+}
+
+static
+void side_callback_stats_statedump(void *statedump_request_key)
+{
+	pthread_mutex_lock(&side_callback_stats_lock);
+	(void) _side_callback_stats_iterate(side_callback_stats_statedump_event, statedump_request_key);
+	pthread_mutex_unlock(&side_callback_stats_lock);
+}
+
+/*
+ * Allocate the tables, and register the statistics event and its
+ * statedump. Called with side_callback_stats_enable_lock held.
+ */
+static
+int side_callback_stats_init(void)
+{
+	if (!side_callback_stats_tables) {
+		struct side_callback_stats_table *tables;
+		int nr_llcs = get_nr_cpu_llcs();
+
+		tables = (struct side_callback_stats_table *) calloc(nr_llcs,
+				sizeof(struct side_callback_stats_table));
+		if (!tables)
+			return SIDE_ERROR_NOMEM;
+		pthread_mutex_lock(&side_callback_stats_lock);
+		side_callback_stats_nr_tables = nr_llcs;
+		__atomic_store_n(&side_callback_stats_tables, tables, __ATOMIC_RELEASE);
+		pthread_mutex_unlock(&side_callback_stats_lock);
+	}
+	if (!side_callback_stats_events_handle) {
+		side_callback_stats_events_handle = side_events_register_internal(side_callback_stats_events,
+				SIDE_ARRAY_SIZE(side_callback_stats_events));
+		if (!side_callback_stats_events_handle)
+			return SIDE_ERROR_NOMEM;
+	}
+	if (!side_callback_stats_statedump_handle) {
+		/*
+		 * Registration waits for the agent thread to dump the
+		 * state for all tracers, which takes
+		 * side_callback_stats_lock.
+		 */
+		side_callback_stats_statedump_handle = side_statedump_request_notification_register("side_callback_stats",
+				side_callback_stats_statedump, SIDE_STATEDUMP_MODE_AGENT_THREAD);
+		if (!side_callback_stats_statedump_handle)
+			return SIDE_ERROR_NOMEM;
+	}
+	return SIDE_ERROR_OK;
+}
+
+int side_tracer_callback_stats_enable(uint32_t sample_period)
+{
+	int ret = SIDE_ERROR_OK;
+
+	pthread_mutex_lock(&side_callback_stats_enable_lock);
+	if (sample_period)
+		ret = side_callback_stats_init();
+	if (ret == SIDE_ERROR_OK) {
+		__atomic_store_n(&side_callback_stats_period, sample_period, __ATOMIC_RELAXED);
+		side_dispatch_callback_stats_set(sample_period != 0);
+	}
+	pthread_mutex_unlock(&side_callback_stats_enable_lock);
+	return ret;
+}
+
+int side_tracer_callback_stats_iterate(void (*cb)(const struct side_callback_stats *stats, void *priv),
+		void *priv)
+{
+	int ret;
+
+	if (!cb)
+		return SIDE_ERROR_INVAL;
+	pthread_mutex_lock(&side_callback_stats_lock);
+	ret = _side_callback_stats_iterate(cb, priv);
+	pthread_mutex_unlock(&side_callback_stats_lock);
+	return ret;
+}
+
+static
+int side_callback_stats_desc_compare(const void *a, const void *b)
+{
+	uintptr_t pa = (uintptr_t) *(struct side_event_description * const *) a,
+		pb = (uintptr_t) *(struct side_event_description * const *) b;
+
+	if (pa == pb)
+		return 0;
+	return pa < pb ? -1 : 1;
+}
+
+/*
+ * Forget the entries of unregistered events. Called with
+ * side_event_lock held, once their instrumentation is unreachable.
+ */
+void side_callback_stats_remove_events(struct side_event_description **events, uint32_t nr_events)
+{
+	struct side_event_description **sorted;
+	int llc;
+
+	pthread_mutex_lock(&side_callback_stats_lock);
+	if (!side_callback_stats_tables || !nr_events)
+		goto end;
+	sorted = (struct side_event_description **) malloc(nr_events * sizeof(*sorted));
+	if (!sorted)
+		abort();
+	memcpy(sorted, events, nr_events * sizeof(*sorted));
+	qsort(sorted, nr_events, sizeof(*sorted), side_callback_stats_desc_compare);
+	for (llc = 0; llc < side_callback_stats_nr_tables; llc++) {
+		struct side_callback_stats_table *table = &side_callback_stats_tables[llc];
+		uint32_t i;
+
+		for (i = 0; i < SIDE_CALLBACK_STATS_TABLE_SIZE; i++) {
+			struct side_callback_stats_entry *entry = &table->entries[i];
+
+			if (__atomic_load_n(&entry->state, __ATOMIC_ACQUIRE) != SIDE_CALLBACK_STATS_ENTRY_READY)
+				continue;
+			if (!bsearch(&entry->desc, sorted, nr_events, sizeof(*sorted),
+					side_callback_stats_desc_compare))
+				continue;
+			entry->desc = NULL;
+			entry->call = NULL;
+			entry->priv = NULL;
+			entry->key = 0;
+			entry->nr_samples = 0;
+			entry->total_ns = 0;
+			entry->max_ns = 0;
+			__atomic_store_n(&entry->state, SIDE_CALLBACK_STATS_ENTRY_FREE, __ATOMIC_RELEASE);
+		}
+	}
+	free(sorted);
+end:
+	pthread_mutex_unlock(&side_callback_stats_lock);
+}
+
+/* Called from side_exit(), before the events are unregistered. */
+void side_callback_stats_exit(void)
+{
+	pthread_mutex_lock(&side_callback_stats_enable_lock);
+	side_dispatch_callback_stats_set(false);
+	__atomic_store_n(&side_callback_stats_period, 0, __ATOMIC_RELAXED);
+	if (side_callback_stats_statedump_handle) {
+		side_statedump_request_notification_unregister(side_callback_stats_statedump_handle);
+		side_callback_stats_statedump_handle = NULL;
+	}
+	side_events_unregister(side_callback_stats_events_handle);
+	side_callback_stats_events_handle = NULL;
+	pthread_mutex_lock(&side_callback_stats_lock);
+	free(side_callback_stats_tables);
+	side_callback_stats_tables = NULL;
+	pthread_mutex_unlock(&side_callback_stats_lock);
+	pthread_mutex_unlock(&side_callback_stats_enable_lock);
+}
+
+uint64_t side_callback_stats_memory_usage(void)
+{
+	uint64_t bytes = 0;
+
+	pthread_mutex_lock(&side_callback_stats_lock);
+	if (side_callback_stats_tables)
+		bytes = (uint64_t) side_callback_stats_nr_tables * sizeof(struct side_callback_stats_table);
+	pthread_mutex_unlock(&side_callback_stats_lock);
+	return bytes;
+}
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#ifndef _SIDE_CALLBACK_STATS_H
+#define _SIDE_CALLBACK_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <side/trace.h>
+
+/*
+ * Sampled timing of tracer callbacks. One side_call() out of
+ * side_callback_stats_period (per thread) times each of the callbacks
+ * it invokes. side_call_batch() counts as one side_call(), and a batch
+ * callback invocation as one sample. Timing is disabled when the period
+ * is 0.
+ *
+ * Dispatch tests whether statistics are enabled in the dispatch state
+ * word it loads anyway, and only then calls side_callback_stats_sample().
+ */
+extern uint32_t side_callback_stats_period __attribute__((visibility("hidden")));
+extern __thread uint32_t side_callback_stats_countdown __attribute__((visibility("hidden")));
+
+/* Set the statistics bit of the dispatch state, see side.c. */
+void side_dispatch_callback_stats_set(bool enabled)
+	__attribute__((visibility("hidden")));
+
+/*
+ * Register this library's own events, without registering the fast
+ * exit handler, see side.c.
+ */
+struct side_events_register_handle *side_events_register_internal(struct side_event_description **events,
+		uint32_t nr_events)
+	__attribute__((visibility("hidden")));
+
+static inline
+bool side_callback_stats_sample(void)
+{
+	uint32_t period = __atomic_load_n(&side_callback_stats_period, __ATOMIC_RELAXED);
+
+	if (side_unlikely(!period))
+		return false;
+	if (side_callback_stats_countdown) {
+		side_callback_stats_countdown--;
+		return false;
+	}
+	side_callback_stats_countdown = period - 1;
+	return true;
+}
+
+static inline
+uint64_t side_callback_stats_clock(void)
+{
+	struct timespec ts;
+
+	(void) clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void side_callback_stats_record(const struct side_event_description *desc,
+		side_tracer_callback_func call, void *priv, uint64_t key,
+		uint64_t ns)
+	__attribute__((visibility("hidden")));
+
+void side_callback_stats_remove_events(struct side_event_description **events, uint32_t nr_events)
+	__attribute__((visibility("hidden")));
+
+void side_callback_stats_exit(void)
+	__attribute__((visibility("hidden")));
+
+uint64_t side_callback_stats_memory_usage(void)
+	__attribute__((visibility("hidden")));
+
+#endif /* _SIDE_CALLBACK_STATS_H */
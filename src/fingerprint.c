@@ -0,0 +1,492 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <string.h>
+#include <side/trace.h>
+
+#include "fingerprint.h"
+
+/*
+ * Event description fingerprint: 64-bit FNV-1a hash of a canonical
+ * serialization of the event description. Pointers are never hashed:
+ * strings are hashed by content, and nested types, fields, attributes
+ * and enumeration mappings are hashed by walking the description. Each
+ * variable-length item is preceded by its length so that distinct
+ * descriptions cannot serialize to the same byte sequence. Multi-byte
+ * integers and floating point values are hashed in little-endian byte
+ * order.
+ */
+
+#define SIDE_FINGERPRINT_OFFSET_BASIS	0xcbf29ce484222325ULL
+#define SIDE_FINGERPRINT_PRIME		0x100000001b3ULL
+
+static
+void fp_u8(uint64_t *h, uint8_t v)
+{
+	*h ^= v;
+	*h *= SIDE_FINGERPRINT_PRIME;
+}
+
+static
+void fp_bytes(uint64_t *h, const void *p, size_t len)
+{
+	const uint8_t *b = (const uint8_t *) p;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		fp_u8(h, b[i]);
+}
+
+static
+void fp_float_bytes(uint64_t *h, const void *p, size_t len)
+{
+#if (SIDE_FLOAT_WORD_ORDER == SIDE_LITTLE_ENDIAN)
+	fp_bytes(h, p, len);
+#else
+	const uint8_t *b = (const uint8_t *) p;
+	size_t i;
+
+	for (i = len; i > 0; i--)
+		fp_u8(h, b[i - 1]);
+#endif
+}
+
+static
+void fp_u64(uint64_t *h, uint64_t v)
+{
+	int i;
+
+	for (i = 0; i < 8; i++)
+		fp_u8(h, (uint8_t) (v >> (8 * i)));
+}
+
+static
+void fp_string(uint64_t *h, const char *s)
+{
+	size_t len;
+
+	if (!s) {
+		fp_u64(h, UINT64_MAX);
+		return;
+	}
+	len = strlen(s);
+	fp_u64(h, len);
+	fp_bytes(h, s, len);
+}
+
+static
+void fp_raw_string(uint64_t *h, const struct side_type_raw_string *s)
+{
+	const uint8_t *p = (const uint8_t *) side_ptr_get(s->p);
+	size_t len = 0, unit_size = s->unit_size;
+
+	fp_u8(h, s->unit_size);
+	fp_u8(h, side_enum_get(s->byte_order));
+	if (!p || !unit_size) {
+		fp_u64(h, UINT64_MAX);
+		return;
+	}
+	for (;;) {
+		size_t i;
+
+		for (i = 0; i < unit_size; i++) {
+			if (p[len + i])
+				break;
+		}
+		if (i == unit_size)
+			break;
+		len += unit_size;
+	}
+	fp_u64(h, len);
+	fp_bytes(h, p, len);
+}
+
+static
+void fp_attr_value(uint64_t *h, const struct side_attr *attr)
+{
+	enum side_attr_type type = side_enum_get(attr->value.type);
+
+	fp_u64(h, type);
+	switch (type) {
+	case SIDE_ATTR_TYPE_NULL:
+		break;
+	case SIDE_ATTR_TYPE_BOOL:
+		fp_u8(h, !!attr->value.u.bool_value);
+		break;
+	case SIDE_ATTR_TYPE_U8:
+		fp_u64(h, attr->value.u.integer_value.side_u8);
+		break;
+	case SIDE_ATTR_TYPE_U16:
+		fp_u64(h, attr->value.u.integer_value.side_u16);
+		break;
+	case SIDE_ATTR_TYPE_U32:
+		fp_u64(h, attr->value.u.integer_value.side_u32);
+		break;
+	case SIDE_ATTR_TYPE_U64:
+		fp_u64(h, attr->value.u.integer_value.side_u64);
+		break;
+	case SIDE_ATTR_TYPE_S8:
+		fp_u64(h, (uint64_t) (int64_t) attr->value.u.integer_value.side_s8);
+		break;
+	case SIDE_ATTR_TYPE_S16:
+		fp_u64(h, (uint64_t) (int64_t) attr->value.u.integer_value.side_s16);
+		break;
+	case SIDE_ATTR_TYPE_S32:
+		fp_u64(h, (uint64_t) (int64_t) attr->value.u.integer_value.side_s32);
+		break;
+	case SIDE_ATTR_TYPE_S64:
+		fp_u64(h, (uint64_t) attr->value.u.integer_value.side_s64);
+		break;
+	case SIDE_ATTR_TYPE_U128:
+	case SIDE_ATTR_TYPE_S128:
+		fp_u64(h, attr->value.u.integer_value.side_u128_split[SIDE_INTEGER128_SPLIT_LOW]);
+		fp_u64(h, attr->value.u.integer_value.side_u128_split[SIDE_INTEGER128_SPLIT_HIGH]);
+		break;
+	case SIDE_ATTR_TYPE_FLOAT_BINARY16:
+		fp_float_bytes(h, &attr->value.u.float_value, 2);
+		break;
+	case SIDE_ATTR_TYPE_FLOAT_BINARY32:
+		fp_float_bytes(h, &attr->value.u.float_value, 4);
+		break;
+	case SIDE_ATTR_TYPE_FLOAT_BINARY64:
+		fp_float_bytes(h, &attr->value.u.float_value, 8);
+		break;
+	case SIDE_ATTR_TYPE_FLOAT_BINARY128:
+		fp_float_bytes(h, &attr->value.u.float_value, 16);
+		break;
+	case SIDE_ATTR_TYPE_STRING:
+		fp_raw_string(h, &attr->value.u.string_value);
+		break;
+	default:
+		/* Unknown attribute types are identified by their label only. */
+		break;
+	}
+}
+
+static
+void fp_attributes(uint64_t *h, const struct side_attr *attr, uint32_t nr_attr)
+{
+	uint32_t i;
+
+	fp_u64(h, nr_attr);
+	for (i = 0; i < nr_attr; i++) {
+		fp_raw_string(h, &attr[i].key);
+		fp_attr_value(h, &attr[i]);
+	}
+}
+
+static
+void fp_enum_mappings(uint64_t *h, const struct side_enum_mappings *mappings)
+{
+	uint32_t i;
+
+	fp_u64(h, side_array_length(&mappings->mappings));
+	for (i = 0; i < side_array_length(&mappings->mappings); i++) {
+		const struct side_enum_mapping *mapping = side_array_at(&mappings->mappings, i);
+
+		fp_u64(h, (uint64_t) mapping->range_begin);
+		fp_u64(h, (uint64_t) mapping->range_end);
+		fp_raw_string(h, &mapping->label);
+	}
+	fp_attributes(h, side_array_elements(&mappings->attributes), side_array_length(&mappings->attributes));
+}
+
+static
+void fp_enum_bitmap_mappings(uint64_t *h, const struct side_enum_bitmap_mappings *mappings)
+{
+	uint32_t i;
+
+	fp_u64(h, side_array_length(&mappings->mappings));
+	for (i = 0; i < side_array_length(&mappings->mappings); i++) {
+		const struct side_enum_bitmap_mapping *mapping = side_array_at(&mappings->mappings, i);
+
+		fp_u64(h, mapping->range_begin);
+		fp_u64(h, mapping->range_end);
+		fp_raw_string(h, &mapping->label);
+	}
+	fp_attributes(h, side_array_elements(&mappings->attributes), side_array_length(&mappings->attributes));
+}
+
+static
+void fp_bool(uint64_t *h, const struct side_type_bool *type)
+{
+	fp_attributes(h, side_array_elements(&type->attributes), side_array_length(&type->attributes));
+	fp_u64(h, type->bool_size);
+	fp_u64(h, type->len_bits);
+	fp_u8(h, side_enum_get(type->byte_order));
+}
+
+static
+void fp_integer(uint64_t *h, const struct side_type_integer *type)
+{
+	fp_attributes(h, side_array_elements(&type->attributes), side_array_length(&type->attributes));
+	fp_u64(h, type->integer_size);
+	fp_u64(h, type->len_bits);
+	fp_u8(h, type->signedness);
+	fp_u8(h, side_enum_get(type->byte_order));
+}
+
+static
+void fp_float(uint64_t *h, const struct side_type_float *type)
+{
+	fp_attributes(h, side_array_elements(&type->attributes), side_array_length(&type->attributes));
+	fp_u64(h, type->float_size);
+	fp_u8(h, side_enum_get(type->byte_order));
+}
+
+static
+void fp_string_type(uint64_t *h, const struct side_type_string *type)
+{
+	fp_attributes(h, side_array_elements(&type->attributes), side_array_length(&type->attributes));
+	fp_u8(h, type->unit_size);
+	fp_u8(h, side_enum_get(type->byte_order));
+}
+
+static
+void fp_type(uint64_t *h, const struct side_type *type);
+
+static
+void fp_fields(uint64_t *h, const struct side_event_field *fields, uint32_t nr_fields)
+{
+	uint32_t i;
+
+	fp_u64(h, nr_fields);
+	for (i = 0; i < nr_fields; i++) {
+		fp_string(h, side_ptr_get(fields[i].field_name));
+		fp_type(h, &fields[i].side_type);
+	}
+}
+
+static
+void fp_struct(uint64_t *h, const struct side_type_struct *side_struct)
+{
+	fp_fields(h, side_array_elements(&side_struct->fields), side_array_length(&side_struct->fields));
+	fp_attributes(h, side_array_elements(&side_struct->attributes), side_array_length(&side_struct->attributes));
+}
+
+static
+void fp_array(uint64_t *h, const struct side_type_array *side_array)
+{
+	fp_type(h, side_ptr_get(side_array->elem_type));
+	fp_u64(h, side_array->length);
+	fp_attributes(h, side_array_elements(&side_array->attributes), side_array_length(&side_array->attributes));
+}
+
+static
+void fp_vla(uint64_t *h, const struct side_type_vla *side_vla)
+{
+	fp_type(h, side_ptr_get(side_vla->elem_type));
+	fp_type(h, side_ptr_get(side_vla->length_type));
+	fp_attributes(h, side_array_elements(&side_vla->attributes), side_array_length(&side_vla->attributes));
+}
+
+static
+void fp_gather(uint64_t *h, enum side_type_label label, const struct side_type_gather *gather)
+{
+	switch (label) {
+	case SIDE_TYPE_GATHER_BOOL:
+		fp_u64(h, gather->u.side_bool.offset);
+		fp_u64(h, gather->u.side_bool.offset_bits);
+		fp_u8(h, side_enum_get(gather->u.side_bool.access_mode));
+		fp_bool(h, &gather->u.side_bool.type);
+		break;
+	case SIDE_TYPE_GATHER_INTEGER:
+	case SIDE_TYPE_GATHER_POINTER:
+		fp_u64(h, gather->u.side_integer.offset);
+		fp_u64(h, gather->u.side_integer.offset_bits);
+		fp_u8(h, side_enum_get(gather->u.side_integer.access_mode));
+		fp_integer(h, &gather->u.side_integer.type);
+		break;
+	case SIDE_TYPE_GATHER_BYTE:
+		fp_u64(h, gather->u.side_byte.offset);
+		fp_u8(h, side_enum_get(gather->u.side_byte.access_mode));
+		fp_attributes(h, side_array_elements(&gather->u.side_byte.type.attributes),
+			side_array_length(&gather->u.side_byte.type.attributes));
+		break;
+	case SIDE_TYPE_GATHER_FLOAT:
+		fp_u64(h, gather->u.side_float.offset);
+		fp_u8(h, side_enum_get(gather->u.side_float.access_mode));
+		fp_float(h, &gather->u.side_float.type);
+		break;
+	case SIDE_TYPE_GATHER_STRING:
+		fp_u64(h, gather->u.side_string.offset);
+		fp_u8(h, side_enum_get(gather->u.side_string.access_mode));
+		fp_string_type(h, &gather->u.side_string.type);
+		break;
+	case SIDE_TYPE_GATHER_STRUCT:
+		fp_struct(h, side_ptr_get(gather->u.side_struct.type));
+		fp_u64(h, gather->u.side_struct.offset);
+		fp_u8(h, side_enum_get(gather->u.side_struct.access_mode));
+		fp_u64(h, gather->u.side_struct.size);
+		break;
+	case SIDE_TYPE_GATHER_ARRAY:
+		fp_u64(h, gather->u.side_array.offset);
+		fp_u8(h, side_enum_get(gather->u.side_array.access_mode));
+		fp_array(h, &gather->u.side_array.type);
+		break;
+	case SIDE_TYPE_GATHER_VLA:
+		fp_u64(h, gather->u.side_vla.offset);
+		fp_u8(h, side_enum_get(gather->u.side_vla.access_mode));
+		fp_vla(h, &gather->u.side_vla.type);
+		break;
+	case SIDE_TYPE_GATHER_IOVEC:
+		fp_u64(h, gather->u.side_iovec.offset);
+		fp_u8(h, side_enum_get(gather->u.side_iovec.access_mode));
+		fp_u64(h, gather->u.side_iovec.capture_max);
+		fp_type(h, side_ptr_get(gather->u.side_iovec.length_type));
+		fp_attributes(h, side_array_elements(&gather->u.side_iovec.attributes),
+			side_array_length(&gather->u.side_iovec.attributes));
+		break;
+	case SIDE_TYPE_GATHER_ENUM:
+		fp_enum_mappings(h, side_ptr_get(gather->u.side_enum.mappings));
+		fp_type(h, side_ptr_get(gather->u.side_enum.elem_type));
+		break;
+	default:
+		break;
+	}
+}
+
+static
+void fp_type(uint64_t *h, const struct side_type *type)
+{
+	enum side_type_label label;
+
+	if (!type) {
+		fp_u64(h, UINT64_MAX);
+		return;
+	}
+	label = side_enum_get(type->type);
+	fp_u64(h, label);
+	switch (label) {
+	/* Stack-copy basic types */
+	case SIDE_TYPE_NULL:
+		fp_attributes(h, side_array_elements(&type->u.side_null.attributes),
+			side_array_length(&type->u.side_null.attributes));
+		break;
+	case SIDE_TYPE_BOOL:
+		fp_bool(h, &type->u.side_bool);
+		break;
+	case SIDE_TYPE_U8:
+	case SIDE_TYPE_U16:
+	case SIDE_TYPE_U32:
+	case SIDE_TYPE_U64:
+	case SIDE_TYPE_U128:
+	case SIDE_TYPE_S8:
+	case SIDE_TYPE_S16:
+	case SIDE_TYPE_S32:
+	case SIDE_TYPE_S64:
+	case SIDE_TYPE_S128:
+	case SIDE_TYPE_POINTER:
+		fp_integer(h, &type->u.side_integer);
+		break;
+	case SIDE_TYPE_BYTE:
+		fp_attributes(h, side_array_elements(&type->u.side_byte.attributes),
+			side_array_length(&type->u.side_byte.attributes));
+		break;
+	case SIDE_TYPE_FLOAT_BINARY16:
+	case SIDE_TYPE_FLOAT_BINARY32:
+	case SIDE_TYPE_FLOAT_BINARY64:
+	case SIDE_TYPE_FLOAT_BINARY128:
+		fp_float(h, &type->u.side_float);
+		break;
+	case SIDE_TYPE_STRING_UTF8:
+	case SIDE_TYPE_STRING_UTF16:
+	case SIDE_TYPE_STRING_UTF32:
+		fp_string_type(h, &type->u.side_string);
+		break;
+
+	/* Stack-copy compound types */
+	case SIDE_TYPE_STRUCT:
+		fp_struct(h, side_ptr_get(type->u.side_struct));
+		break;
+	case SIDE_TYPE_VARIANT:
+	{
+		const struct side_type_variant *side_variant = side_ptr_get(type->u.side_variant);
+		uint32_t i;
+
+		fp_type(h, &side_variant->selector);
+		fp_u64(h, side_array_length(&side_variant->options));
+		for (i = 0; i < side_array_length(&side_variant->options); i++) {
+			const struct side_variant_option *option = side_array_at(&side_variant->options, i);
+
+			fp_u64(h, (uint64_t) option->range_begin);
+			fp_u64(h, (uint64_t) option->range_end);
+			fp_type(h, &option->side_type);
+		}
+		fp_attributes(h, side_array_elements(&side_variant->attributes),
+			side_array_length(&side_variant->attributes));
+		break;
+	}
+	case SIDE_TYPE_OPTIONAL:
+	{
+		const struct side_type_optional *side_optional = side_ptr_get(type->u.side_optional);
+
+		fp_type(h, side_ptr_get(side_optional->elem_type));
+		fp_attributes(h, side_array_elements(&side_optional->attributes),
+			side_array_length(&side_optional->attributes));
+		break;
+	}
+	case SIDE_TYPE_ARRAY:
+		fp_array(h, side_ptr_get(type->u.side_array));
+		break;
+	case SIDE_TYPE_VLA:
+		fp_vla(h, side_ptr_get(type->u.side_vla));
+		break;
+	case SIDE_TYPE_VLA_VISITOR:
+	{
+		const struct side_type_vla_visitor *side_vla_visitor = side_ptr_get(type->u.side_vla_visitor);
+
+		/* The visitor function address is not part of the fingerprint. */
+		fp_type(h, side_ptr_get(side_vla_visitor->elem_type));
+		fp_type(h, side_ptr_get(side_vla_visitor->length_type));
+		fp_attributes(h, side_array_elements(&side_vla_visitor->attributes),
+			side_array_length(&side_vla_visitor->attributes));
+		break;
+	}
+
+	/* Stack-copy enumeration types */
+	case SIDE_TYPE_ENUM:
+		fp_enum_mappings(h, side_ptr_get(type->u.side_enum.mappings));
+		fp_type(h, side_ptr_get(type->u.side_enum.elem_type));
+		break;
+	case SIDE_TYPE_ENUM_BITMAP:
+		fp_enum_bitmap_mappings(h, side_ptr_get(type->u.side_enum_bitmap.mappings));
+		fp_type(h, side_ptr_get(type->u.side_enum_bitmap.elem_type));
+		break;
+
+	/* Gather types */
+	case SIDE_TYPE_GATHER_BOOL:
+	case SIDE_TYPE_GATHER_INTEGER:
+	case SIDE_TYPE_GATHER_BYTE:
+	case SIDE_TYPE_GATHER_POINTER:
+	case SIDE_TYPE_GATHER_FLOAT:
+	case SIDE_TYPE_GATHER_STRING:
+	case SIDE_TYPE_GATHER_STRUCT:
+	case SIDE_TYPE_GATHER_ARRAY:
+	case SIDE_TYPE_GATHER_VLA:
+	case SIDE_TYPE_GATHER_IOVEC:
+	case SIDE_TYPE_GATHER_ENUM:
+		fp_gather(h, label, &type->u.side_gather);
+		break;
+
+	/* Dynamic types are described by their label only. */
+	default:
+		break;
+	}
+}
+
+uint64_t side_event_description_compute_fingerprint(const struct side_event_description *desc)
+{
+	uint64_t h = SIDE_FINGERPRINT_OFFSET_BASIS;
+
+	fp_u64(&h, desc->version);
+	fp_string(&h, side_ptr_get(desc->provider_name));
+	fp_string(&h, side_ptr_get(desc->event_name));
+	fp_u64(&h, desc->flags);
+	fp_u64(&h, side_enum_get(desc->loglevel));
+	fp_fields(&h, side_array_elements(&desc->fields), side_array_length(&desc->fields));
+	fp_attributes(&h, side_array_elements(&desc->attributes), side_array_length(&desc->attributes));
+	return h;
+}
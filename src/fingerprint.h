@@ -0,0 +1,14 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#ifndef _SIDE_FINGERPRINT_H
+#define _SIDE_FINGERPRINT_H
+
+#include <stdint.h>
+#include <side/trace.h>
+
+uint64_t side_event_description_compute_fingerprint(const struct side_event_description *desc);
+
+#endif /* _SIDE_FINGERPRINT_H */
@@ -0,0 +1,475 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <side/trace.h>
+#include <string.h>
+
+/*
+ * Raw capture of gather events.
+ *
+ * A capture plan is computed once from the event description. It
+ * lists, for each event field, the contiguous range of application
+ * memory referenced by the gather description, starting at the offset
+ * of the field from the gather base pointer. Capturing an event is then
+ * a sequence of memcpy, one per field, into a buffer of fixed size.
+ *
+ * The plan also holds a copy of the event description whose gather
+ * fields are rebased on the captured copy, i.e. with a top-level offset
+ * of 0. Decoding rebuilds gather arguments pointing to the start of
+ * each captured range, so the event can be visited later against the
+ * rebased description without forming pointers outside of the buffer.
+ *
+ * Only fixed-layout fields can be planned: gather types with direct
+ * access (bool, byte, integer, pointer, float, enum, and structures
+ * and arrays thereof), and stack-copy basic types, of which only the
+ * value bytes are copied.
+ *
+ * Each argument type is checked against the plan when capturing, so
+ * arguments which do not match the event description are rejected
+ * before any application memory is read.
+ */
+
+enum side_gather_capture_op_type {
+	SIDE_GATHER_CAPTURE_OP_GATHER,
+	SIDE_GATHER_CAPTURE_OP_ARG,
+};
+
+struct side_gather_capture_op {
+	enum side_gather_capture_op_type type;
+	enum side_type_label label;	/* Expected argument type. */
+	uint64_t src_offset;	/* bytes, field offset from gather base pointer */
+	uint64_t buf_offset;	/* bytes */
+	uint32_t len;		/* bytes */
+};
+
+struct side_gather_capture_plan {
+	struct side_event_description desc;	/* Rebased on the captured buffer. */
+	struct side_event_field *fields;
+	struct side_type *enum_elem_types;	/* Rebased gather enum elements. */
+	size_t size;		/* Captured bytes. */
+	uint32_t nr_ops;	/* One op per event field. */
+	struct side_gather_capture_op ops[];
+};
+
+/*
+ * Compute the memory range [lo, hi) referenced by a gather type
+ * relative to its base pointer, and the stride consumed by the type
+ * when used as array element. Return false if the type layout cannot
+ * be computed from its description.
+ */
+static
+bool gather_type_extent(const struct side_type *type_desc, uint64_t *lo, uint64_t *hi, uint64_t *stride)
+{
+	const struct side_type_gather *type_gather = &type_desc->u.side_gather;
+
+	switch (side_enum_get(type_desc->type)) {
+	case SIDE_TYPE_GATHER_BOOL:
+		if (side_enum_get(type_gather->u.side_bool.access_mode) != SIDE_TYPE_GATHER_ACCESS_DIRECT)
+			return false;
+		*lo = type_gather->u.side_bool.offset;
+		*stride = type_gather->u.side_bool.type.bool_size;
+		*hi = *lo + *stride;
+		return true;
+	case SIDE_TYPE_GATHER_BYTE:
+		if (side_enum_get(type_gather->u.side_byte.access_mode) != SIDE_TYPE_GATHER_ACCESS_DIRECT)
+			return false;
+		*lo = type_gather->u.side_byte.offset;
+		*stride = 1;
+		*hi = *lo + *stride;
+		return true;
+	case SIDE_TYPE_GATHER_INTEGER:
+	case SIDE_TYPE_GATHER_POINTER:
+		if (side_enum_get(type_gather->u.side_integer.access_mode) != SIDE_TYPE_GATHER_ACCESS_DIRECT)
+			return false;
+		*lo = type_gather->u.side_integer.offset;
+		*stride = type_gather->u.side_integer.type.integer_size;
+		*hi = *lo + *stride;
+		return true;
+	case SIDE_TYPE_GATHER_FLOAT:
+		if (side_enum_get(type_gather->u.side_float.access_mode) != SIDE_TYPE_GATHER_ACCESS_DIRECT)
+			return false;
+		*lo = type_gather->u.side_float.offset;
+		*stride = type_gather->u.side_float.type.float_size;
+		*hi = *lo + *stride;
+		return true;
+	case SIDE_TYPE_GATHER_ENUM:
+	{
+		const struct side_type *elem_type = side_ptr_get(type_gather->u.side_enum.elem_type);
+
+		if (side_enum_get(elem_type->type) != SIDE_TYPE_GATHER_INTEGER)
+			return false;
+		return gather_type_extent(elem_type, lo, hi, stride);
+	}
+	case SIDE_TYPE_GATHER_STRUCT:
+	{
+		const struct side_type_struct *side_struct = side_ptr_get(type_gather->u.side_struct.type);
+		uint64_t offset = type_gather->u.side_struct.offset;
+		uint64_t struct_lo = UINT64_MAX, struct_hi = 0;
+		uint32_t i;
+
+		if (side_enum_get(type_gather->u.side_struct.access_mode) != SIDE_TYPE_GATHER_ACCESS_DIRECT)
+			return false;
+		for (i = 0; i < side_array_length(&side_struct->fields); i++) {
+			const struct side_event_field *field = side_array_at(&side_struct->fields, i);
+			uint64_t field_lo, field_hi, field_stride;
+
+			if (!gather_type_extent(&field->side_type, &field_lo, &field_hi, &field_stride))
+				return false;
+			if (field_lo < struct_lo)
+				struct_lo = field_lo;
+			if (field_hi > struct_hi)
+				struct_hi = field_hi;
+		}
+		if (struct_lo > struct_hi)
+			struct_lo = struct_hi = 0;
+		*lo = offset + struct_lo;
+		*hi = offset + struct_hi;
+		*stride = type_gather->u.side_struct.size;
+		return true;
+	}
+	case SIDE_TYPE_GATHER_ARRAY:
+	{
+		const struct side_type_array *side_array = &type_gather->u.side_array.type;
+		uint64_t offset = type_gather->u.side_array.offset;
+		uint64_t elem_lo, elem_hi, elem_stride;
+
+		if (side_enum_get(type_gather->u.side_array.access_mode) != SIDE_TYPE_GATHER_ACCESS_DIRECT)
+			return false;
+		if (!gather_type_extent(side_ptr_get(side_array->elem_type), &elem_lo, &elem_hi, &elem_stride))
+			return false;
+		if (!side_array->length) {
+			*lo = *hi = offset;
+			*stride = 0;
+			return true;
+		}
+		*lo = offset + elem_lo;
+		*hi = offset + (uint64_t) (side_array->length - 1) * elem_stride + elem_hi;
+		*stride = (uint64_t) side_array->length * elem_stride;
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+/* Offset of a gather type from its base pointer. */
+static
+uint64_t gather_type_offset(const struct side_type *type_desc)
+{
+	const struct side_type_gather *type_gather = &type_desc->u.side_gather;
+
+	switch (side_enum_get(type_desc->type)) {
+	case SIDE_TYPE_GATHER_BOOL:
+		return type_gather->u.side_bool.offset;
+	case SIDE_TYPE_GATHER_BYTE:
+		return type_gather->u.side_byte.offset;
+	case SIDE_TYPE_GATHER_INTEGER:
+	case SIDE_TYPE_GATHER_POINTER:
+		return type_gather->u.side_integer.offset;
+	case SIDE_TYPE_GATHER_FLOAT:
+		return type_gather->u.side_float.offset;
+	case SIDE_TYPE_GATHER_STRUCT:
+		return type_gather->u.side_struct.offset;
+	case SIDE_TYPE_GATHER_ARRAY:
+		return type_gather->u.side_array.offset;
+	default:
+		abort();
+	}
+}
+
+static
+void gather_type_clear_offset(struct side_type *type_desc)
+{
+	struct side_type_gather *type_gather = &type_desc->u.side_gather;
+
+	switch (side_enum_get(type_desc->type)) {
+	case SIDE_TYPE_GATHER_BOOL:
+		type_gather->u.side_bool.offset = 0;
+		break;
+	case SIDE_TYPE_GATHER_BYTE:
+		type_gather->u.side_byte.offset = 0;
+		break;
+	case SIDE_TYPE_GATHER_INTEGER:
+	case SIDE_TYPE_GATHER_POINTER:
+		type_gather->u.side_integer.offset = 0;
+		break;
+	case SIDE_TYPE_GATHER_FLOAT:
+		type_gather->u.side_float.offset = 0;
+		break;
+	case SIDE_TYPE_GATHER_STRUCT:
+		type_gather->u.side_struct.offset = 0;
+		break;
+	case SIDE_TYPE_GATHER_ARRAY:
+		type_gather->u.side_array.offset = 0;
+		break;
+	default:
+		abort();
+	}
+}
+
+static
+bool capture_arg_type(enum side_type_label label)
+{
+	switch (label) {
+	case SIDE_TYPE_NULL:
+	case SIDE_TYPE_BOOL:
+	case SIDE_TYPE_U8:
+	case SIDE_TYPE_U16:
+	case SIDE_TYPE_U32:
+	case SIDE_TYPE_U64:
+	case SIDE_TYPE_U128:
+	case SIDE_TYPE_S8:
+	case SIDE_TYPE_S16:
+	case SIDE_TYPE_S32:
+	case SIDE_TYPE_S64:
+	case SIDE_TYPE_S128:
+	case SIDE_TYPE_BYTE:
+	case SIDE_TYPE_POINTER:
+	case SIDE_TYPE_FLOAT_BINARY16:
+	case SIDE_TYPE_FLOAT_BINARY32:
+	case SIDE_TYPE_FLOAT_BINARY64:
+	case SIDE_TYPE_FLOAT_BINARY128:
+	case SIDE_TYPE_ENUM:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/*
+ * Size of the value of a stack-copy basic type, and label of its
+ * arguments. Enumeration arguments are passed as their element type.
+ */
+static
+uint32_t capture_arg_value_size(const struct side_type *type_desc, enum side_type_label *label)
+{
+	*label = side_enum_get(type_desc->type);
+	switch (*label) {
+	case SIDE_TYPE_NULL:
+		return 0;
+	case SIDE_TYPE_BOOL:
+		return type_desc->u.side_bool.bool_size;
+	case SIDE_TYPE_BYTE:
+		return sizeof(uint8_t);
+	case SIDE_TYPE_U8:
+	case SIDE_TYPE_U16:
+	case SIDE_TYPE_U32:
+	case SIDE_TYPE_U64:
+	case SIDE_TYPE_U128:
+	case SIDE_TYPE_S8:
+	case SIDE_TYPE_S16:
+	case SIDE_TYPE_S32:
+	case SIDE_TYPE_S64:
+	case SIDE_TYPE_S128:
+	case SIDE_TYPE_POINTER:
+		return type_desc->u.side_integer.integer_size;
+	case SIDE_TYPE_FLOAT_BINARY16:
+	case SIDE_TYPE_FLOAT_BINARY32:
+	case SIDE_TYPE_FLOAT_BINARY64:
+	case SIDE_TYPE_FLOAT_BINARY128:
+		return type_desc->u.side_float.float_size;
+	case SIDE_TYPE_ENUM:
+		return capture_arg_value_size(side_ptr_get(type_desc->u.side_enum.elem_type), label);
+	default:
+		abort();
+	}
+}
+
+static
+const void *gather_arg_ptr(const struct side_arg *arg)
+{
+	switch (side_enum_get(arg->type)) {
+	case SIDE_TYPE_GATHER_BOOL:
+		return side_ptr_get(arg->u.side_static.side_bool_gather_ptr);
+	case SIDE_TYPE_GATHER_BYTE:
+		return side_ptr_get(arg->u.side_static.side_byte_gather_ptr);
+	case SIDE_TYPE_GATHER_INTEGER:
+	case SIDE_TYPE_GATHER_POINTER:
+		return side_ptr_get(arg->u.side_static.side_integer_gather_ptr);
+	case SIDE_TYPE_GATHER_FLOAT:
+		return side_ptr_get(arg->u.side_static.side_float_gather_ptr);
+	case SIDE_TYPE_GATHER_STRUCT:
+		return side_ptr_get(arg->u.side_static.side_struct_gather_ptr);
+	case SIDE_TYPE_GATHER_ARRAY:
+		return side_ptr_get(arg->u.side_static.side_array_gather_ptr);
+	default:
+		return NULL;
+	}
+}
+
+static
+void gather_arg_set_ptr(struct side_arg *arg, enum side_type_label label, const void *ptr)
+{
+	memset(arg, 0, sizeof(*arg));
+	side_enum_set(arg->type, label);
+	switch (label) {
+	case SIDE_TYPE_GATHER_BOOL:
+		side_ptr_set(arg->u.side_static.side_bool_gather_ptr, ptr);
+		break;
+	case SIDE_TYPE_GATHER_BYTE:
+		side_ptr_set(arg->u.side_static.side_byte_gather_ptr, ptr);
+		break;
+	case SIDE_TYPE_GATHER_INTEGER:
+	case SIDE_TYPE_GATHER_POINTER:
+		side_ptr_set(arg->u.side_static.side_integer_gather_ptr, ptr);
+		break;
+	case SIDE_TYPE_GATHER_FLOAT:
+		side_ptr_set(arg->u.side_static.side_float_gather_ptr, ptr);
+		break;
+	case SIDE_TYPE_GATHER_STRUCT:
+		side_ptr_set(arg->u.side_static.side_struct_gather_ptr, ptr);
+		break;
+	case SIDE_TYPE_GATHER_ARRAY:
+		side_ptr_set(arg->u.side_static.side_array_gather_ptr, ptr);
+		break;
+	default:
+		abort();
+	}
+}
+
+struct side_gather_capture_plan *side_gather_capture_plan_create(const struct side_event_description *desc)
+{
+	struct side_gather_capture_plan *plan;
+	uint32_t i, nr_fields;
+	uint64_t size = 0;
+
+	if (desc->flags & SIDE_EVENT_FLAG_VARIADIC)
+		return NULL;
+	nr_fields = side_array_length(&desc->fields);
+	plan = (struct side_gather_capture_plan *) calloc(1, sizeof(struct side_gather_capture_plan) +
+			nr_fields * sizeof(struct side_gather_capture_op));
+	if (!plan)
+		return NULL;
+	plan->fields = (struct side_event_field *) calloc(nr_fields ? nr_fields : 1, sizeof(struct side_event_field));
+	plan->enum_elem_types = (struct side_type *) calloc(nr_fields ? nr_fields : 1, sizeof(struct side_type));
+	if (!plan->fields || !plan->enum_elem_types)
+		goto error;
+	memcpy(&plan->desc, desc, sizeof(struct side_event_description));
+	side_ptr_set(plan->desc.fields.elements, plan->fields);
+	plan->nr_ops = nr_fields;
+	for (i = 0; i < nr_fields; i++) {
+		const struct side_event_field *field = side_array_at(&desc->fields, i);
+		struct side_event_field *rebased_field = &plan->fields[i];
+		struct side_gather_capture_op *op = &plan->ops[i];
+		enum side_type_label label = side_enum_get(field->side_type.type);
+		uint64_t lo, hi, stride;
+
+		memcpy(rebased_field, field, sizeof(struct side_event_field));
+		if (capture_arg_type(label)) {
+			op->type = SIDE_GATHER_CAPTURE_OP_ARG;
+			op->len = capture_arg_value_size(&field->side_type, &op->label);
+			if (op->len > sizeof(union side_arg_static))
+				goto error;
+		} else if (gather_type_extent(&field->side_type, &lo, &hi, &stride)) {
+			struct side_type *rebased_type = &rebased_field->side_type;
+
+			if (label == SIDE_TYPE_GATHER_ENUM) {
+				/* The offset is held by the integer element type. */
+				memcpy(&plan->enum_elem_types[i],
+					side_ptr_get(field->side_type.u.side_gather.u.side_enum.elem_type),
+					sizeof(struct side_type));
+				side_ptr_set(rebased_type->u.side_gather.u.side_enum.elem_type,
+					&plan->enum_elem_types[i]);
+				rebased_type = &plan->enum_elem_types[i];
+			}
+			/*
+			 * Capture from the field offset, so the captured copy
+			 * starts at the rebased base pointer.
+			 */
+			op->src_offset = gather_type_offset(rebased_type);
+			if (hi < op->src_offset || hi - op->src_offset > UINT32_MAX)
+				goto error;
+			gather_type_clear_offset(rebased_type);
+			op->type = SIDE_GATHER_CAPTURE_OP_GATHER;
+			op->len = hi - op->src_offset;
+			/* Gather enumeration arguments are gather integers. */
+			op->label = label == SIDE_TYPE_GATHER_ENUM ? SIDE_TYPE_GATHER_INTEGER : label;
+		} else {
+			goto error;
+		}
+		op->buf_offset = size;
+		size += op->len;
+	}
+	plan->size = size;
+	return plan;
+
+error:
+	side_gather_capture_plan_destroy(plan);
+	return NULL;
+}
+
+void side_gather_capture_plan_destroy(struct side_gather_capture_plan *plan)
+{
+	if (!plan)
+		return;
+	free(plan->enum_elem_types);
+	free(plan->fields);
+	free(plan);
+}
+
+const struct side_event_description *side_gather_capture_plan_description(const struct side_gather_capture_plan *plan)
+{
+	return &plan->desc;
+}
+
+size_t side_gather_capture_plan_size(const struct side_gather_capture_plan *plan)
+{
+	return plan->size;
+}
+
+int side_gather_capture(const struct side_gather_capture_plan *plan,
+		const struct side_arg_vec *side_arg_vec,
+		void *buf, size_t len)
+{
+	const struct side_arg *sav = side_ptr_get(side_arg_vec->sav);
+	char *p = (char *) buf;
+	uint32_t i;
+
+	if (side_arg_vec->len != plan->nr_ops || len < plan->size)
+		return SIDE_ERROR_INVAL;
+	for (i = 0; i < plan->nr_ops; i++) {
+		if (side_enum_get(sav[i].type) != plan->ops[i].label)
+			return SIDE_ERROR_INVAL;
+	}
+	for (i = 0; i < plan->nr_ops; i++) {
+		const struct side_gather_capture_op *op = &plan->ops[i];
+
+		switch (op->type) {
+		case SIDE_GATHER_CAPTURE_OP_ARG:
+			memcpy(p + op->buf_offset, &sav[i].u.side_static, op->len);
+			break;
+		case SIDE_GATHER_CAPTURE_OP_GATHER:
+			memcpy(p + op->buf_offset, (const char *) gather_arg_ptr(&sav[i]) + op->src_offset, op->len);
+			break;
+		}
+	}
+	return SIDE_ERROR_OK;
+}
+
+int side_gather_capture_decode(const struct side_gather_capture_plan *plan,
+		const void *buf, size_t len,
+		struct side_arg *sav, uint32_t nr_sav)
+{
+	const char *p = (const char *) buf;
+	uint32_t i;
+
+	if (nr_sav < plan->nr_ops || len < plan->size)
+		return SIDE_ERROR_INVAL;
+	for (i = 0; i < plan->nr_ops; i++) {
+		const struct side_gather_capture_op *op = &plan->ops[i];
+
+		switch (op->type) {
+		case SIDE_GATHER_CAPTURE_OP_ARG:
+			memset(&sav[i], 0, sizeof(sav[i]));
+			side_enum_set(sav[i].type, op->label);
+			memcpy(&sav[i].u.side_static, p + op->buf_offset, op->len);
+			break;
+		case SIDE_GATHER_CAPTURE_OP_GATHER:
+			gather_arg_set_ptr(&sav[i], op->label, p + op->buf_offset);
+			break;
+		}
+	}
+	return SIDE_ERROR_OK;
+}
@@ -23,10 +23,13 @@
  * available, use them to replace barriers and atomics on the fast-path.
  */
 unsigned int side_rcu_rseq_membarrier_available;
+uint64_t side_rcu_nr_membarrier;
+uint64_t side_rcu_memory_usage;
 
 static int
 membarrier(int cmd, unsigned int flags, int cpu_id)
 {
+	(void) __atomic_add_fetch(&side_rcu_nr_membarrier, 1, __ATOMIC_RELAXED);
 	return syscall(__NR_membarrier, cmd, flags, cpu_id);
 }
 
@@ -213,6 +216,7 @@ void side_rcu_wait_grace_period(struct side_rcu_gp_state *gp_state)
 {
 	bool active_readers[2] = { true, true };
 
+	(void) __atomic_add_fetch(&gp_state->nr_grace_periods, 1, __ATOMIC_RELAXED);
 	/*
 	 * This memory barrier (D) pairs with memory barriers (A) and
 	 * (B) on the read-side.
@@ -295,11 +299,17 @@ void side_rcu_gp_init(struct side_rcu_gp_state *rcu_gp)
 		calloc(rcu_gp->nr_cpus, sizeof(struct side_rcu_cpu_gp_state));
 	if (!rcu_gp->percpu_state)
 		abort();
+	(void) __atomic_add_fetch(&side_rcu_memory_usage,
+		rcu_gp->nr_cpus * sizeof(struct side_rcu_cpu_gp_state), __ATOMIC_RELAXED);
 	if (!membarrier(MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0, 0))
 		has_membarrier = true;
 	if (rseq_available(RSEQ_AVAILABLE_QUERY_LIBC))
 		has_rseq = true;
-	if (has_membarrier && has_rseq)
+	/*
+	 * Setting SIDE_RCU_FALLBACK in the environment forces the use of
+	 * barriers and atomics, e.g. to compare both read-side paths.
+	 */
+	if (has_membarrier && has_rseq && !getenv("SIDE_RCU_FALLBACK"))
 		side_rcu_rseq_membarrier_available = 1;
 }
 
@@ -308,4 +318,6 @@ void side_rcu_gp_exit(struct side_rcu_gp_state *rcu_gp)
 	rseq_prepare_unload();
 	pthread_mutex_destroy(&rcu_gp->gp_lock);
 	free(rcu_gp->percpu_state);
+	(void) __atomic_sub_fetch(&side_rcu_memory_usage,
+		rcu_gp->nr_cpus * sizeof(struct side_rcu_cpu_gp_state), __ATOMIC_RELAXED);
 }
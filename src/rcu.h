@@ -37,6 +37,7 @@ struct side_rcu_gp_state {
 	int32_t futex;
 	unsigned int period;
 	pthread_mutex_t gp_lock;
+	uint64_t nr_grace_periods;	/* Statistics. */
 };
 
 struct side_rcu_read_state {
@@ -45,6 +46,10 @@ struct side_rcu_read_state {
 };
 
 extern unsigned int side_rcu_rseq_membarrier_available __attribute__((visibility("hidden")));
+/* Number of membarrier system calls issued, for statistics. */
+extern uint64_t side_rcu_nr_membarrier __attribute__((visibility("hidden")));
+/* Bytes allocated for per-CPU grace period state. */
+extern uint64_t side_rcu_memory_usage __attribute__((visibility("hidden")));
 
 static inline
 int futex(int32_t *uaddr, int op, int32_t val,
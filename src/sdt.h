@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#ifndef _SIDE_SDT_H
+#define _SIDE_SDT_H
+
+#include <side/macros.h>
+
+/*
+ * SystemTap-compatible statically defined tracing (SDT) probes, without
+ * dependency on <sys/sdt.h>. Each probe site is a nop instruction
+ * described by a .note.stapsdt ELF note (probe address, provider and
+ * probe names, semaphore address, and argument locations), which
+ * uprobe-based tools (SystemTap, bpftrace, perf, ...) use to attach to
+ * the probe and fetch its arguments.
+ *
+ * Arguments must be pointer-sized integers or pointers.
+ */
+
+#if defined(__ELF__) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+
+#define SIDE_SDT_ARG(n)	SIDE_STR(__SIZEOF_POINTER__) "@%" SIDE_STR(n)
+
+#define _SIDE_SDT_PROBE(_provider, _name, _semaphore, _args_fmt, ...)	\
+	__asm__ __volatile__ (						\
+		"990:	nop\n\t"					\
+		".pushsection .note.stapsdt, \"\", \"note\"\n\t"	\
+		".balign 4\n\t"						\
+		".4byte 992f-991f, 994f-993f, 3\n\t"			\
+		"991:	.asciz \"stapsdt\"\n\t"				\
+		"992:	.balign 4\n\t"					\
+		"993:	.dc.a 990b\n\t"					\
+		".dc.a _.stapsdt.base\n\t"				\
+		".dc.a " SIDE_STR(_semaphore) "\n\t"			\
+		".asciz \"" _provider "\"\n\t"				\
+		".asciz \"" _name "\"\n\t"				\
+		".asciz \"" _args_fmt "\"\n\t"				\
+		"994:	.balign 4\n\t"					\
+		".popsection\n\t"					\
+		".ifndef _.stapsdt.base\n\t"				\
+		".pushsection .stapsdt.base, \"aG\", \"progbits\", .stapsdt.base, comdat\n\t" \
+		".weak _.stapsdt.base\n\t"				\
+		".hidden _.stapsdt.base\n\t"				\
+		"_.stapsdt.base: .space 1\n\t"				\
+		".size _.stapsdt.base, 1\n\t"				\
+		".popsection\n\t"					\
+		".endif\n\t"						\
+		: : __VA_ARGS__)
+
+#define SIDE_SDT_PROBE3(_provider, _name, _semaphore, _a0, _a1, _a2)	\
+	_SIDE_SDT_PROBE(_provider, _name, _semaphore,			\
+		SIDE_SDT_ARG(0) " " SIDE_SDT_ARG(1) " " SIDE_SDT_ARG(2), \
+		"nor" ((uintptr_t) (_a0)), "nor" ((uintptr_t) (_a1)),	\
+		"nor" ((uintptr_t) (_a2)))
+
+#define SIDE_SDT_PROBE4(_provider, _name, _semaphore, _a0, _a1, _a2, _a3) \
+	_SIDE_SDT_PROBE(_provider, _name, _semaphore,			\
+		SIDE_SDT_ARG(0) " " SIDE_SDT_ARG(1) " " SIDE_SDT_ARG(2) " " SIDE_SDT_ARG(3), \
+		"nor" ((uintptr_t) (_a0)), "nor" ((uintptr_t) (_a1)),	\
+		"nor" ((uintptr_t) (_a2)), "nor" ((uintptr_t) (_a3)))
+
+#define SIDE_SDT_SEMAPHORE(_semaphore)					\
+	unsigned short _semaphore __attribute__((section(".probes"), used, visibility("hidden")))
+
+#else
+
+#define SIDE_SDT_PROBE3(_provider, _name, _semaphore, _a0, _a1, _a2)
+#define SIDE_SDT_PROBE4(_provider, _name, _semaphore, _a0, _a1, _a2, _a3)
+#define SIDE_SDT_SEMAPHORE(_semaphore)	unsigned short _semaphore
+
+#endif
+
+#endif /* _SIDE_SDT_H */
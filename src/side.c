@@ -10,10 +10,14 @@
 #include <unistd.h>
 #include <poll.h>
 
+#include "arena.h"
+#include "callback-stats.h"
 #include "compiler.h"
+#include "sdt.h"
 #include "rcu.h"
 #include "list.h"
 #include "rculist.h"
+#include "fingerprint.h"
 
 /* Top 8 bits reserved for shared tracer use. */
 #if SIDE_BITS_PER_LONG == 64
@@ -41,12 +45,27 @@
 /* Key 0x2 is reserved for ptrace. */
 #define SIDE_KEY_PTRACE					0x2
 
+/* 16 kB of arguments on the stack. */
+#define SIDE_CALL_LAZY_MAX_FIELDS			256
+
 #define SIDE_RETRY_BUSY_LOOP_ATTEMPTS			100
 #define SIDE_RETRY_DELAY_MS				1
 
+/*
+ * Registered event, chained in the hash table of registered events.
+ * Its fingerprint is computed on first query.
+ */
+struct side_registered_event {
+	struct side_registered_event *next;	/* Hash chain. */
+	const struct side_event_description *desc;
+	uint64_t fingerprint;
+	bool fingerprint_valid;
+};
+
 struct side_events_register_handle {
 	struct side_list_node node;
 	struct side_event_description **events;
+	struct side_registered_event *registered;	/* Indexed like events. */
 	uint32_t nr_events;
 };
 
@@ -55,6 +74,7 @@ struct side_tracer_handle {
 	void (*cb)(enum side_tracer_notification notif,
 		struct side_event_description **events, uint32_t nr_events, void *priv);
 	void *priv;
+	uint32_t flags;		/* enum side_tracer_notification_flag */
 };
 
 struct side_statedump_notification {
@@ -70,6 +90,13 @@ struct side_statedump_request_handle {
 	enum side_statedump_mode mode;
 };
 
+struct side_dynamic_struct_schema_handle {
+	struct side_dynamic_struct_schema schema;	/* Required first field. */
+	struct side_arg_dynamic_struct shape;
+	uint64_t size;			/* Allocated bytes, for memory accounting. */
+	struct side_arg_dynamic_field fields[];
+};
+
 struct side_callback {
 	union {
 		void (*call)(const struct side_event_description *desc,
@@ -80,6 +107,8 @@ struct side_callback {
 			const struct side_arg_dynamic_struct *var_struct,
 			void *priv, void *caller_addr);
 	} u;
+	/* Optional, NULL for callbacks without batch support. */
+	side_tracer_callback_batch_func call_batch;
 	void *priv;
 	uint64_t key;
 };
@@ -106,10 +135,59 @@ static struct side_rcu_gp_state event_rcu_gp, statedump_rcu_gp;
  * Lazy initialization for early use within library constructors.
  */
 static bool initialized;
+/*
+ * Dispatch state, loaded once by each dispatch before invoking tracer
+ * callbacks.
+ *
+ * The RCU domains are initialized on first callback or statedump
+ * registration, so processes which are never traced neither allocate
+ * their per-CPU state nor register for membarrier. Until then, no
+ * callback can be registered and the dispatch paths skip them.
+ *
+ * Callback statistics are sampled only while enabled, without a
+ * separate load of their sampling period.
+ */
+#define SIDE_DISPATCH_RCU_INITIALIZED		(1U << 0)
+#define SIDE_DISPATCH_CALLBACK_STATS		(1U << 1)
+
+static uint32_t side_dispatch_state;
+static pthread_once_t rcu_init_once = PTHREAD_ONCE_INIT;
 /*
  * Do not register/unregister any more events after destructor.
  */
 static bool finalized;
+/*
+ * Skip teardown at exit, see side_fast_exit_enable().
+ */
+static bool fast_exit;
+static bool exit_notified;
+/*
+ * Fast exit handler registered by side_events_register() and by
+ * side_fast_exit_enable() respectively, see side_atexit().
+ */
+static bool register_exit_handler_done, enable_exit_handler_done;
+
+static void side_atexit(void);
+static void side_exit_handler_register(bool *done);
+
+/*
+ * Memory allocated by libside, see side_tracer_memory_usage(). RCU,
+ * callback statistics and arena memory is accounted by their own
+ * modules.
+ */
+static struct side_memory_usage side_memory_usage;
+
+static inline
+void side_memory_usage_add(uint64_t *counter, uint64_t bytes)
+{
+	(void) __atomic_add_fetch(counter, bytes, __ATOMIC_RELAXED);
+}
+
+static inline
+void side_memory_usage_sub(uint64_t *counter, uint64_t bytes)
+{
+	(void) __atomic_sub_fetch(counter, bytes, __ATOMIC_RELAXED);
+}
 
 /*
  * Recursive mutex to allow tracer callbacks to use the side API.
@@ -128,12 +206,22 @@ static pthread_mutex_t side_agent_thread_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /* Dynamic tracer key allocation. */
 static uint64_t side_key_next = SIDE_KEY_RESERVED_RANGE_END;
+static uint64_t side_dynamic_struct_schema_next_id = 1;
 
 static struct statedump_agent_thread statedump_agent_thread;
 
 static DEFINE_SIDE_LIST_HEAD(side_events_list);
 static DEFINE_SIDE_LIST_HEAD(side_tracer_list);
 
+/*
+ * Registered events hashed by description address. Protected by
+ * side_event_lock.
+ */
+#define SIDE_REGISTERED_EVENT_HT_BITS	10
+#define SIDE_REGISTERED_EVENT_HT_SIZE	(1U << SIDE_REGISTERED_EVENT_HT_BITS)
+
+static struct side_registered_event *side_registered_event_ht[SIDE_REGISTERED_EVENT_HT_SIZE];
+
 /*
  * The statedump request list is a RCU list to allow the agent thread to
  * iterate over this list with a RCU read-side lock.
@@ -146,10 +234,33 @@ static DEFINE_SIDE_LIST_HEAD(side_statedump_list);
  */
 const char side_empty_callback[sizeof(struct side_callback)];
 
-side_static_event(side_statedump_begin, "side", "statedump_begin",
-	SIDE_LOGLEVEL_INFO, side_field_list(side_field_string("name")));
-side_static_event(side_statedump_end, "side", "statedump_end",
-	SIDE_LOGLEVEL_INFO, side_field_list(side_field_string("name")));
+/*
+ * This library's own events are kept out of the event description
+ * section, which holds the events of the main program when libside is
+ * linked statically, and are registered by side_init() instead.
+ */
+_side_define_event_description(static, static, side_statedump_begin, "side", "statedump_begin",
+	SIDE_LOGLEVEL_INFO, _side_field_list(_side_field_string("name")), 0, side_attr_list());
+_side_define_event_description(static, static, side_statedump_end, "side", "statedump_end",
+	SIDE_LOGLEVEL_INFO, _side_field_list(_side_field_string("name")), 0, side_attr_list());
+
+static struct side_event_description *side_events[] = {
+	&side_statedump_begin,
+	&side_statedump_end,
+};
+
+/*
+ * SDT probes at the dispatch sites. The semaphore is incremented by
+ * tools attached to the probes, and checked on each dispatch
+ * independently of the shared enabled bits, so attached tools observe
+ * every event dispatched to tracers. Events without any tracer callback
+ * are not dispatched: setting their ptrace shared enabled bit makes
+ * them reach the probes.
+ *
+ *   side:call(desc, side_arg_vec, caller_addr)
+ *   side:call_variadic(desc, side_arg_vec, var_struct, caller_addr)
+ */
+SIDE_SDT_SEMAPHORE(side_sdt_semaphore);
 
 /*
  * side_ptrace_hook is a place holder for a debugger breakpoint.
@@ -167,38 +278,118 @@ void side_ptrace_hook(const struct side_event_state *event_state __attribute__((
 {
 }
 
+side_static_assert(offsetof(struct side_event_state_0, nr_callbacks) == offsetof(struct side_event_state_1, nr_callbacks) &&
+		offsetof(struct side_event_state_0, callbacks) == offsetof(struct side_event_state_1, callbacks) &&
+		offsetof(struct side_event_state_0, desc) == offsetof(struct side_event_state_1, desc),
+	"Event state versions 0 and 1 layout mismatch", event_state_versions_0_and_1_layout_mismatch);
+
+/*
+ * Event state ABI versions 0 and 1 only differ by their enabled word,
+ * which version 0 keeps inline. Returns the event state with the
+ * version 1 layout of the other fields, and its enabled word in
+ * "enabled_ptr".
+ */
 static inline __attribute__((always_inline))
-void _side_call(const struct side_event_state *event_state, const struct side_arg_vec *side_arg_vec, uint64_t key)
+struct side_event_state_1 *side_event_state_get(const struct side_event_state *event_state,
+		uintptr_t **enabled_ptr)
 {
-	void *caller_addr = __builtin_return_address(0);
-	struct side_rcu_read_state rcu_read_state;
-	const struct side_event_state_0 *es0;
-	const struct side_callback *side_cb;
+	struct side_event_state *state = (struct side_event_state *) event_state;
+
+	switch (state->version) {
+	case 0:
+	{
+		struct side_event_state_0 *es0 = side_container_of(state, struct side_event_state_0, parent);
+
+		*enabled_ptr = &es0->enabled;
+		return (struct side_event_state_1 *) es0;
+	}
+	case 1:
+	{
+		struct side_event_state_1 *es1 = side_container_of(state, struct side_event_state_1, parent);
+
+		*enabled_ptr = es1->enabled;
+		return es1;
+	}
+	default:
+		abort();
+	}
+}
+
+/*
+ * Dispatch prologue of non-variadic events: library state checks, and
+ * shared consumers (user events, ptrace, SDT), invoked for each of the
+ * "nr_vecs" events. Returns the event state and the dispatch state, or
+ * NULL if tracer callbacks must not be invoked.
+ */
+static inline __attribute__((always_inline))
+const struct side_event_state_1 *side_call_prologue(const struct side_event_state *event_state,
+		const struct side_arg_vec *side_arg_vecs, uint32_t nr_vecs,
+		uint64_t key, void *caller_addr, uint32_t *dispatch_state)
+{
+	const struct side_event_state_1 *es1;
+	uintptr_t *enabled_ptr;
 	uintptr_t enabled;
+	uint32_t i;
 
 	if (side_unlikely(finalized))
-		return;
+		return NULL;
 	if (side_unlikely(!initialized))
 		side_init();
-	if (side_unlikely(event_state->version != 0))
-		abort();
-	es0 = side_container_of(event_state, const struct side_event_state_0, parent);
-	assert(!(es0->desc->flags & SIDE_EVENT_FLAG_VARIADIC));
-	enabled = __atomic_load_n(&es0->enabled, __ATOMIC_RELAXED);
+	es1 = side_event_state_get(event_state, &enabled_ptr);
+	assert(!(es1->desc->flags & SIDE_EVENT_FLAG_VARIADIC));
+	enabled = __atomic_load_n(enabled_ptr, __ATOMIC_RELAXED);
 	if (side_unlikely(enabled & SIDE_EVENT_ENABLED_SHARED_MASK)) {
 		if ((enabled & SIDE_EVENT_ENABLED_SHARED_USER_EVENT_MASK) &&
 		    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_USER_EVENT)) {
 			// TODO: User event integration: call kernel write.
 		}
 		if ((enabled & SIDE_EVENT_ENABLED_SHARED_PTRACE_MASK) &&
-		    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_PTRACE))
-			side_ptrace_hook(event_state, side_arg_vec, NULL, caller_addr);
+		    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_PTRACE)) {
+			for (i = 0; i < nr_vecs; i++)
+				side_ptrace_hook(event_state, &side_arg_vecs[i], NULL, caller_addr);
+		}
+	}
+	if (side_unlikely(__atomic_load_n(&side_sdt_semaphore, __ATOMIC_RELAXED)) &&
+	    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_PTRACE)) {
+		for (i = 0; i < nr_vecs; i++)
+			SIDE_SDT_PROBE3("side", "call", side_sdt_semaphore,
+				es1->desc, &side_arg_vecs[i], caller_addr);
 	}
+	*dispatch_state = __atomic_load_n(&side_dispatch_state, __ATOMIC_ACQUIRE);
+	if (side_unlikely(!(*dispatch_state & SIDE_DISPATCH_RCU_INITIALIZED)))
+		return NULL;
+	return es1;
+}
+
+static inline __attribute__((always_inline))
+void _side_call(const struct side_event_state *event_state, const struct side_arg_vec *side_arg_vec, uint64_t key)
+{
+	void *caller_addr = __builtin_return_address(0);
+	struct side_rcu_read_state rcu_read_state;
+	const struct side_event_state_1 *es1;
+	const struct side_callback *side_cb;
+	uint32_t dispatch_state;
+	bool sample;
+
+	es1 = side_call_prologue(event_state, side_arg_vec, 1, key, caller_addr, &dispatch_state);
+	if (!es1)
+		return;
+	sample = side_unlikely(dispatch_state & SIDE_DISPATCH_CALLBACK_STATS) &&
+		side_callback_stats_sample();
 	side_rcu_read_begin(&event_rcu_gp, &rcu_read_state);
-	for (side_cb = side_rcu_dereference(es0->callbacks); side_cb->u.call != NULL; side_cb++) {
+	for (side_cb = side_rcu_dereference(es1->callbacks); side_cb->u.call != NULL; side_cb++) {
+		uint64_t t0;
+
 		if (key != SIDE_KEY_MATCH_ALL && side_cb->key != SIDE_KEY_MATCH_ALL && side_cb->key != key)
 			continue;
-		side_cb->u.call(es0->desc, side_arg_vec, side_cb->priv, caller_addr);
+		if (side_likely(!sample)) {
+			side_cb->u.call(es1->desc, side_arg_vec, side_cb->priv, caller_addr);
+			continue;
+		}
+		t0 = side_callback_stats_clock();
+		side_cb->u.call(es1->desc, side_arg_vec, side_cb->priv, caller_addr);
+		side_callback_stats_record(es1->desc, side_cb->u.call, side_cb->priv, side_cb->key,
+			side_callback_stats_clock() - t0);
 	}
 	side_rcu_read_end(&event_rcu_gp, &rcu_read_state);
 }
@@ -208,6 +399,43 @@ void side_call(const struct side_event_state *event_state, const struct side_arg
 	_side_call(event_state, side_arg_vec, SIDE_KEY_MATCH_ALL);
 }
 
+void side_call_lazy(const struct side_event_state *event_state,
+		side_arg_vec_fill_func fill, void *priv)
+{
+	const struct side_event_state_1 *es1;
+	uintptr_t *enabled_ptr;
+	uint32_t len;
+
+	if (side_unlikely(finalized))
+		return;
+	if (side_unlikely(!initialized))
+		side_init();
+	es1 = side_event_state_get(event_state, &enabled_ptr);
+	/*
+	 * The enabled state is set only while at least one tracer
+	 * callback or shared consumer (ptrace, user events) is
+	 * registered for the event. SDT probes are attached
+	 * independently.
+	 */
+	if (!__atomic_load_n(enabled_ptr, __ATOMIC_RELAXED) &&
+	    side_likely(!__atomic_load_n(&side_sdt_semaphore, __ATOMIC_RELAXED)))
+		return;
+	len = side_array_length(&es1->desc->fields);
+	/* The arguments are on the stack: bound their size. */
+	if (side_unlikely(len > SIDE_CALL_LAZY_MAX_FIELDS))
+		return;
+	{
+		struct side_arg sav[len ? len : 1];
+		const struct side_arg_vec side_arg_vec = {
+			.sav = SIDE_PTR_INIT(sav),
+			.len = len,
+		};
+
+		fill(sav, len, priv);
+		_side_call(event_state, &side_arg_vec, SIDE_KEY_MATCH_ALL);
+	}
+}
+
 void side_statedump_call(const struct side_event_state *event_state,
 		const struct side_arg_vec *side_arg_vec,
 		void *statedump_request_key)
@@ -223,33 +451,53 @@ void _side_call_variadic(const struct side_event_state *event_state,
 {
 	void *caller_addr = __builtin_return_address(0);
 	struct side_rcu_read_state rcu_read_state;
-	const struct side_event_state_0 *es0;
+	const struct side_event_state_1 *es1;
+	uintptr_t *enabled_ptr;
 	const struct side_callback *side_cb;
+	uint32_t dispatch_state;
 	uintptr_t enabled;
+	bool sample;
 
 	if (side_unlikely(finalized))
 		return;
 	if (side_unlikely(!initialized))
 		side_init();
-	if (side_unlikely(event_state->version != 0))
-		abort();
-	es0 = side_container_of(event_state, const struct side_event_state_0, parent);
-	assert(es0->desc->flags & SIDE_EVENT_FLAG_VARIADIC);
-	enabled = __atomic_load_n(&es0->enabled, __ATOMIC_RELAXED);
+	es1 = side_event_state_get(event_state, &enabled_ptr);
+	assert(es1->desc->flags & SIDE_EVENT_FLAG_VARIADIC);
+	enabled = __atomic_load_n(enabled_ptr, __ATOMIC_RELAXED);
 	if (side_unlikely(enabled & SIDE_EVENT_ENABLED_SHARED_MASK)) {
 		if ((enabled & SIDE_EVENT_ENABLED_SHARED_USER_EVENT_MASK) &&
 		    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_USER_EVENT)) {
 			// TODO: User event integration: call kernel write.
 		}
 		if ((enabled & SIDE_EVENT_ENABLED_SHARED_PTRACE_MASK) &&
-		    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_PTRACE))
+		    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_PTRACE)) {
 			side_ptrace_hook(event_state, side_arg_vec, var_struct, caller_addr);
+		}
 	}
+	if (side_unlikely(__atomic_load_n(&side_sdt_semaphore, __ATOMIC_RELAXED)) &&
+	    (key == SIDE_KEY_MATCH_ALL || key == SIDE_KEY_PTRACE))
+		SIDE_SDT_PROBE4("side", "call_variadic", side_sdt_semaphore,
+			es1->desc, side_arg_vec, var_struct, caller_addr);
+	dispatch_state = __atomic_load_n(&side_dispatch_state, __ATOMIC_ACQUIRE);
+	if (side_unlikely(!(dispatch_state & SIDE_DISPATCH_RCU_INITIALIZED)))
+		return;
+	sample = side_unlikely(dispatch_state & SIDE_DISPATCH_CALLBACK_STATS) &&
+		side_callback_stats_sample();
 	side_rcu_read_begin(&event_rcu_gp, &rcu_read_state);
-	for (side_cb = side_rcu_dereference(es0->callbacks); side_cb->u.call_variadic != NULL; side_cb++) {
+	for (side_cb = side_rcu_dereference(es1->callbacks); side_cb->u.call_variadic != NULL; side_cb++) {
+		uint64_t t0;
+
 		if (key != SIDE_KEY_MATCH_ALL && side_cb->key != SIDE_KEY_MATCH_ALL && side_cb->key != key)
 			continue;
-		side_cb->u.call_variadic(es0->desc, side_arg_vec, var_struct, side_cb->priv, caller_addr);
+		if (side_likely(!sample)) {
+			side_cb->u.call_variadic(es1->desc, side_arg_vec, var_struct, side_cb->priv, caller_addr);
+			continue;
+		}
+		t0 = side_callback_stats_clock();
+		side_cb->u.call_variadic(es1->desc, side_arg_vec, var_struct, side_cb->priv, caller_addr);
+		side_callback_stats_record(es1->desc, side_cb->u.call, side_cb->priv, side_cb->key,
+			side_callback_stats_clock() - t0);
 	}
 	side_rcu_read_end(&event_rcu_gp, &rcu_read_state);
 }
@@ -269,19 +517,88 @@ void side_statedump_call_variadic(const struct side_event_state *event_state,
 	_side_call_variadic(event_state, side_arg_vec, var_struct, *(const uint64_t *) statedump_request_key);
 }
 
+void side_call_batch(const struct side_event_state *event_state,
+		const struct side_arg_vec *side_arg_vecs, uint32_t nr_vecs)
+{
+	void *caller_addr = __builtin_return_address(0);
+	struct side_rcu_read_state rcu_read_state;
+	const struct side_event_state_1 *es1;
+	const struct side_callback *side_cb;
+	uint32_t dispatch_state, i;
+	bool sample;
+
+	es1 = side_call_prologue(event_state, side_arg_vecs, nr_vecs, SIDE_KEY_MATCH_ALL, caller_addr,
+			&dispatch_state);
+	if (!es1)
+		return;
+	sample = side_unlikely(dispatch_state & SIDE_DISPATCH_CALLBACK_STATS) &&
+		side_callback_stats_sample();
+	side_rcu_read_begin(&event_rcu_gp, &rcu_read_state);
+	for (side_cb = side_rcu_dereference(es1->callbacks); side_cb->u.call != NULL; side_cb++) {
+		uint64_t t0;
+
+		if (side_cb->call_batch) {
+			if (side_likely(!sample)) {
+				side_cb->call_batch(es1->desc, side_arg_vecs, nr_vecs, side_cb->priv, caller_addr);
+				continue;
+			}
+			/* One sample for the whole batch. */
+			t0 = side_callback_stats_clock();
+			side_cb->call_batch(es1->desc, side_arg_vecs, nr_vecs, side_cb->priv, caller_addr);
+			side_callback_stats_record(es1->desc, side_cb->u.call, side_cb->priv, side_cb->key,
+				side_callback_stats_clock() - t0);
+			continue;
+		}
+		/* Fall back on per-event calls. */
+		for (i = 0; i < nr_vecs; i++) {
+			if (side_likely(!sample)) {
+				side_cb->u.call(es1->desc, &side_arg_vecs[i], side_cb->priv, caller_addr);
+				continue;
+			}
+			t0 = side_callback_stats_clock();
+			side_cb->u.call(es1->desc, &side_arg_vecs[i], side_cb->priv, caller_addr);
+			side_callback_stats_record(es1->desc, side_cb->u.call, side_cb->priv, side_cb->key,
+				side_callback_stats_clock() - t0);
+		}
+	}
+	side_rcu_read_end(&event_rcu_gp, &rcu_read_state);
+}
+
+static
+void side_rcu_init(void)
+{
+	side_rcu_gp_init(&event_rcu_gp);
+	side_rcu_gp_init(&statedump_rcu_gp);
+	(void) __atomic_or_fetch(&side_dispatch_state, SIDE_DISPATCH_RCU_INITIALIZED, __ATOMIC_RELEASE);
+}
+
+void side_dispatch_callback_stats_set(bool enabled)
+{
+	if (enabled)
+		(void) __atomic_or_fetch(&side_dispatch_state, SIDE_DISPATCH_CALLBACK_STATS, __ATOMIC_RELAXED);
+	else
+		(void) __atomic_and_fetch(&side_dispatch_state, ~SIDE_DISPATCH_CALLBACK_STATS, __ATOMIC_RELAXED);
+}
+
+static
+void side_rcu_lazy_init(void)
+{
+	if (pthread_once(&rcu_init_once, side_rcu_init))
+		abort();
+}
+
 static
 const struct side_callback *side_tracer_callback_lookup(
 		const struct side_event_description *desc,
 		void *call, void *priv, uint64_t key)
 {
 	struct side_event_state *event_state = side_ptr_get(desc->state);
-	const struct side_event_state_0 *es0;
+	const struct side_event_state_1 *es1;
+	uintptr_t *enabled_ptr;
 	const struct side_callback *cb;
 
-	if (side_unlikely(event_state->version != 0))
-		abort();
-	es0 = side_container_of(event_state, const struct side_event_state_0, parent);
-	for (cb = es0->callbacks; cb->u.call != NULL; cb++) {
+	es1 = side_event_state_get(event_state, &enabled_ptr);
+	for (cb = es1->callbacks; cb->u.call != NULL; cb++) {
 		if ((void *) cb->u.call == call && cb->priv == priv && cb->key == key)
 			return cb;
 	}
@@ -290,11 +607,13 @@ const struct side_callback *side_tracer_callback_lookup(
 
 static
 int _side_tracer_callback_register(struct side_event_description *desc,
-		void *call, void *priv, uint64_t key)
+		void *call, side_tracer_callback_batch_func call_batch,
+		void *priv, uint64_t key)
 {
 	struct side_event_state *event_state;
 	struct side_callback *old_cb, *new_cb;
-	struct side_event_state_0 *es0;
+	struct side_event_state_1 *es1;
+	uintptr_t *enabled_ptr;
 	int ret = SIDE_ERROR_OK;
 	uint32_t old_nr_cb;
 
@@ -304,12 +623,11 @@ int _side_tracer_callback_register(struct side_event_description *desc,
 		return SIDE_ERROR_EXITING;
 	if (!initialized)
 		side_init();
+	side_rcu_lazy_init();
 	pthread_mutex_lock(&side_event_lock);
 	event_state = side_ptr_get(desc->state);
-	if (side_unlikely(event_state->version != 0))
-		abort();
-	es0 = side_container_of(event_state, struct side_event_state_0, parent);
-	old_nr_cb = es0->nr_callbacks;
+	es1 = side_event_state_get(event_state, &enabled_ptr);
+	old_nr_cb = es1->nr_callbacks;
 	if (old_nr_cb == UINT32_MAX) {
 		ret = SIDE_ERROR_INVAL;
 		goto unlock;
@@ -319,31 +637,35 @@ int _side_tracer_callback_register(struct side_event_description *desc,
 		ret = SIDE_ERROR_EXIST;
 		goto unlock;
 	}
-	old_cb = (struct side_callback *) es0->callbacks;
+	old_cb = (struct side_callback *) es1->callbacks;
 	/* old_nr_cb + 1 (new cb) + 1 (NULL) */
 	new_cb = (struct side_callback *) calloc(old_nr_cb + 2, sizeof(struct side_callback));
 	if (!new_cb) {
 		ret = SIDE_ERROR_NOMEM;
 		goto unlock;
 	}
-	memcpy(new_cb, old_cb, old_nr_cb);
+	side_memory_usage_add(&side_memory_usage.callbacks, (old_nr_cb + 2) * sizeof(struct side_callback));
+	memcpy(new_cb, old_cb, old_nr_cb * sizeof(struct side_callback));
 	if (desc->flags & SIDE_EVENT_FLAG_VARIADIC)
 		new_cb[old_nr_cb].u.call_variadic =
 			(side_tracer_callback_variadic_func) call;
 	else
 		new_cb[old_nr_cb].u.call =
 			(side_tracer_callback_func) call;
+	new_cb[old_nr_cb].call_batch = call_batch;
 	new_cb[old_nr_cb].priv = priv;
 	new_cb[old_nr_cb].key = key;
 	/* High order bits are already zeroed. */
-	side_rcu_assign_pointer(es0->callbacks, new_cb);
+	side_rcu_assign_pointer(es1->callbacks, new_cb);
 	side_rcu_wait_grace_period(&event_rcu_gp);
-	if (old_nr_cb)
+	if (old_nr_cb) {
 		free(old_cb);
-	es0->nr_callbacks++;
+		side_memory_usage_sub(&side_memory_usage.callbacks, (old_nr_cb + 1) * sizeof(struct side_callback));
+	}
+	es1->nr_callbacks++;
 	/* Increment concurrently with kernel setting the top bits. */
 	if (!old_nr_cb)
-		(void) __atomic_add_fetch(&es0->enabled, 1, __ATOMIC_RELAXED);
+		(void) __atomic_add_fetch(enabled_ptr, 1, __ATOMIC_RELAXED);
 unlock:
 	pthread_mutex_unlock(&side_event_lock);
 	return ret;
@@ -355,7 +677,19 @@ int side_tracer_callback_register(struct side_event_description *desc,
 {
 	if (desc->flags & SIDE_EVENT_FLAG_VARIADIC)
 		return SIDE_ERROR_INVAL;
-	return _side_tracer_callback_register(desc, (void *) call, priv, key);
+	return _side_tracer_callback_register(desc, (void *) call, NULL, priv, key);
+}
+
+int side_tracer_callback_batch_register(struct side_event_description *desc,
+		side_tracer_callback_func call,
+		side_tracer_callback_batch_func call_batch,
+		void *priv, uint64_t key)
+{
+	if (desc->flags & SIDE_EVENT_FLAG_VARIADIC)
+		return SIDE_ERROR_INVAL;
+	if (!call_batch)
+		return SIDE_ERROR_INVAL;
+	return _side_tracer_callback_register(desc, (void *) call, call_batch, priv, key);
 }
 
 int side_tracer_callback_variadic_register(struct side_event_description *desc,
@@ -364,7 +698,7 @@ int side_tracer_callback_variadic_register(struct side_event_description *desc,
 {
 	if (!(desc->flags & SIDE_EVENT_FLAG_VARIADIC))
 		return SIDE_ERROR_INVAL;
-	return _side_tracer_callback_register(desc, (void *) call_variadic, priv, key);
+	return _side_tracer_callback_register(desc, (void *) call_variadic, NULL, priv, key);
 }
 
 static int _side_tracer_callback_unregister(struct side_event_description *desc,
@@ -373,7 +707,8 @@ static int _side_tracer_callback_unregister(struct side_event_description *desc,
 	struct side_event_state *event_state;
 	struct side_callback *old_cb, *new_cb;
 	const struct side_callback *cb_pos;
-	struct side_event_state_0 *es0;
+	struct side_event_state_1 *es1;
+	uintptr_t *enabled_ptr;
 	uint32_t pos_idx;
 	int ret = SIDE_ERROR_OK;
 	uint32_t old_nr_cb;
@@ -386,20 +721,18 @@ static int _side_tracer_callback_unregister(struct side_event_description *desc,
 		side_init();
 	pthread_mutex_lock(&side_event_lock);
 	event_state = side_ptr_get(desc->state);
-	if (side_unlikely(event_state->version != 0))
-		abort();
-	es0 = side_container_of(event_state, struct side_event_state_0, parent);
+	es1 = side_event_state_get(event_state, &enabled_ptr);
 	cb_pos = side_tracer_callback_lookup(desc, call, priv, key);
 	if (!cb_pos) {
 		ret = SIDE_ERROR_NOENT;
 		goto unlock;
 	}
-	old_nr_cb = es0->nr_callbacks;
-	old_cb = (struct side_callback *) es0->callbacks;
+	old_nr_cb = es1->nr_callbacks;
+	old_cb = (struct side_callback *) es1->callbacks;
 	if (old_nr_cb == 1) {
 		new_cb = (struct side_callback *) &side_empty_callback;
 	} else {
-		pos_idx = cb_pos - es0->callbacks;
+		pos_idx = cb_pos - es1->callbacks;
 		/* Remove entry at pos_idx. */
 		/* old_nr_cb - 1 (removed cb) + 1 (NULL) */
 		new_cb = (struct side_callback *) calloc(old_nr_cb, sizeof(struct side_callback));
@@ -407,17 +740,20 @@ static int _side_tracer_callback_unregister(struct side_event_description *desc,
 			ret = SIDE_ERROR_NOMEM;
 			goto unlock;
 		}
-		memcpy(new_cb, old_cb, pos_idx);
-		memcpy(&new_cb[pos_idx], &old_cb[pos_idx + 1], old_nr_cb - pos_idx - 1);
+		side_memory_usage_add(&side_memory_usage.callbacks, old_nr_cb * sizeof(struct side_callback));
+		memcpy(new_cb, old_cb, pos_idx * sizeof(struct side_callback));
+		memcpy(&new_cb[pos_idx], &old_cb[pos_idx + 1],
+			(old_nr_cb - pos_idx - 1) * sizeof(struct side_callback));
 	}
 	/* High order bits are already zeroed. */
-	side_rcu_assign_pointer(es0->callbacks, new_cb);
+	side_rcu_assign_pointer(es1->callbacks, new_cb);
 	side_rcu_wait_grace_period(&event_rcu_gp);
 	free(old_cb);
-	es0->nr_callbacks--;
+	side_memory_usage_sub(&side_memory_usage.callbacks, (old_nr_cb + 1) * sizeof(struct side_callback));
+	es1->nr_callbacks--;
 	/* Decrement concurrently with kernel setting the top bits. */
 	if (old_nr_cb == 1)
-		(void) __atomic_add_fetch(&es0->enabled, -1, __ATOMIC_RELAXED);
+		(void) __atomic_add_fetch(enabled_ptr, -1, __ATOMIC_RELAXED);
 unlock:
 	pthread_mutex_unlock(&side_event_lock);
 	return ret;
@@ -441,24 +777,93 @@ int side_tracer_callback_variadic_unregister(struct side_event_description *desc
 	return _side_tracer_callback_unregister(desc, (void *) call_variadic, priv, key);
 }
 
-struct side_events_register_handle *side_events_register(struct side_event_description **events, uint32_t nr_events)
+static
+struct side_registered_event **side_registered_event_bucket(const struct side_event_description *desc)
+{
+	uint64_t h = (uint64_t) (uintptr_t) desc * 0x9E3779B97F4A7C15ULL;
+
+	return &side_registered_event_ht[h >> (64 - SIDE_REGISTERED_EVENT_HT_BITS)];
+}
+
+/* Called with side_event_lock held. */
+static
+void side_registered_event_add(struct side_registered_event *registered,
+		const struct side_event_description *desc)
+{
+	struct side_registered_event **bucket = side_registered_event_bucket(desc);
+
+	registered->desc = desc;
+	registered->next = *bucket;
+	*bucket = registered;
+}
+
+/* Called with side_event_lock held. */
+static
+void side_registered_event_remove(struct side_registered_event *registered)
+{
+	struct side_registered_event **p;
+
+	for (p = side_registered_event_bucket(registered->desc); *p; p = &(*p)->next) {
+		if (*p != registered)
+			continue;
+		*p = registered->next;
+		return;
+	}
+}
+
+/* Called with side_event_lock held. */
+static
+struct side_registered_event *side_registered_event_lookup(const struct side_event_description *desc)
+{
+	struct side_registered_event *registered;
+
+	for (registered = *side_registered_event_bucket(desc); registered; registered = registered->next) {
+		if (registered->desc == desc)
+			return registered;
+	}
+	return NULL;
+}
+
+static
+struct side_events_register_handle *_side_events_register(struct side_event_description **events, uint32_t nr_events,
+		bool exit_handler)
 {
 	struct side_events_register_handle *events_handle = NULL;
 	struct side_tracer_handle *tracer_handle;
+	uint32_t i;
 
 	if (finalized)
 		return NULL;
 	if (!initialized)
 		side_init();
+	if (exit_handler && __atomic_load_n(&fast_exit, __ATOMIC_RELAXED))
+		side_exit_handler_register(&register_exit_handler_done);
 	events_handle = (struct side_events_register_handle *)
 			calloc(1, sizeof(struct side_events_register_handle));
 	if (!events_handle)
 		return NULL;
+	if (nr_events) {
+		events_handle->registered = (struct side_registered_event *)
+				calloc(nr_events, sizeof(struct side_registered_event));
+		if (!events_handle->registered) {
+			free(events_handle);
+			return NULL;
+		}
+	}
 	events_handle->events = events;
 	events_handle->nr_events = nr_events;
+	side_memory_usage_add(&side_memory_usage.registration,
+		sizeof(struct side_events_register_handle) +
+		nr_events * sizeof(struct side_registered_event));
 
 	pthread_mutex_lock(&side_event_lock);
 	side_list_insert_node_tail(&side_events_list, &events_handle->node);
+	for (i = 0; i < nr_events; i++) {
+		/* Skip NULL pointers */
+		if (!events[i])
+			continue;
+		side_registered_event_add(&events_handle->registered[i], events[i]);
+	}
 	side_list_for_each_entry(tracer_handle, &side_tracer_list, node) {
 		tracer_handle->cb(SIDE_TRACER_NOTIFICATION_INSERT_EVENTS,
 			events, nr_events, tracer_handle->priv);
@@ -468,34 +873,46 @@ struct side_events_register_handle *side_events_register(struct side_event_descr
 	return events_handle;
 }
 
+struct side_events_register_handle *side_events_register(struct side_event_description **events, uint32_t nr_events)
+{
+	return _side_events_register(events, nr_events, true);
+}
+
+/* This library's own events do not register the exit handler, see side_atexit(). */
+struct side_events_register_handle *side_events_register_internal(struct side_event_description **events,
+		uint32_t nr_events)
+{
+	return _side_events_register(events, nr_events, false);
+}
+
 static
 void side_event_remove_callbacks(struct side_event_description *desc)
 {
 	struct side_event_state *event_state = side_ptr_get(desc->state);
-	struct side_event_state_0 *es0;
+	struct side_event_state_1 *es1;
+	uintptr_t *enabled_ptr;
 	struct side_callback *old_cb;
 	uint32_t nr_cb;
 
-	if (side_unlikely(event_state->version != 0))
-		abort();
-	es0 = side_container_of(event_state, struct side_event_state_0, parent);
-	nr_cb = es0->nr_callbacks;
+	es1 = side_event_state_get(event_state, &enabled_ptr);
+	nr_cb = es1->nr_callbacks;
 	if (!nr_cb)
 		return;
-	old_cb = (struct side_callback *) es0->callbacks;
-	(void) __atomic_add_fetch(&es0->enabled, -1, __ATOMIC_RELAXED);
+	old_cb = (struct side_callback *) es1->callbacks;
+	(void) __atomic_add_fetch(enabled_ptr, -1, __ATOMIC_RELAXED);
 	/*
 	 * Setting the state back to 0 cb and empty callbacks out of
 	 * caution. This should not matter because instrumentation is
 	 * unreachable.
 	 */
-	es0->nr_callbacks = 0;
-	side_rcu_assign_pointer(es0->callbacks, (struct side_callback *)&side_empty_callback);
+	es1->nr_callbacks = 0;
+	side_rcu_assign_pointer(es1->callbacks, (struct side_callback *)&side_empty_callback);
 	/*
 	 * No need to wait for grace period because instrumentation is
 	 * unreachable.
 	 */
 	free(old_cb);
+	side_memory_usage_sub(&side_memory_usage.callbacks, (nr_cb + 1) * sizeof(struct side_callback));
 }
 
 /*
@@ -527,16 +944,48 @@ void side_events_unregister(struct side_events_register_handle *events_handle)
 		if (!event)
 			continue;
 		side_event_remove_callbacks(event);
+		side_registered_event_remove(&events_handle->registered[i]);
 	}
+	side_callback_stats_remove_events(events_handle->events, events_handle->nr_events);
 	pthread_mutex_unlock(&side_event_lock);
 	//TODO: User event integration: call event batch unregister ioctl
+	free(events_handle->registered);
+	side_memory_usage_sub(&side_memory_usage.registration,
+		sizeof(struct side_events_register_handle) +
+		events_handle->nr_events * sizeof(struct side_registered_event));
 	free(events_handle);
 }
 
-struct side_tracer_handle *side_tracer_event_notification_register(
+int side_event_description_fingerprint(const struct side_event_description *desc,
+		uint64_t *fingerprint)
+{
+	struct side_registered_event *registered;
+	int ret = SIDE_ERROR_NOENT;
+
+	if (!desc || !fingerprint)
+		return SIDE_ERROR_INVAL;
+	if (finalized)
+		return SIDE_ERROR_EXITING;
+	if (!initialized)
+		side_init();
+	pthread_mutex_lock(&side_event_lock);
+	registered = side_registered_event_lookup(desc);
+	if (registered) {
+		if (!registered->fingerprint_valid) {
+			registered->fingerprint = side_event_description_compute_fingerprint(desc);
+			registered->fingerprint_valid = true;
+		}
+		*fingerprint = registered->fingerprint;
+		ret = SIDE_ERROR_OK;
+	}
+	pthread_mutex_unlock(&side_event_lock);
+	return ret;
+}
+
+struct side_tracer_handle *side_tracer_event_notification_register_flags(
 		void (*cb)(enum side_tracer_notification notif,
 			struct side_event_description **events, uint32_t nr_events, void *priv),
-		void *priv)
+		void *priv, uint32_t flags)
 {
 	struct side_tracer_handle *tracer_handle;
 	struct side_events_register_handle *events_handle;
@@ -549,9 +998,11 @@ struct side_tracer_handle *side_tracer_event_notification_register(
 				calloc(1, sizeof(struct side_tracer_handle));
 	if (!tracer_handle)
 		return NULL;
+	side_memory_usage_add(&side_memory_usage.registration, sizeof(struct side_tracer_handle));
 	pthread_mutex_lock(&side_event_lock);
 	tracer_handle->cb = cb;
 	tracer_handle->priv = priv;
+	tracer_handle->flags = flags;
 	side_list_insert_node_tail(&side_tracer_list, &tracer_handle->node);
 	side_list_for_each_entry(events_handle, &side_events_list, node) {
 		cb(SIDE_TRACER_NOTIFICATION_INSERT_EVENTS,
@@ -561,6 +1012,14 @@ struct side_tracer_handle *side_tracer_event_notification_register(
 	return tracer_handle;
 }
 
+struct side_tracer_handle *side_tracer_event_notification_register(
+		void (*cb)(enum side_tracer_notification notif,
+			struct side_event_description **events, uint32_t nr_events, void *priv),
+		void *priv)
+{
+	return side_tracer_event_notification_register_flags(cb, priv, 0);
+}
+
 void side_tracer_event_notification_unregister(struct side_tracer_handle *tracer_handle)
 {
 	struct side_events_register_handle *events_handle;
@@ -578,6 +1037,7 @@ void side_tracer_event_notification_unregister(struct side_tracer_handle *tracer
 	side_list_remove_node(&tracer_handle->node);
 	pthread_mutex_unlock(&side_event_lock);
 	free(tracer_handle);
+	side_memory_usage_sub(&side_memory_usage.registration, sizeof(struct side_tracer_handle));
 }
 
 /* Called with side_statedump_lock held. */
@@ -589,6 +1049,7 @@ void queue_statedump_pending(struct side_statedump_request_handle *handle, uint6
 	notif = (struct side_statedump_notification *) calloc(1, sizeof(struct side_statedump_notification));
 	if (!notif)
 		abort();
+	side_memory_usage_add(&side_memory_usage.statedump, sizeof(struct side_statedump_notification));
 	notif->key = key;
 	side_list_insert_node_tail(&handle->notification_queue, &notif->node);
 	if (handle->mode == SIDE_STATEDUMP_MODE_AGENT_THREAD) {
@@ -607,6 +1068,7 @@ void unqueue_statedump_pending(struct side_statedump_request_handle *handle, uin
 		if (key == SIDE_KEY_MATCH_ALL || key == notif->key) {
 			side_list_remove_node(&notif->node);
 			free(notif);
+			side_memory_usage_sub(&side_memory_usage.statedump, sizeof(struct side_statedump_notification));
 		}
 	}
 }
@@ -637,8 +1099,10 @@ void _side_statedump_run_pending_requests(struct side_statedump_request_handle *
 	/* We are now sole owner of the tmp_head list. */
 	side_list_for_each_entry(notif, &tmp_head, node)
 		side_statedump_run(handle, notif);
-	side_list_for_each_entry_safe(notif, tmp, &tmp_head, node)
+	side_list_for_each_entry_safe(notif, tmp, &tmp_head, node) {
 		free(notif);
+		side_memory_usage_sub(&side_memory_usage.statedump, sizeof(struct side_statedump_notification));
+	}
 
 	if (handle->mode == SIDE_STATEDUMP_MODE_AGENT_THREAD) {
 		pthread_mutex_lock(&side_statedump_lock);
@@ -766,6 +1230,7 @@ struct side_statedump_request_handle *
 		return NULL;
 	if (!initialized)
 		side_init();
+	side_rcu_lazy_init();
 	handle = (struct side_statedump_request_handle *)
 				calloc(1, sizeof(struct side_statedump_request_handle));
 	if (!handle)
@@ -773,6 +1238,8 @@ struct side_statedump_request_handle *
 	name = strdup(state_name);
 	if (!name)
 		goto name_nomem;
+	side_memory_usage_add(&side_memory_usage.registration,
+		sizeof(struct side_statedump_request_handle) + strlen(name) + 1);
 	handle->cb = statedump_cb;
 	handle->name = name;
 	handle->mode = mode;
@@ -827,6 +1294,8 @@ void side_statedump_request_notification_unregister(struct side_statedump_reques
 		pthread_mutex_unlock(&side_agent_thread_lock);
 
 	side_rcu_wait_grace_period(&statedump_rcu_gp);
+	side_memory_usage_sub(&side_memory_usage.registration,
+		sizeof(struct side_statedump_request_handle) + strlen(handle->name) + 1);
 	free(handle->name);
 	free(handle);
 }
@@ -888,6 +1357,265 @@ int side_tracer_statedump_request_cancel(uint64_t key)
 	return SIDE_ERROR_OK;
 }
 
+static
+bool side_dynamic_struct_schema_field_type_allowed(enum side_type_label type)
+{
+	switch (type) {
+	case SIDE_TYPE_DYNAMIC_NULL:
+	case SIDE_TYPE_DYNAMIC_BOOL:
+	case SIDE_TYPE_DYNAMIC_INTEGER:
+	case SIDE_TYPE_DYNAMIC_BYTE:
+	case SIDE_TYPE_DYNAMIC_POINTER:
+	case SIDE_TYPE_DYNAMIC_FLOAT:
+	case SIDE_TYPE_DYNAMIC_STRING:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Size of a nul-terminated raw string, including the terminator. */
+static
+size_t side_raw_string_size(const struct side_type_raw_string *str)
+{
+	const char *p = (const char *) side_ptr_get(str->p);
+	size_t unit_size = str->unit_size, len = 0;
+
+	switch (unit_size) {
+	case 1:
+		while (p[len])
+			len++;
+		break;
+	case 2:
+		while (((const uint16_t *) p)[len])
+			len++;
+		break;
+	case 4:
+		while (((const uint32_t *) p)[len])
+			len++;
+		break;
+	default:
+		abort();
+	}
+	return (len + 1) * unit_size;
+}
+
+static
+bool side_raw_string_dup(struct side_type_raw_string *str, uint64_t *size)
+{
+	size_t len;
+	void *copy;
+
+	if (!side_ptr_get(str->p))
+		return true;
+	len = side_raw_string_size(str);
+	copy = malloc(len);
+	if (!copy)
+		return false;
+	memcpy(copy, side_ptr_get(str->p), len);
+	side_ptr_set(str->p, copy);
+	*size += len;
+	return true;
+}
+
+static
+void side_attr_array_free(const struct side_attr *attr, uint32_t nr_attr)
+{
+	uint32_t i;
+
+	if (!attr)
+		return;
+	for (i = 0; i < nr_attr; i++) {
+		free((void *) side_ptr_get(attr[i].key.p));
+		if (side_enum_get(attr[i].value.type) == SIDE_ATTR_TYPE_STRING)
+			free((void *) side_ptr_get(attr[i].value.u.string_value.p));
+	}
+	free((void *) attr);
+}
+
+/*
+ * Raw strings of attributes are packed members: store them with memcpy
+ * rather than through pointers to the members.
+ */
+#define SIDE_ATTR_KEY_OFFSET		offsetof(struct side_attr, key)
+#define SIDE_ATTR_STRING_VALUE_OFFSET	(offsetof(struct side_attr, value) + \
+					offsetof(struct side_attr_value, u.string_value))
+
+static
+void side_attr_store_string(struct side_attr *attr, size_t offset, const struct side_type_raw_string *str)
+{
+	memcpy((char *) attr + offset, str, sizeof(struct side_type_raw_string));
+}
+
+/*
+ * Deep copy of an attribute array, including string keys and values.
+ * Returns NULL for empty arrays and on allocation failure, which sets
+ * *nomem.
+ */
+static
+struct side_attr *side_attr_array_dup(const struct side_attr *attr, uint32_t nr_attr,
+		uint64_t *size, bool *nomem)
+{
+	struct side_type_raw_string str = {};
+	struct side_attr *copy;
+	uint32_t i;
+
+	if (!nr_attr)
+		return NULL;
+	copy = (struct side_attr *) calloc(nr_attr, sizeof(struct side_attr));
+	if (!copy)
+		goto nomem;
+	memcpy(copy, attr, nr_attr * sizeof(struct side_attr));
+	/* Clear string pointers so partial copies can be freed. */
+	for (i = 0; i < nr_attr; i++) {
+		side_attr_store_string(&copy[i], SIDE_ATTR_KEY_OFFSET, &str);
+		if (side_enum_get(attr[i].value.type) == SIDE_ATTR_TYPE_STRING)
+			side_attr_store_string(&copy[i], SIDE_ATTR_STRING_VALUE_OFFSET, &str);
+	}
+	*size += nr_attr * sizeof(struct side_attr);
+	for (i = 0; i < nr_attr; i++) {
+		str = attr[i].key;
+		if (!side_raw_string_dup(&str, size))
+			goto error;
+		side_attr_store_string(&copy[i], SIDE_ATTR_KEY_OFFSET, &str);
+		if (side_enum_get(attr[i].value.type) == SIDE_ATTR_TYPE_STRING) {
+			str = attr[i].value.u.string_value;
+			if (!side_raw_string_dup(&str, size))
+				goto error;
+			side_attr_store_string(&copy[i], SIDE_ATTR_STRING_VALUE_OFFSET, &str);
+		}
+	}
+	return copy;
+
+error:
+	side_attr_array_free(copy, nr_attr);
+nomem:
+	*nomem = true;
+	return NULL;
+}
+
+/*
+ * Attributes of the dynamic basic types allowed in schemas. Pointers
+ * are stored as integers.
+ */
+#define side_dynamic_field_attributes(_elem, _action)					\
+	do {										\
+		switch (side_enum_get((_elem)->type)) {					\
+		case SIDE_TYPE_DYNAMIC_NULL:						\
+			_action((_elem)->u.side_dynamic.side_null.attributes);		\
+			break;								\
+		case SIDE_TYPE_DYNAMIC_BOOL:						\
+			_action((_elem)->u.side_dynamic.side_bool.type.attributes);	\
+			break;								\
+		case SIDE_TYPE_DYNAMIC_INTEGER:						\
+		case SIDE_TYPE_DYNAMIC_POINTER:						\
+			_action((_elem)->u.side_dynamic.side_integer.type.attributes);	\
+			break;								\
+		case SIDE_TYPE_DYNAMIC_BYTE:						\
+			_action((_elem)->u.side_dynamic.side_byte.type.attributes);	\
+			break;								\
+		case SIDE_TYPE_DYNAMIC_FLOAT:						\
+			_action((_elem)->u.side_dynamic.side_float.type.attributes);	\
+			break;								\
+		case SIDE_TYPE_DYNAMIC_STRING:						\
+			_action((_elem)->u.side_dynamic.side_string.type.attributes);	\
+			break;								\
+		default:								\
+			abort();							\
+		}									\
+	} while (0)
+
+static
+void side_dynamic_struct_schema_handle_free(struct side_dynamic_struct_schema_handle *handle, uint32_t nr_fields)
+{
+	uint32_t i;
+
+#define side_attributes_free(_attributes)	\
+	side_attr_array_free(side_array_elements(&(_attributes)), side_array_length(&(_attributes)))
+
+	for (i = 0; i < nr_fields; i++) {
+		struct side_arg *elem = (struct side_arg *) &handle->fields[i].elem;
+
+		free((char *) side_ptr_get(handle->fields[i].field_name));
+		side_dynamic_field_attributes(elem, side_attributes_free);
+	}
+	side_attributes_free(handle->shape.attributes);
+#undef side_attributes_free
+	free(handle);
+}
+
+const struct side_dynamic_struct_schema *side_dynamic_struct_schema_register(
+		const struct side_arg_dynamic_struct *shape)
+{
+	const struct side_arg_dynamic_field *fields = side_ptr_get(shape->fields);
+	struct side_dynamic_struct_schema_handle *handle;
+	uint32_t i, nr_fields = shape->len;
+	struct side_attr *attr;
+	bool nomem = false;
+
+	for (i = 0; i < nr_fields; i++) {
+		if (!side_dynamic_struct_schema_field_type_allowed(side_enum_get(fields[i].elem.type)))
+			return NULL;
+	}
+	handle = (struct side_dynamic_struct_schema_handle *)
+		calloc(1, sizeof(struct side_dynamic_struct_schema_handle) +
+			nr_fields * sizeof(struct side_arg_dynamic_field));
+	if (!handle)
+		return NULL;
+	handle->size = sizeof(struct side_dynamic_struct_schema_handle) +
+			nr_fields * sizeof(struct side_arg_dynamic_field);
+	memcpy(handle->fields, fields, nr_fields * sizeof(struct side_arg_dynamic_field));
+
+	/* Replace the attribute array of the copy by a deep copy. */
+#define side_attributes_dup(_attributes)						\
+	do {										\
+		attr = side_attr_array_dup(side_array_elements(&(_attributes)),		\
+			side_array_length(&(_attributes)), &handle->size, &nomem);	\
+		side_ptr_set((_attributes).elements, attr);				\
+	} while (0)
+
+	for (i = 0; i < nr_fields; i++) {
+		struct side_arg *elem = (struct side_arg *) &handle->fields[i].elem;
+		char *name = strdup(side_ptr_get(fields[i].field_name));
+
+		side_ptr_set(handle->fields[i].field_name, name);
+		side_dynamic_field_attributes(elem, side_attributes_dup);
+		if (!name || nomem) {
+			/* Free fields up to and including the current one. */
+			i++;
+			goto nomem;
+		}
+		handle->size += strlen(name) + 1;
+	}
+	handle->shape.attributes = shape->attributes;
+	side_attributes_dup(handle->shape.attributes);
+	if (nomem)
+		goto nomem;
+#undef side_attributes_dup
+
+	side_ptr_set(handle->shape.fields, handle->fields);
+	handle->shape.len = nr_fields;
+	side_ptr_set(handle->schema.shape, &handle->shape);
+	handle->schema.id = __atomic_fetch_add(&side_dynamic_struct_schema_next_id, 1, __ATOMIC_RELAXED);
+	side_memory_usage_add(&side_memory_usage.registration, handle->size);
+	return &handle->schema;
+
+nomem:
+	side_dynamic_struct_schema_handle_free(handle, i);
+	return NULL;
+}
+
+void side_dynamic_struct_schema_unregister(const struct side_dynamic_struct_schema *schema)
+{
+	struct side_dynamic_struct_schema_handle *handle;
+
+	if (!schema)
+		return;
+	handle = side_container_of(schema, struct side_dynamic_struct_schema_handle, schema);
+	side_memory_usage_sub(&side_memory_usage.registration, handle->size);
+	side_dynamic_struct_schema_handle_free(handle, handle->shape.len);
+}
+
 /*
  * Tracer keys are represented on 64-bit. Return SIDE_ERROR_NOMEM on
  * overflow (which should never happen in practice).
@@ -907,6 +1635,29 @@ end:
 	return ret;
 }
 
+void side_tracer_rcu_stats(uint64_t *nr_grace_periods, uint64_t *nr_membarrier)
+{
+	*nr_grace_periods = __atomic_load_n(&event_rcu_gp.nr_grace_periods, __ATOMIC_RELAXED) +
+		__atomic_load_n(&statedump_rcu_gp.nr_grace_periods, __ATOMIC_RELAXED);
+	*nr_membarrier = __atomic_load_n(&side_rcu_nr_membarrier, __ATOMIC_RELAXED);
+}
+
+void side_tracer_memory_usage(struct side_memory_usage *usage)
+{
+	usage->callbacks = __atomic_load_n(&side_memory_usage.callbacks, __ATOMIC_RELAXED) +
+		side_callback_stats_memory_usage();
+	usage->rcu = __atomic_load_n(&side_rcu_memory_usage, __ATOMIC_RELAXED);
+	usage->statedump = __atomic_load_n(&side_memory_usage.statedump, __ATOMIC_RELAXED);
+	usage->registration = __atomic_load_n(&side_memory_usage.registration, __ATOMIC_RELAXED);
+	usage->tracer = __atomic_load_n(&side_memory_usage.tracer, __ATOMIC_RELAXED);
+	usage->arena = __atomic_load_n(&side_arena_memory_usage, __ATOMIC_RELAXED);
+}
+
+void side_tracer_memory_usage_add(int64_t bytes)
+{
+	side_memory_usage_add(&side_memory_usage.tracer, (uint64_t) bytes);
+}
+
 /*
  * Use of pthread_atfork depends on glibc 2.24 to eliminate hangs when
  * waiting for the agent thread if the agent thread calls malloc. This
@@ -969,15 +1720,64 @@ void side_after_fork_child(void)
 	pthread_mutex_unlock(&side_agent_thread_lock);
 }
 
+/*
+ * Fast exit handler. Exit handlers registered before the dynamic
+ * loader's own exit handler, i.e. from shared library constructors, run
+ * after library destructors have unregistered events. The handler is
+ * therefore not registered from side_init() nor from the registration
+ * of this library's own events (side_events_register_internal()), both
+ * run from this library's constructors, but from the first other side_events_register() call in
+ * fast exit mode, typically made by the main program's constructor. It
+ * is registered once more from side_fast_exit_enable(), which the main
+ * program calls after the shared library constructors. Each
+ * registration happens at most once.
+ */
+static
+void side_atexit(void)
+{
+	struct side_tracer_handle *tracer_handle;
+
+	if (finalized || exit_notified)
+		return;
+	exit_notified = true;
+	pthread_mutex_lock(&side_event_lock);
+	side_list_for_each_entry(tracer_handle, &side_tracer_list, node) {
+		if (tracer_handle->flags & SIDE_TRACER_NOTIFICATION_FLAG_EXIT)
+			tracer_handle->cb(SIDE_TRACER_NOTIFICATION_EXIT, NULL, 0, tracer_handle->priv);
+	}
+	pthread_mutex_unlock(&side_event_lock);
+	finalized = true;
+}
+
+static
+void side_exit_handler_register(bool *done)
+{
+	pthread_mutex_lock(&side_event_lock);
+	if (!*done) {
+		if (atexit(side_atexit))
+			abort();
+		*done = true;
+	}
+	pthread_mutex_unlock(&side_event_lock);
+}
+
 void side_init(void)
 {
 	if (initialized)
 		return;
-	side_rcu_gp_init(&event_rcu_gp);
-	side_rcu_gp_init(&statedump_rcu_gp);
 	if (pthread_atfork(side_before_fork, side_after_fork_parent, side_after_fork_child))
 		abort();
+	if (getenv("SIDE_FAST_EXIT"))
+		__atomic_store_n(&fast_exit, true, __ATOMIC_RELAXED);
 	initialized = true;
+	if (!side_events_register_internal(side_events, SIDE_ARRAY_SIZE(side_events)))
+		abort();
+}
+
+void side_fast_exit_enable(void)
+{
+	__atomic_store_n(&fast_exit, true, __ATOMIC_RELAXED);
+	side_exit_handler_register(&enable_exit_handler_done);
 }
 
 /*
@@ -991,9 +1791,12 @@ void side_exit(void)
 
 	if (finalized)
 		return;
+	side_callback_stats_exit();
 	side_list_for_each_entry_safe(handle, tmp, &side_events_list, node)
 		side_events_unregister(handle);
-	side_rcu_gp_exit(&event_rcu_gp);
-	side_rcu_gp_exit(&statedump_rcu_gp);
+	if (side_dispatch_state & SIDE_DISPATCH_RCU_INITIALIZED) {
+		side_rcu_gp_exit(&event_rcu_gp);
+		side_rcu_gp_exit(&statedump_rcu_gp);
+	}
 	finalized = true;
 }
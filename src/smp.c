@@ -276,3 +276,284 @@ int get_possible_cpus_array_len(void)
 
 	return possible_cpus_array_len_cache;
 }
+
+struct side_cpu_topology {
+	int nr_cpus;
+	int nr_nodes;
+	int nr_llcs;
+	int *cpu_node;		/* NUMA node of each possible CPU. */
+	int *cpu_llc;		/* Last-level cache of each possible CPU. */
+};
+
+static struct side_cpu_topology cpu_topology;
+static pthread_once_t cpu_topology_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Set map[cpu] to value for each CPU of a CPU list string (e.g.
+ * "0-3,8,10-11") below nr_cpus. map can be NULL.
+ *
+ * Returns the lowest CPU id of the list, or -1 on error.
+ */
+static
+int apply_cpu_list(const char *list, int *map, int nr_cpus, int value)
+{
+	const char *p = list;
+	int lowest = -1;
+
+	while (*p && *p != '\n') {
+		unsigned long first, last, cpu;
+		char *endptr;
+
+		first = strtoul(p, &endptr, 10);
+		if (endptr == p)
+			return -1;
+		last = first;
+		p = endptr;
+		if (*p == '-') {
+			p++;
+			last = strtoul(p, &endptr, 10);
+			if (endptr == p || last < first)
+				return -1;
+			p = endptr;
+		}
+		if (*p == ',')
+			p++;
+		for (cpu = first; map && cpu <= last && cpu < (unsigned long) nr_cpus; cpu++)
+			map[cpu] = value;
+		if (lowest < 0 || first < (unsigned long) lowest)
+			lowest = first < INT_MAX ? (int) first : INT_MAX;
+	}
+	return lowest;
+}
+
+/*
+ * Map each CPU to its NUMA node from the "cpulist" file of the
+ * "<sysfs_root>/node/node<N>" directories.
+ *
+ * Returns the number of nodes (highest node id + 1), or 0 if sysfs does
+ * not expose NUMA nodes.
+ */
+static
+int cpu_topology_parse_nodes(struct side_cpu_topology *topo, const char *sysfs_root)
+{
+	char buf[SIDE_CPUMASK_SIZE], path[PATH_MAX], file[PATH_MAX];
+	struct dirent *entry;
+	int max_node = -1;
+	DIR *nodedir;
+
+	if (snprintf(path, sizeof(path), "%s/node", sysfs_root) >= (int) sizeof(path))
+		return 0;
+	nodedir = opendir(path);
+	if (nodedir == NULL)
+		return 0;
+	while ((entry = readdir(nodedir))) {
+		char *endptr;
+		long node;
+
+		if (strncmp(entry->d_name, "node", 4) != 0)
+			continue;
+		node = strtol(entry->d_name + 4, &endptr, 10);
+		if (endptr == entry->d_name + 4 || *endptr != '\0' ||
+				node < 0 || node >= INT_MAX)
+			continue;
+		if (snprintf(file, sizeof(file), "%s/%s/cpulist", path, entry->d_name) >= (int) sizeof(file))
+			continue;
+		if (get_cpu_mask_from_sysfs(buf, sizeof(buf), file) <= 0)
+			continue;
+		if (apply_cpu_list(buf, topo->cpu_node, topo->nr_cpus, (int) node) < 0)
+			continue;
+		if (node > max_node)
+			max_node = node;
+	}
+	if (closedir(nodedir))
+		perror("closedir");
+	return max_node + 1;
+}
+
+/*
+ * Read the list of CPUs sharing the highest level cache of a CPU from
+ * "<sysfs_root>/cpu/cpu<N>/cache/index<M>".
+ *
+ * Returns the number of bytes read or -1 on error.
+ */
+static
+int get_llc_shared_cpu_list(const char *sysfs_root, int cpu, char *buf, size_t max_bytes)
+{
+	char file[PATH_MAX], level_buf[16];
+	int index, max_level = -1, llc_index = -1;
+
+	for (index = 0; ; index++) {
+		int level;
+
+		snprintf(file, sizeof(file),
+			"%s/cpu/cpu%d/cache/index%d/level", sysfs_root, cpu, index);
+		if (get_cpu_mask_from_sysfs(level_buf, sizeof(level_buf), file) <= 0)
+			break;
+		level = atoi(level_buf);
+		if (level > max_level) {
+			max_level = level;
+			llc_index = index;
+		}
+	}
+	if (llc_index < 0)
+		return -1;
+	snprintf(file, sizeof(file),
+		"%s/cpu/cpu%d/cache/index%d/shared_cpu_list", sysfs_root, cpu, llc_index);
+	return get_cpu_mask_from_sysfs(buf, max_bytes, file);
+}
+
+/*
+ * Map each CPU to a last-level cache. LLC ids are numbered from 0 in
+ * order of the lowest CPU id mapped to them.
+ *
+ * Returns the number of LLCs, or 0 if sysfs does not expose the cache
+ * topology of any CPU.
+ */
+static
+int cpu_topology_parse_llcs(struct side_cpu_topology *topo, const char *sysfs_root)
+{
+	char buf[SIDE_CPUMASK_SIZE];
+	int *llc_first_cpu, *first_cpu_llc, cpu, nr_llcs = 0;
+
+	/*
+	 * First CPU of the LLC of each CPU, -1 if unknown, and LLC id
+	 * of each first CPU, -1 until allocated.
+	 */
+	llc_first_cpu = (int *) malloc(2 * topo->nr_cpus * sizeof(int));
+	if (!llc_first_cpu)
+		return 0;
+	first_cpu_llc = llc_first_cpu + topo->nr_cpus;
+	for (cpu = 0; cpu < 2 * topo->nr_cpus; cpu++)
+		llc_first_cpu[cpu] = -1;
+	for (cpu = 0; cpu < topo->nr_cpus; cpu++) {
+		int first;
+
+		if (llc_first_cpu[cpu] >= 0)
+			continue;
+		if (get_llc_shared_cpu_list(sysfs_root, cpu, buf, sizeof(buf)) <= 0)
+			continue;
+		/* Parse once to get the lowest CPU, then apply it. */
+		first = apply_cpu_list(buf, NULL, topo->nr_cpus, 0);
+		if (first < 0)
+			continue;
+		apply_cpu_list(buf, llc_first_cpu, topo->nr_cpus, first);
+		llc_first_cpu[cpu] = first;
+	}
+	for (cpu = 0; cpu < topo->nr_cpus; cpu++) {
+		int first = llc_first_cpu[cpu];
+
+		if (first < 0)
+			continue;
+		/*
+		 * The first CPU may be listed after this CPU, or not be
+		 * possible at all, when the shared CPU list does not
+		 * include this CPU.
+		 */
+		if (first >= topo->nr_cpus) {
+			topo->cpu_llc[cpu] = nr_llcs++;
+			continue;
+		}
+		if (first_cpu_llc[first] < 0)
+			first_cpu_llc[first] = nr_llcs++;
+		topo->cpu_llc[cpu] = first_cpu_llc[first];
+	}
+	if (nr_llcs) {
+		/* CPUs without cache topology get an LLC of their own. */
+		for (cpu = 0; cpu < topo->nr_cpus; cpu++) {
+			if (llc_first_cpu[cpu] < 0)
+				topo->cpu_llc[cpu] = nr_llcs++;
+		}
+	}
+	free(llc_first_cpu);
+	return nr_llcs;
+}
+
+static
+void _cpu_topology_init(struct side_cpu_topology *topo, const char *sysfs_root)
+{
+	int cpu;
+
+	topo->nr_cpus = get_possible_cpus_array_len();
+	if (topo->nr_cpus < 1)
+		return;
+	topo->cpu_node = (int *) calloc(topo->nr_cpus, sizeof(int));
+	topo->cpu_llc = (int *) calloc(topo->nr_cpus, sizeof(int));
+	if (!topo->cpu_node || !topo->cpu_llc) {
+		free(topo->cpu_node);
+		free(topo->cpu_llc);
+		topo->cpu_node = NULL;
+		topo->cpu_llc = NULL;
+		topo->nr_cpus = 0;
+		return;
+	}
+	/* Fallback when sysfs lacks NUMA nodes: a single node. */
+	topo->nr_nodes = cpu_topology_parse_nodes(topo, sysfs_root);
+	if (!topo->nr_nodes) {
+		memset(topo->cpu_node, 0, topo->nr_cpus * sizeof(int));
+		topo->nr_nodes = 1;
+	}
+	/* Fallback when sysfs lacks the cache topology: one LLC per node. */
+	topo->nr_llcs = cpu_topology_parse_llcs(topo, sysfs_root);
+	if (!topo->nr_llcs) {
+		for (cpu = 0; cpu < topo->nr_cpus; cpu++)
+			topo->cpu_llc[cpu] = topo->cpu_node[cpu];
+		topo->nr_llcs = topo->nr_nodes;
+	}
+}
+
+static
+void cpu_topology_init(void)
+{
+	_cpu_topology_init(&cpu_topology, "/sys/devices/system");
+}
+
+static
+const struct side_cpu_topology *get_cpu_topology(void)
+{
+	if (pthread_once(&cpu_topology_once, cpu_topology_init))
+		abort();
+	return &cpu_topology;
+}
+
+void reload_cpu_topology(const char *sysfs_root)
+{
+	struct side_cpu_topology *topo = &cpu_topology;
+
+	(void) get_cpu_topology();
+	free(topo->cpu_node);
+	free(topo->cpu_llc);
+	memset(topo, 0, sizeof(*topo));
+	_cpu_topology_init(topo, sysfs_root);
+}
+
+int get_nr_cpu_nodes(void)
+{
+	const struct side_cpu_topology *topo = get_cpu_topology();
+
+	return topo->nr_nodes ? topo->nr_nodes : 1;
+}
+
+int get_nr_cpu_llcs(void)
+{
+	const struct side_cpu_topology *topo = get_cpu_topology();
+
+	return topo->nr_llcs ? topo->nr_llcs : 1;
+}
+
+int get_cpu_node(int cpu)
+{
+	const struct side_cpu_topology *topo = get_cpu_topology();
+
+	if (cpu < 0 || cpu >= topo->nr_cpus)
+		return 0;
+	return topo->cpu_node[cpu];
+}
+
+int get_cpu_llc(int cpu)
+{
+	const struct side_cpu_topology *topo = get_cpu_topology();
+
+	if (cpu < 0 || cpu >= topo->nr_cpus)
+		return 0;
+	return topo->cpu_llc[cpu];
+}
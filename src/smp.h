@@ -9,4 +9,31 @@
 
 int get_possible_cpus_array_len(void) __attribute__((visibility("hidden")));
 
+/*
+ * CPU topology, read from sysfs on first use and cached for the
+ * lifetime of the process.
+ *
+ * get_cpu_node() returns the NUMA node of a possible CPU, within
+ * [0, get_nr_cpu_nodes()). All CPUs are on node 0 when sysfs does not
+ * expose NUMA nodes.
+ *
+ * get_cpu_llc() returns an identifier, within [0, get_nr_cpu_llcs()),
+ * shared by the CPUs sharing a last-level cache. When sysfs does not
+ * expose the cache topology, there is one last-level cache per node.
+ *
+ * Both return 0 for CPU ids beyond get_possible_cpus_array_len().
+ */
+int get_nr_cpu_nodes(void) __attribute__((visibility("hidden")));
+int get_nr_cpu_llcs(void) __attribute__((visibility("hidden")));
+int get_cpu_node(int cpu) __attribute__((visibility("hidden")));
+int get_cpu_llc(int cpu) __attribute__((visibility("hidden")));
+
+/*
+ * Read the CPU topology again from "sysfs_root" instead of
+ * "/sys/devices/system", e.g. to exercise the fallbacks with a
+ * directory without topology. For tests: the topology must not be in
+ * use concurrently.
+ */
+void reload_cpu_topology(const char *sysfs_root) __attribute__((visibility("hidden")));
+
 #endif /* _SIDE_SMP_H */
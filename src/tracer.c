@@ -10,6 +10,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <iconv.h>
+#include <pthread.h>
 
 #include <side/trace.h>
 
@@ -19,6 +20,47 @@
 /* TODO: optionally print caller address. */
 static bool print_caller = false;
 
+/*
+ * Capture gather events as raw bytes from the tracer callback, and
+ * decode them later from the captured copy, as a consumer reading a
+ * trace buffer would. Enabled by setting the SIDE_TRACER_RAW_CAPTURE
+ * environment variable.
+ */
+static bool raw_capture = false;
+
+/*
+ * Capture plans are created when events are inserted, and passed to
+ * the tracer callback as private data. The list is protected by the
+ * side library internal lock held across notifications.
+ */
+struct raw_capture_plan {
+	struct raw_capture_plan *next;
+	const struct side_event_description *desc;
+	struct side_gather_capture_plan *plan;
+};
+
+static struct raw_capture_plan *raw_capture_plans;
+
+/*
+ * Captured events are queued, and decoded when the queue is full,
+ * before their capture plan is destroyed, and at exit.
+ */
+struct raw_capture_record {
+	struct raw_capture_record *next;
+	const struct side_gather_capture_plan *plan;
+	void *caller_addr;
+	char buf[];
+};
+
+static pthread_mutex_t raw_capture_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct raw_capture_record *raw_capture_head, **raw_capture_tail = &raw_capture_head;
+static unsigned int raw_capture_nr_records;
+
+#define RAW_CAPTURE_QUEUE_LEN		64
+
+/* Decoding events with few fields does not allocate. */
+#define RAW_CAPTURE_STACK_NR_ARGS	16
+
 #define MAX_NESTING	32
 
 enum tracer_display_base {
@@ -1018,11 +1060,211 @@ void tracer_before_print_event(const struct side_event_description *desc,
 }
 
 static
-void tracer_after_print_event(const struct side_event_description *desc __attribute__((unused)),
-		const struct side_arg_vec *side_arg_vec __attribute__((unused)),
+const char *get_attr_format(const struct side_attr *_attr, uint32_t nr_attr)
+{
+	uint32_t i;
+
+	for (i = 0; i < nr_attr; i++) {
+		const struct side_attr *attr = &_attr[i];
+		char *utf8_str = NULL;
+		bool cmp;
+
+		tracer_convert_string_to_utf8(side_ptr_get(attr->key.p), attr->key.unit_size,
+			side_enum_get(attr->key.byte_order), NULL, &utf8_str);
+		cmp = strcmp(utf8_str, "lang.c.format");
+		if (utf8_str != side_ptr_get(attr->key.p))
+			free(utf8_str);
+		if (cmp)
+			continue;
+		if (side_enum_get(attr->value.type) != SIDE_ATTR_TYPE_STRING ||
+		    attr->value.u.string_value.unit_size != 1) {
+			fprintf(stderr, "ERROR: Unexpected format attribute type\n");
+			abort();
+		}
+		return (const char *) side_ptr_get(attr->value.u.string_value.p);
+	}
+	return NULL;
+}
+
+static
+bool tracer_load_float_value(const struct side_type_float *type_float,
+		const union side_float_value *value, double *result)
+{
+	bool reverse_bo = side_enum_get(type_float->byte_order) != SIDE_TYPE_FLOAT_WORD_ORDER_HOST;
+
+	switch (type_float->float_size) {
+#if __HAVE_FLOAT32
+	case 4:
+	{
+		union {
+			_Float32 f;
+			uint32_t u;
+		} float32 = {
+			.f = value->side_float_binary32,
+		};
+
+		if (reverse_bo)
+			float32.u = side_bswap_32(float32.u);
+		*result = (double) float32.f;
+		return true;
+	}
+#endif
+#if __HAVE_FLOAT64
+	case 8:
+	{
+		union {
+			_Float64 f;
+			uint64_t u;
+		} float64 = {
+			.f = value->side_float_binary64,
+		};
+
+		if (reverse_bo)
+			float64.u = side_bswap_64(float64.u);
+		*result = (double) float64.f;
+		return true;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+/*
+ * Render one conversion of a format event. The conversion is chosen
+ * from the argument type, so a mismatching format string cannot make
+ * printf read arguments of the wrong type. Length modifiers are
+ * ignored, since the type description provides the argument size.
+ */
+SIDE_PUSH_DIAGNOSTIC()
+SIDE_DIAGNOSTIC(ignored "-Wformat-nonliteral")
+static
+void tracer_print_format_arg(char *spec, size_t spec_len, char conversion,
+		const struct side_type *type_desc, const struct side_arg *item)
+{
+	switch (side_enum_get(type_desc->type)) {
+	case SIDE_TYPE_U8:
+	case SIDE_TYPE_U16:
+	case SIDE_TYPE_U32:
+	case SIDE_TYPE_U64:
+	case SIDE_TYPE_S8:
+	case SIDE_TYPE_S16:
+	case SIDE_TYPE_S32:
+	case SIDE_TYPE_S64:
+	case SIDE_TYPE_POINTER:
+	{
+		union int_value v;
+
+		v = tracer_load_integer_value(&type_desc->u.side_integer,
+				&item->u.side_static.integer_value, 0, NULL);
+		if (conversion == 'p') {
+			strcpy(&spec[spec_len], "p");
+			printf(spec, (void *) (uintptr_t) v.u[SIDE_INTEGER128_SPLIT_LOW]);
+		} else if (conversion == 'c') {
+			strcpy(&spec[spec_len], "c");
+			printf(spec, (int) v.s[SIDE_INTEGER128_SPLIT_LOW]);
+		} else if (strchr("ouxX", conversion)) {
+			spec[spec_len] = 'l';
+			spec[spec_len + 1] = 'l';
+			spec[spec_len + 2] = conversion;
+			spec[spec_len + 3] = '\0';
+			printf(spec, (unsigned long long) v.u[SIDE_INTEGER128_SPLIT_LOW]);
+		} else if (type_desc->u.side_integer.signedness) {
+			strcpy(&spec[spec_len], "lld");
+			printf(spec, (long long) v.s[SIDE_INTEGER128_SPLIT_LOW]);
+		} else {
+			strcpy(&spec[spec_len], "llu");
+			printf(spec, (unsigned long long) v.u[SIDE_INTEGER128_SPLIT_LOW]);
+		}
+		break;
+	}
+	case SIDE_TYPE_BYTE:
+		strcpy(&spec[spec_len], "u");
+		printf(spec, (unsigned int) item->u.side_static.byte_value);
+		break;
+	case SIDE_TYPE_FLOAT_BINARY32:
+	case SIDE_TYPE_FLOAT_BINARY64:
+	{
+		double v;
+
+		if (!tracer_load_float_value(&type_desc->u.side_float,
+				&item->u.side_static.float_value, &v)) {
+			printf("<unsupported>");
+			break;
+		}
+		spec[spec_len] = strchr("fFeEgGaA", conversion) ? conversion : 'g';
+		spec[spec_len + 1] = '\0';
+		printf(spec, v);
+		break;
+	}
+	case SIDE_TYPE_STRING_UTF8:
+		strcpy(&spec[spec_len], "s");
+		printf(spec, (const char *) side_ptr_get(item->u.side_static.string_value));
+		break;
+	default:
+		printf("<unsupported>");
+		break;
+	}
+}
+SIDE_POP_DIAGNOSTIC()
+
+#define FORMAT_SPEC_MAX_LEN	16
+
+static
+void tracer_print_format(const char *fmt, const struct side_event_description *desc,
+		const struct side_arg_vec *side_arg_vec)
+{
+	const struct side_event_field *fields = side_array_elements(&desc->fields);
+	const struct side_arg *sav = side_ptr_get(side_arg_vec->sav);
+	uint32_t nr_args = side_arg_vec->len, i = 0;
+	const char *p;
+
+	printf(", formatted: \"");
+	for (p = fmt; *p; p++) {
+		/* Room for the "ll" length modifier, conversion, and '\0'. */
+		char spec[FORMAT_SPEC_MAX_LEN + 4];
+		const char *start = p;
+		size_t spec_len;
+
+		if (*p != '%') {
+			putchar(*p);
+			continue;
+		}
+		if (p[1] == '%') {
+			putchar('%');
+			p++;
+			continue;
+		}
+		p++;
+		while (*p && strchr("-+ #0", *p))
+			p++;
+		while ((*p >= '0' && *p <= '9') || *p == '.')
+			p++;
+		spec_len = p - start;
+		while (*p && strchr("hlLqjzt", *p))
+			p++;
+		if (!*p || spec_len > FORMAT_SPEC_MAX_LEN || i >= nr_args) {
+			printf("<invalid format>");
+			break;
+		}
+		memcpy(spec, start, spec_len);
+		tracer_print_format_arg(spec, spec_len, *p, &fields[i].side_type, &sav[i]);
+		i++;
+	}
+	printf("\"");
+}
+
+static
+void tracer_after_print_event(const struct side_event_description *desc,
+		const struct side_arg_vec *side_arg_vec,
 		const struct side_arg_dynamic_struct *var_struct __attribute__((unused)),
 		void *caller_addr __attribute__((unused)), void *priv __attribute__((unused)))
 {
+	const char *fmt;
+
+	fmt = get_attr_format(side_array_elements(&desc->attributes), side_array_length(&desc->attributes));
+	if (fmt)
+		tracer_print_format(fmt, desc, side_arg_vec);
 	printf("\n");
 }
 
@@ -1519,6 +1761,43 @@ void tracer_after_print_gather_vla(const struct side_type_vla *side_vla,
 	do_tracer_after_print_vla(side_vla, NULL, priv);
 }
 
+static
+void tracer_before_print_gather_iovec(const struct side_type_gather_iovec *side_iovec,
+	uint32_t iovcnt, uint64_t capture_len, void *priv)
+{
+	struct print_ctx *ctx = (struct print_ctx *) priv;
+
+	print_attributes("attr", ":", side_array_elements(&side_iovec->attributes), side_array_length(&side_iovec->attributes));
+	printf("%s", side_array_length(&side_iovec->attributes) ? ", " : "");
+	printf("iovcnt: %" PRIu32 ", capture_len: %" PRIu64 ", segments: [", iovcnt, capture_len);
+	push_nesting(ctx);
+}
+
+static
+void tracer_print_gather_iovec_segment(const struct side_type_gather_iovec *side_iovec __attribute__((unused)),
+	const void *base, size_t len, void *priv)
+{
+	struct print_ctx *ctx = (struct print_ctx *) priv;
+	const uint8_t *p = (const uint8_t *) base;
+	size_t i;
+
+	printf("%s { length: %zu, bytes: [", get_nested_item_nr(ctx) ? "," : "", len);
+	for (i = 0; i < len; i++)
+		printf("%s 0x%" PRIx8, i ? "," : "", p[i]);
+	printf(" ] }");
+	inc_nested_item_nr(ctx);
+}
+
+static
+void tracer_after_print_gather_iovec(const struct side_type_gather_iovec *side_iovec __attribute__((unused)),
+	uint32_t iovcnt __attribute__((unused)), uint64_t capture_len __attribute__((unused)), void *priv)
+{
+	struct print_ctx *ctx = (struct print_ctx *) priv;
+
+	pop_nesting(ctx);
+	printf(" ]");
+}
+
 static
 void tracer_print_gather_enum(const struct side_type_gather_enum *type,
 	const union side_integer_value *value,
@@ -1679,6 +1958,29 @@ void tracer_after_print_dynamic_struct_visitor(const struct side_arg *item, void
 	printf(" }");
 }
 
+static
+void tracer_before_print_dynamic_struct_schema(const struct side_dynamic_struct_schema *schema,
+	void *priv)
+{
+	const struct side_arg_dynamic_struct *shape = side_ptr_get(schema->shape);
+	struct print_ctx *ctx = (struct print_ctx *) priv;
+
+	print_attributes("attr", "::", side_array_elements(&shape->attributes), side_array_length(&shape->attributes));
+	printf("%s", side_array_length(&shape->attributes) ? ", " : "");
+	printf("schema:: %" PRIu64 ", fields:: {", schema->id);
+	push_nesting(ctx);
+}
+
+static
+void tracer_after_print_dynamic_struct_schema(const struct side_dynamic_struct_schema *schema __attribute__((unused)),
+	void *priv)
+{
+	struct print_ctx *ctx = (struct print_ctx *) priv;
+
+	pop_nesting(ctx);
+	printf(" }");
+}
+
 static
 void tracer_before_print_dynamic_vla(const struct side_arg_dynamic_vla *dynamic_vla, void *priv)
 {
@@ -1779,6 +2081,9 @@ static struct side_type_visitor type_visitor = {
 	.after_gather_array_type_func = tracer_after_print_gather_array,
 	.before_gather_vla_type_func = tracer_before_print_gather_vla,
 	.after_gather_vla_type_func = tracer_after_print_gather_vla,
+	.before_gather_iovec_type_func = tracer_before_print_gather_iovec,
+	.gather_iovec_segment_func = tracer_print_gather_iovec_segment,
+	.after_gather_iovec_type_func = tracer_after_print_gather_iovec,
 
 	/* Gather enumeration types. */
 	.gather_enum_type_func = tracer_print_gather_enum,
@@ -1802,23 +2107,158 @@ static struct side_type_visitor type_visitor = {
 	.after_dynamic_struct_func = tracer_after_print_dynamic_struct,
 	.before_dynamic_struct_visitor_func = tracer_before_print_dynamic_struct_visitor,
 	.after_dynamic_struct_visitor_func = tracer_after_print_dynamic_struct_visitor,
+	.before_dynamic_struct_schema_func = tracer_before_print_dynamic_struct_schema,
+	.after_dynamic_struct_schema_func = tracer_after_print_dynamic_struct_schema,
 	.before_dynamic_vla_func = tracer_before_print_dynamic_vla,
 	.after_dynamic_vla_func = tracer_after_print_dynamic_vla,
 	.before_dynamic_vla_visitor_func = tracer_before_print_dynamic_vla_visitor,
 	.after_dynamic_vla_visitor_func = tracer_after_print_dynamic_vla_visitor,
 };
 
+static
+void raw_capture_decode(const struct raw_capture_record *record)
+{
+	const struct side_event_description *desc = side_gather_capture_plan_description(record->plan);
+	struct side_arg stack_sav[RAW_CAPTURE_STACK_NR_ARGS];
+	uint32_t nr_sav = side_array_length(&desc->fields);
+	struct side_arg *sav = stack_sav;
+	struct print_ctx ctx = {};
+
+	if (nr_sav > RAW_CAPTURE_STACK_NR_ARGS) {
+		sav = (struct side_arg *) calloc(nr_sav, sizeof(struct side_arg));
+		if (!sav)
+			abort();
+	}
+	if (side_gather_capture_decode(record->plan, record->buf,
+			side_gather_capture_plan_size(record->plan), sav, nr_sav))
+		abort();
+	{
+		struct side_arg_vec decoded_vec = {
+			.sav = SIDE_PTR_INIT(sav),
+			.len = nr_sav,
+		};
+
+		type_visitor_event(&type_visitor, desc, &decoded_vec, NULL, record->caller_addr, &ctx);
+	}
+	if (sav != stack_sav)
+		free(sav);
+}
+
+/* Called with raw_capture_lock held. */
+static
+void raw_capture_flush_locked(void)
+{
+	struct raw_capture_record *record, *next;
+
+	for (record = raw_capture_head; record; record = next) {
+		next = record->next;
+		raw_capture_decode(record);
+		free(record);
+	}
+	raw_capture_head = NULL;
+	raw_capture_tail = &raw_capture_head;
+	raw_capture_nr_records = 0;
+}
+
+static
+void raw_capture_flush(void)
+{
+	pthread_mutex_lock(&raw_capture_lock);
+	raw_capture_flush_locked();
+	pthread_mutex_unlock(&raw_capture_lock);
+}
+
+static
+void tracer_call_raw_capture(const struct side_gather_capture_plan *plan,
+		const struct side_arg_vec *side_arg_vec,
+		void *caller_addr)
+{
+	size_t len = side_gather_capture_plan_size(plan);
+	struct raw_capture_record *record;
+
+	record = (struct raw_capture_record *) malloc(sizeof(struct raw_capture_record) + len);
+	if (!record)
+		abort();
+	if (side_gather_capture(plan, side_arg_vec, record->buf, len))
+		abort();
+	record->next = NULL;
+	record->plan = plan;
+	record->caller_addr = caller_addr;
+	pthread_mutex_lock(&raw_capture_lock);
+	*raw_capture_tail = record;
+	raw_capture_tail = &record->next;
+	if (++raw_capture_nr_records >= RAW_CAPTURE_QUEUE_LEN)
+		raw_capture_flush_locked();
+	pthread_mutex_unlock(&raw_capture_lock);
+}
+
 static
 void tracer_call(const struct side_event_description *desc,
 		const struct side_arg_vec *side_arg_vec,
-		void *priv __attribute__((unused)),
+		void *priv,
 		void *caller_addr)
 {
 	struct print_ctx ctx = {};
 
+	/* Events which can be captured are registered with their plan. */
+	if (priv) {
+		tracer_call_raw_capture((const struct side_gather_capture_plan *) priv,
+			side_arg_vec, caller_addr);
+		return;
+	}
 	type_visitor_event(&type_visitor, desc, side_arg_vec, NULL, caller_addr, &ctx);
 }
 
+static
+struct side_gather_capture_plan *raw_capture_plan_create(const struct side_event_description *desc)
+{
+	struct raw_capture_plan *entry;
+	struct side_gather_capture_plan *plan;
+
+	if (!raw_capture)
+		return NULL;
+	plan = side_gather_capture_plan_create(desc);
+	if (!plan)
+		return NULL;
+	entry = (struct raw_capture_plan *) calloc(1, sizeof(struct raw_capture_plan));
+	if (!entry)
+		abort();
+	entry->desc = desc;
+	entry->plan = plan;
+	entry->next = raw_capture_plans;
+	raw_capture_plans = entry;
+	return plan;
+}
+
+/* Detach the plan of an event from the list, NULL if there is none. */
+static
+struct side_gather_capture_plan *raw_capture_plan_remove(const struct side_event_description *desc)
+{
+	struct raw_capture_plan **p, *entry;
+	struct side_gather_capture_plan *plan;
+
+	for (p = &raw_capture_plans; (entry = *p) != NULL; p = &entry->next) {
+		if (entry->desc != desc)
+			continue;
+		*p = entry->next;
+		plan = entry->plan;
+		free(entry);
+		return plan;
+	}
+	return NULL;
+}
+
+static
+void tracer_call_batch(const struct side_event_description *desc,
+		const struct side_arg_vec *side_arg_vecs, uint32_t nr_vecs,
+		void *priv, void *caller_addr)
+{
+	uint32_t i;
+
+	for (i = 0; i < nr_vecs; i++)
+		tracer_call(desc, &side_arg_vecs[i], priv, caller_addr);
+}
+
 static
 void tracer_call_variadic(const struct side_event_description *desc,
 		const struct side_arg_vec *side_arg_vec,
@@ -1834,7 +2274,11 @@ void tracer_call_variadic(const struct side_event_description *desc,
 static
 void before_print_description_event(const struct side_event_description *desc, void *priv __attribute__((unused)))
 {
+	uint64_t fingerprint;
+
 	printf("event description: provider: %s, event: %s", side_ptr_get(desc->provider_name), side_ptr_get(desc->event_name));
+	if (side_event_description_fingerprint(desc, &fingerprint) == SIDE_ERROR_OK)
+		printf(", fingerprint: 0x%016" PRIx64, fingerprint);
 	print_attributes(", attr", ":", side_array_elements(&desc->attributes), side_array_length(&desc->attributes));
 }
 
@@ -2441,6 +2885,29 @@ void after_element_print_description_gather_vla(const struct side_type_gather_vl
 	printf(" }");
 }
 
+static
+void before_print_description_gather_iovec(const struct side_type_gather_iovec *side_gather_iovec, void *priv)
+{
+	struct print_ctx *ctx = (struct print_ctx *) priv;
+
+	print_attributes("attr", ":", side_array_elements(&side_gather_iovec->attributes), side_array_length(&side_gather_iovec->attributes));
+	printf("%s", side_array_length(&side_gather_iovec->attributes)? ", " : "");
+	printf("type: gather_iovec { offset: %" PRIu64 ", access_mode: %s, capture_max: %" PRIu64 ", length:",
+		side_gather_iovec->offset,
+		side_enum_get(side_gather_iovec->access_mode) == SIDE_TYPE_GATHER_ACCESS_DIRECT ? "\"direct\"" : "\"pointer\"",
+		side_gather_iovec->capture_max);
+	push_nesting(ctx);
+}
+
+static
+void after_print_description_gather_iovec(const struct side_type_gather_iovec *side_gather_iovec __attribute__((unused)), void *priv)
+{
+	struct print_ctx *ctx = (struct print_ctx *) priv;
+
+	pop_nesting(ctx);
+	printf(" }");
+}
+
 static
 void before_print_description_gather_enum(const struct side_type_gather_enum *type, void *priv)
 {
@@ -2528,6 +2995,8 @@ struct side_description_visitor description_visitor = {
 	.before_gather_vla_type_func = before_print_description_gather_vla,
 	.after_length_gather_vla_type_func = after_length_print_description_gather_vla,
 	.after_element_gather_vla_type_func = after_element_print_description_gather_vla,
+	.before_gather_iovec_type_func = before_print_description_gather_iovec,
+	.after_gather_iovec_type_func = after_print_description_gather_iovec,
 
 	/* Gather enumeration types. */
 	.before_gather_enum_type_func = before_print_description_gather_enum,
@@ -2553,6 +3022,12 @@ void tracer_event_notification(enum side_tracer_notification notif,
 	uint32_t i;
 	int ret;
 
+	if (notif == SIDE_TRACER_NOTIFICATION_EXIT) {
+		/* Flush the trace output before fast exit. */
+		raw_capture_flush();
+		fflush(stdout);
+		return;
+	}
 	printf("----------------------------------------------------------\n");
 	printf("Tracer notified of events %s\n",
 		notif == SIDE_TRACER_NOTIFICATION_INSERT_EVENTS ? "inserted" : "removed");
@@ -2590,7 +3065,8 @@ void tracer_event_notification(enum side_tracer_notification notif,
 				if (ret)
 					abort();
 			} else {
-				ret = side_tracer_callback_register(event, tracer_call, NULL, tracer_key);
+				ret = side_tracer_callback_batch_register(event, tracer_call, tracer_call_batch,
+						raw_capture_plan_create(event), tracer_key);
 				if (ret)
 					abort();
 			}
@@ -2600,9 +3076,19 @@ void tracer_event_notification(enum side_tracer_notification notif,
 				if (ret)
 					abort();
 			} else {
-				ret = side_tracer_callback_unregister(event, tracer_call, NULL, tracer_key);
+				struct side_gather_capture_plan *plan = raw_capture_plan_remove(event);
+
+				ret = side_tracer_callback_unregister(event, tracer_call, plan, tracer_key);
 				if (ret)
 					abort();
+				/*
+				 * Unregistration waits for callbacks to complete:
+				 * decode the events captured with the plan before
+				 * destroying it.
+				 */
+				if (plan)
+					raw_capture_flush();
+				side_gather_capture_plan_destroy(plan);
 			}
 		}
 	}
@@ -2614,9 +3100,15 @@ void tracer_init(void);
 static
 void tracer_init(void)
 {
+	/* Keep the demo tracer out of the way, e.g. for benchmarks. */
+	if (getenv("SIDE_TRACER_DISABLE"))
+		return;
+	if (getenv("SIDE_TRACER_RAW_CAPTURE"))
+		raw_capture = true;
 	if (side_tracer_request_key(&tracer_key))
 		abort();
-	tracer_handle = side_tracer_event_notification_register(tracer_event_notification, NULL);
+	tracer_handle = side_tracer_event_notification_register_flags(tracer_event_notification, NULL,
+			SIDE_TRACER_NOTIFICATION_FLAG_EXIT);
 	if (!tracer_handle)
 		abort();
 }
@@ -2626,5 +3118,8 @@ void tracer_exit(void);
 static
 void tracer_exit(void)
 {
+	if (!tracer_handle)
+		return;
+	raw_capture_flush();
 	side_tracer_event_notification_unregister(tracer_handle);
 }
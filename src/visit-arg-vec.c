@@ -543,13 +543,6 @@ uint32_t type_visitor_gather_array(const struct side_type_visitor *type_visitor,
 	for (i = 0; i < side_array->length; i++) {
 		const struct side_type *elem_type = side_ptr_get(side_array->elem_type);
 
-		switch (side_enum_get(elem_type->type)) {
-		case SIDE_TYPE_GATHER_VLA:
-			fprintf(stderr, "<gather VLA only supported within gather structures>\n");
-			abort();
-		default:
-			break;
-		}
 		ptr += visit_gather_elem(type_visitor, elem_type, ptr, priv);
 	}
 	if (type_visitor->after_gather_array_type_func)
@@ -590,13 +583,6 @@ uint32_t type_visitor_gather_vla(const struct side_type_visitor *type_visitor, c
 	for (i = 0; i < length; i++) {
 		const struct side_type *elem_type = side_ptr_get(side_vla->elem_type);
 
-		switch (side_enum_get(elem_type->type)) {
-		case SIDE_TYPE_GATHER_VLA:
-			fprintf(stderr, "<gather VLA only supported within gather structures>\n");
-			abort();
-		default:
-			break;
-		}
 		ptr += visit_gather_elem(type_visitor, elem_type, ptr, priv);
 	}
 	if (type_visitor->after_gather_vla_type_func)
@@ -604,6 +590,66 @@ uint32_t type_visitor_gather_vla(const struct side_type_visitor *type_visitor, c
 	return tracer_gather_size(access_mode, ptr - orig_ptr);
 }
 
+static
+uint32_t type_visitor_gather_iovec(const struct side_type_visitor *type_visitor, const struct side_type_gather *type_gather, const void *_ptr, const void *_length_ptr, void *priv)
+{
+	const struct side_type_gather_iovec *side_iovec = &type_gather->u.side_iovec;
+	enum side_type_gather_access_mode access_mode = side_enum_get(side_iovec->access_mode);
+	const struct side_type *length_type = side_ptr_get(side_iovec->length_type);
+	const char *ptr = (const char *) _ptr;
+	const struct side_iovec *iov;
+	uint64_t capture_len = 0, capture_max = side_iovec->capture_max;
+	union int_value v = {};
+	uint32_t i, iovcnt;
+
+	/* Access length */
+	switch (side_enum_get(length_type->type)) {
+	case SIDE_TYPE_GATHER_INTEGER:
+		break;
+	default:
+		fprintf(stderr, "<gather iovec expects integer gather length type>\n");
+		abort();
+	}
+	v = tracer_load_gather_integer_value(&length_type->u.side_gather.u.side_integer,
+					_length_ptr);
+	if (v.u[SIDE_INTEGER128_SPLIT_HIGH] || v.u[SIDE_INTEGER128_SPLIT_LOW] > UINT32_MAX) {
+		fprintf(stderr, "Unexpected iovec length value\n");
+		abort();
+	}
+	iovcnt = (uint32_t) v.u[SIDE_INTEGER128_SPLIT_LOW];
+	if (iovcnt > UINT32_MAX / sizeof(struct side_iovec)) {
+		fprintf(stderr, "Unexpected iovec length value\n");
+		abort();
+	}
+	iov = (const struct side_iovec *) tracer_gather_access(access_mode, ptr + side_iovec->offset);
+	/* First pass: compute the captured payload length. */
+	for (i = 0; i < iovcnt; i++) {
+		if (capture_max && capture_len + iov[i].len >= capture_max) {
+			capture_len = capture_max;
+			break;
+		}
+		capture_len += iov[i].len;
+	}
+	if (type_visitor->before_gather_iovec_type_func)
+		type_visitor->before_gather_iovec_type_func(side_iovec, iovcnt, capture_len, priv);
+	if (type_visitor->gather_iovec_segment_func) {
+		uint64_t remaining = capture_len;
+
+		for (i = 0; i < iovcnt && remaining; i++) {
+			uint64_t len = iov[i].len;
+
+			if (len > remaining)
+				len = remaining;
+			if (len)
+				type_visitor->gather_iovec_segment_func(side_iovec, side_ptr_get(iov[i].base), (size_t) len, priv);
+			remaining -= len;
+		}
+	}
+	if (type_visitor->after_gather_iovec_type_func)
+		type_visitor->after_gather_iovec_type_func(side_iovec, iovcnt, capture_len, priv);
+	return tracer_gather_size(access_mode, iovcnt * sizeof(struct side_iovec));
+}
+
 static
 uint32_t type_visitor_gather_bool(const struct side_type_visitor *type_visitor, const struct side_type_gather *type_gather, const void *_ptr, void *priv)
 {
@@ -763,6 +809,9 @@ uint32_t visit_gather_type(const struct side_type_visitor *type_visitor, const s
 	case SIDE_TYPE_GATHER_VLA:
 		len = type_visitor_gather_vla(type_visitor, &type_desc->u.side_gather, ptr, ptr, priv);
 		break;
+	case SIDE_TYPE_GATHER_IOVEC:
+		len = type_visitor_gather_iovec(type_visitor, &type_desc->u.side_gather, ptr, ptr, priv);
+		break;
 	default:
 		fprintf(stderr, "<UNKNOWN GATHER TYPE>");
 		abort();
@@ -900,6 +949,64 @@ void type_visitor_dynamic_vla(const struct side_type_visitor *type_visitor, cons
 		type_visitor->after_dynamic_vla_func(vla, priv);
 }
 
+/*
+ * Visit each schema field as a dynamic field combining the field name
+ * and type from the schema shape with the value passed by the caller.
+ */
+static
+void type_visitor_dynamic_struct_schema(const struct side_type_visitor *type_visitor, const struct side_arg *item, void *priv)
+{
+	const struct side_dynamic_struct_schema *schema = side_ptr_get(item->u.side_dynamic.side_dynamic_struct_schema.schema);
+	const union side_arg_dynamic_value *values = side_ptr_get(item->u.side_dynamic.side_dynamic_struct_schema.values);
+	const struct side_arg_dynamic_struct *shape;
+	const struct side_arg_dynamic_field *fields;
+	uint32_t i, len = item->u.side_dynamic.side_dynamic_struct_schema.len;
+
+	if (!schema)
+		abort();
+	shape = side_ptr_get(schema->shape);
+	fields = side_ptr_get(shape->fields);
+	if (shape->len != len) {
+		fprintf(stderr, "ERROR: number of values mismatch with dynamic struct schema\n");
+		abort();
+	}
+	if (type_visitor->before_dynamic_struct_schema_func)
+		type_visitor->before_dynamic_struct_schema_func(schema, priv);
+	for (i = 0; i < len; i++) {
+		struct side_arg_dynamic_field field;
+		union side_arg_dynamic *dynamic;
+
+		memcpy(&field, &fields[i], sizeof(field));
+		dynamic = (union side_arg_dynamic *) &field.elem.u.side_dynamic;
+		switch (side_enum_get(field.elem.type)) {
+		case SIDE_TYPE_DYNAMIC_NULL:
+			break;
+		case SIDE_TYPE_DYNAMIC_BOOL:
+			dynamic->side_bool.value = values[i].bool_value;
+			break;
+		case SIDE_TYPE_DYNAMIC_INTEGER:
+		case SIDE_TYPE_DYNAMIC_POINTER:
+			dynamic->side_integer.value = values[i].integer_value;
+			break;
+		case SIDE_TYPE_DYNAMIC_BYTE:
+			dynamic->side_byte.value = values[i].byte_value;
+			break;
+		case SIDE_TYPE_DYNAMIC_FLOAT:
+			dynamic->side_float.value = values[i].float_value;
+			break;
+		case SIDE_TYPE_DYNAMIC_STRING:
+			dynamic->side_string.value = (uintptr_t) side_ptr_get(values[i].string_value);
+			break;
+		default:
+			fprintf(stderr, "<UNEXPECTED DYNAMIC STRUCT SCHEMA FIELD TYPE>\n");
+			abort();
+		}
+		visit_dynamic_field(type_visitor, &field, priv);
+	}
+	if (type_visitor->after_dynamic_struct_schema_func)
+		type_visitor->after_dynamic_struct_schema_func(schema, priv);
+}
+
 struct tracer_dynamic_vla_visitor_priv {
 	const struct side_type_visitor *type_visitor;
 	void *priv;
@@ -993,6 +1100,9 @@ void visit_dynamic_type(const struct side_type_visitor *type_visitor, const stru
 	case SIDE_TYPE_DYNAMIC_STRUCT_VISITOR:
 		type_visitor_dynamic_struct_visitor(type_visitor, dynamic_item, priv);
 		break;
+	case SIDE_TYPE_DYNAMIC_STRUCT_SCHEMA:
+		type_visitor_dynamic_struct_schema(type_visitor, dynamic_item, priv);
+		break;
 	case SIDE_TYPE_DYNAMIC_VLA:
 		type_visitor_dynamic_vla(type_visitor, side_ptr_get(dynamic_item->u.side_dynamic.side_dynamic_vla), priv);
 		break;
@@ -1097,6 +1207,7 @@ const char *side_type_label_to_string(enum side_type_label label)
 	case SIDE_TYPE_GATHER_STRUCT: return "SIDE_TYPE_GATHER_STRUCT";
 	case SIDE_TYPE_GATHER_ARRAY: return "SIDE_TYPE_GATHER_ARRAY";
 	case SIDE_TYPE_GATHER_VLA: return "SIDE_TYPE_GATHER_VLA";
+	case SIDE_TYPE_GATHER_IOVEC: return "SIDE_TYPE_GATHER_IOVEC";
 	case SIDE_TYPE_GATHER_ENUM: return "SIDE_TYPE_GATHER_ENUM";
 	case SIDE_TYPE_DYNAMIC_NULL: return "SIDE_TYPE_DYNAMIC_NULL";
 	case SIDE_TYPE_DYNAMIC_BOOL: return "SIDE_TYPE_DYNAMIC_BOOL";
@@ -1107,6 +1218,7 @@ const char *side_type_label_to_string(enum side_type_label label)
 	case SIDE_TYPE_DYNAMIC_STRING: return "SIDE_TYPE_DYNAMIC_STRING";
 	case SIDE_TYPE_DYNAMIC_STRUCT: return "SIDE_TYPE_DYNAMIC_STRUCT";
 	case SIDE_TYPE_DYNAMIC_STRUCT_VISITOR: return "SIDE_TYPE_DYNAMIC_STRUCT_VISITOR";
+	case SIDE_TYPE_DYNAMIC_STRUCT_SCHEMA: return "SIDE_TYPE_DYNAMIC_STRUCT_SCHEMA";
 	case SIDE_TYPE_DYNAMIC_VLA: return "SIDE_TYPE_DYNAMIC_VLA";
 	case SIDE_TYPE_DYNAMIC_VLA_VISITOR: return "SIDE_TYPE_DYNAMIC_VLA_VISITOR";
 	default:
@@ -1200,6 +1312,7 @@ static void ensure_types_compatible(const struct visit_context *ctx,
 		case SIDE_TYPE_DYNAMIC_STRING:
 		case SIDE_TYPE_DYNAMIC_STRUCT:
 		case SIDE_TYPE_DYNAMIC_STRUCT_VISITOR:
+		case SIDE_TYPE_DYNAMIC_STRUCT_SCHEMA:
 		case SIDE_TYPE_DYNAMIC_VLA:
 		case SIDE_TYPE_DYNAMIC_VLA_VISITOR:
 			break;
@@ -1332,6 +1445,10 @@ void side_visit_type(const struct side_type_visitor *type_visitor,
 		(void) type_visitor_gather_vla(type_visitor, &type_desc->u.side_gather, side_ptr_get(item->u.side_static.side_array_gather_ptr),
 				side_ptr_get(item->u.side_static.side_vla_gather.length_ptr), priv);
 		break;
+	case SIDE_TYPE_GATHER_IOVEC:
+		(void) type_visitor_gather_iovec(type_visitor, &type_desc->u.side_gather, side_ptr_get(item->u.side_static.side_iovec_gather.ptr),
+				side_ptr_get(item->u.side_static.side_iovec_gather.length_ptr), priv);
+		break;
 
 		/* Gather enumeration types */
 	case SIDE_TYPE_GATHER_ENUM:
@@ -1350,6 +1467,7 @@ void side_visit_type(const struct side_type_visitor *type_visitor,
 	/* Dynamic compound types */
 	case SIDE_TYPE_DYNAMIC_STRUCT:		/* Fallthrough */
 	case SIDE_TYPE_DYNAMIC_STRUCT_VISITOR:	/* Fallthrough */
+	case SIDE_TYPE_DYNAMIC_STRUCT_SCHEMA:	/* Fallthrough */
 	case SIDE_TYPE_DYNAMIC_VLA:		/* Fallthrough */
 	case SIDE_TYPE_DYNAMIC_VLA_VISITOR:
 		visit_dynamic_type(type_visitor, item, priv);
@@ -68,6 +68,9 @@ struct side_type_visitor {
 	void (*after_gather_array_type_func)(const struct side_type_array *type, void *priv);
 	void (*before_gather_vla_type_func)(const struct side_type_vla *type, uint32_t length, void *priv);
 	void (*after_gather_vla_type_func)(const struct side_type_vla *type, uint32_t length, void *priv);
+	void (*before_gather_iovec_type_func)(const struct side_type_gather_iovec *type, uint32_t iovcnt, uint64_t capture_len, void *priv);
+	void (*gather_iovec_segment_func)(const struct side_type_gather_iovec *type, const void *base, size_t len, void *priv);
+	void (*after_gather_iovec_type_func)(const struct side_type_gather_iovec *type, uint32_t iovcnt, uint64_t capture_len, void *priv);
 
 	/* Gather enumeration types. */
 	void (*gather_enum_type_func)(const struct side_type_gather_enum *type, const union side_integer_value *value, void *priv);
@@ -91,6 +94,8 @@ struct side_type_visitor {
 	void (*after_dynamic_struct_func)(const struct side_arg_dynamic_struct *dynamic_struct, void *priv);
 	void (*before_dynamic_struct_visitor_func)(const struct side_arg *item, void *priv);
 	void (*after_dynamic_struct_visitor_func)(const struct side_arg *item, void *priv);
+	void (*before_dynamic_struct_schema_func)(const struct side_dynamic_struct_schema *schema, void *priv);
+	void (*after_dynamic_struct_schema_func)(const struct side_dynamic_struct_schema *schema, void *priv);
 	void (*before_dynamic_vla_func)(const struct side_arg_dynamic_vla *vla, void *priv);
 	void (*after_dynamic_vla_func)(const struct side_arg_dynamic_vla *vla, void *priv);
 	void (*before_dynamic_vla_visitor_func)(const struct side_arg *item, void *priv);
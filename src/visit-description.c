@@ -196,6 +196,58 @@ void description_visitor_gather_struct(const struct side_description_visitor *de
 		description_visitor->after_gather_struct_type_func(side_gather_struct, priv);
 }
 
+/*
+ * Gather VLA elements of gather arrays and gather VLAs are described by
+ * a gather structure whose size is the record stride. Check the fields
+ * locating the VLA lie within the record.
+ */
+static
+void description_visitor_check_gather_elem(const struct side_type *elem_type)
+{
+	const struct side_type_gather_struct *side_gather_struct;
+	const struct side_type_struct *side_struct;
+	uint32_t i;
+
+	switch (side_enum_get(elem_type->type)) {
+	case SIDE_TYPE_GATHER_VLA:
+		fprintf(stderr, "<gather VLA elements must be described by a gather structure giving the record size>\n");
+		abort();
+	case SIDE_TYPE_GATHER_STRUCT:
+		break;
+	default:
+		return;
+	}
+	side_gather_struct = &elem_type->u.side_gather.u.side_struct;
+	if (side_enum_get(side_gather_struct->access_mode) != SIDE_TYPE_GATHER_ACCESS_DIRECT)
+		return;
+	side_struct = side_ptr_get(side_gather_struct->type);
+	for (i = 0; i < side_array_length(&side_struct->fields); i++) {
+		const struct side_event_field *field = side_array_at(&side_struct->fields, i);
+		const struct side_type_gather_vla *side_gather_vla;
+		const struct side_type_gather_integer *side_length;
+		const struct side_type *length_type;
+		uint64_t vla_end, length_end;
+
+		if (side_enum_get(field->side_type.type) != SIDE_TYPE_GATHER_VLA)
+			continue;
+		side_gather_vla = &field->side_type.u.side_gather.u.side_vla;
+		length_type = side_ptr_get(side_gather_vla->type.length_type);
+		if (side_enum_get(length_type->type) != SIDE_TYPE_GATHER_INTEGER)
+			continue;	/* Reported by description_visitor_gather_vla(). */
+		side_length = &length_type->u.side_gather.u.side_integer;
+		length_end = side_length->offset +
+			(side_enum_get(side_length->access_mode) == SIDE_TYPE_GATHER_ACCESS_POINTER ?
+				sizeof(void *) : side_length->type.integer_size);
+		vla_end = side_gather_vla->offset +
+			(side_enum_get(side_gather_vla->access_mode) == SIDE_TYPE_GATHER_ACCESS_POINTER ?
+				sizeof(void *) : 0);
+		if (length_end > side_gather_struct->size || vla_end > side_gather_struct->size) {
+			fprintf(stderr, "<gather VLA fields exceed the gather structure record size>\n");
+			abort();
+		}
+	}
+}
+
 static
 void description_visitor_gather_array(const struct side_description_visitor *description_visitor, const struct side_type_gather *type_gather, void *priv)
 {
@@ -205,13 +257,7 @@ void description_visitor_gather_array(const struct side_description_visitor *des
 
 	if (description_visitor->before_gather_array_type_func)
 		description_visitor->before_gather_array_type_func(side_gather_array, priv);
-	switch (side_enum_get(elem_type->type)) {
-	case SIDE_TYPE_GATHER_VLA:
-		fprintf(stderr, "<gather VLA only supported within gather structures>\n");
-		abort();
-	default:
-		break;
-	}
+	description_visitor_check_gather_elem(elem_type);
 	visit_gather_elem(description_visitor, elem_type, priv);
 	if (description_visitor->after_gather_array_type_func)
 		description_visitor->after_gather_array_type_func(side_gather_array, priv);
@@ -233,13 +279,7 @@ void description_visitor_gather_vla(const struct side_description_visitor *descr
 		fprintf(stderr, "<gather VLA expects integer gather length type>\n");
 		abort();
 	}
-	switch (side_enum_get(elem_type->type)) {
-	case SIDE_TYPE_GATHER_VLA:
-		fprintf(stderr, "<gather VLA only supported within gather structures>\n");
-		abort();
-	default:
-		break;
-	}
+	description_visitor_check_gather_elem(elem_type);
 	if (description_visitor->before_gather_vla_type_func)
 		description_visitor->before_gather_vla_type_func(side_gather_vla, priv);
 	visit_gather_elem(description_visitor, length_type, priv);
@@ -250,6 +290,26 @@ void description_visitor_gather_vla(const struct side_description_visitor *descr
 		description_visitor->after_element_gather_vla_type_func(side_gather_vla, priv);
 }
 
+static
+void description_visitor_gather_iovec(const struct side_description_visitor *description_visitor, const struct side_type_gather *type_gather, void *priv)
+{
+	const struct side_type_gather_iovec *side_gather_iovec = &type_gather->u.side_iovec;
+	const struct side_type *length_type = side_ptr_get(side_gather_iovec->length_type);
+
+	switch (side_enum_get(length_type->type)) {
+	case SIDE_TYPE_GATHER_INTEGER:
+		break;
+	default:
+		fprintf(stderr, "<gather iovec expects integer gather length type>\n");
+		abort();
+	}
+	if (description_visitor->before_gather_iovec_type_func)
+		description_visitor->before_gather_iovec_type_func(side_gather_iovec, priv);
+	visit_gather_elem(description_visitor, length_type, priv);
+	if (description_visitor->after_gather_iovec_type_func)
+		description_visitor->after_gather_iovec_type_func(side_gather_iovec, priv);
+}
+
 static
 void description_visitor_gather_bool(const struct side_description_visitor *description_visitor, const struct side_type_gather *type_gather, void *priv)
 {
@@ -337,6 +397,9 @@ void visit_gather_type(const struct side_description_visitor *description_visito
 	case SIDE_TYPE_GATHER_VLA:
 		description_visitor_gather_vla(description_visitor, &type_desc->u.side_gather, priv);
 		break;
+	case SIDE_TYPE_GATHER_IOVEC:
+		description_visitor_gather_iovec(description_visitor, &type_desc->u.side_gather, priv);
+		break;
 	default:
 		fprintf(stderr, "<UNKNOWN GATHER TYPE>");
 		abort();
@@ -469,6 +532,9 @@ void side_visit_type(const struct side_description_visitor *description_visitor,
 	case SIDE_TYPE_GATHER_VLA:
 		description_visitor_gather_vla(description_visitor, &type_desc->u.side_gather, priv);
 		break;
+	case SIDE_TYPE_GATHER_IOVEC:
+		description_visitor_gather_iovec(description_visitor, &type_desc->u.side_gather, priv);
+		break;
 
 		/* Gather enumeration types */
 	case SIDE_TYPE_GATHER_ENUM:
@@ -69,6 +69,8 @@ struct side_description_visitor {
 	void (*before_gather_vla_type_func)(const struct side_type_gather_vla *type, void *priv);
 	void (*after_length_gather_vla_type_func)(const struct side_type_gather_vla *type, void *priv);
 	void (*after_element_gather_vla_type_func)(const struct side_type_gather_vla *type, void *priv);
+	void (*before_gather_iovec_type_func)(const struct side_type_gather_iovec *type, void *priv);
+	void (*after_gather_iovec_type_func)(const struct side_type_gather_iovec *type, void *priv);
 
 	/* Gather enumeration types. */
 	void (*before_gather_enum_type_func)(const struct side_type_gather_enum *type, void *priv);
@@ -0,0 +1,432 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+/*
+ * Microbenchmark of the event dispatch path.
+ *
+ * Each case is reported as a TAP test point followed by a diagnostic
+ * line of the form:
+ *
+ *   # bench name=<case> threads=<n> iterations=<n> ns_per_event=<f> cycles_per_event=<f>
+ *
+ * cycles_per_event is "-" on architectures without a cycle counter.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES	1
+#endif
+
+#include <side/trace.h>
+
+#include "bench.h"
+#include "tap.h"
+
+static uint64_t nr_iterations = 1000000;
+static int max_threads = -1;
+static uint64_t tracer_key;
+
+static
+uint64_t now_cycles(void)
+{
+#ifdef HAVE_CYCLES
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+static
+void report(const char *name, int nr_threads, uint64_t nr_events,
+		uint64_t ns, uint64_t cycles)
+{
+	ok(1, "%s threads=%d", name, nr_threads);
+#ifdef HAVE_CYCLES
+	diag("bench name=%s threads=%d iterations=%" PRIu64 " ns_per_event=%.2f cycles_per_event=%.2f",
+		name, nr_threads, nr_events, (double) ns / nr_events,
+		(double) cycles / nr_events);
+#else
+	(void) cycles;
+	diag("bench name=%s threads=%d iterations=%" PRIu64 " ns_per_event=%.2f cycles_per_event=-",
+		name, nr_threads, nr_events, (double) ns / nr_events);
+#endif
+}
+
+static
+void run_bench(const char *name, void (*fct)(uint64_t nr))
+{
+	uint64_t ns, cycles;
+
+	fct(nr_iterations / 10);	/* Warm up. */
+	ns = bench_now_ns();
+	cycles = now_cycles();
+	fct(nr_iterations);
+	cycles = now_cycles() - cycles;
+	ns = bench_now_ns() - ns;
+	report(name, 1, nr_iterations, ns, cycles);
+}
+
+static
+void noop_call(const struct side_event_description *desc __attribute__((unused)),
+		const struct side_arg_vec *side_arg_vec __attribute__((unused)),
+		void *priv __attribute__((unused)),
+		void *caller_addr __attribute__((unused)))
+{
+}
+
+static
+void noop_call_variadic(const struct side_event_description *desc __attribute__((unused)),
+		const struct side_arg_vec *side_arg_vec __attribute__((unused)),
+		const struct side_arg_dynamic_struct *var_struct __attribute__((unused)),
+		void *priv __attribute__((unused)),
+		void *caller_addr __attribute__((unused)))
+{
+}
+
+/*
+ * Field and argument lists appear literally in the macro replacement
+ * text so the static checker can see them.
+ */
+#define DEFINE_BENCH_EVENT(_identifier, _event)				\
+	side_static_event(_identifier, "bench", _event, SIDE_LOGLEVEL_DEBUG, \
+		side_field_list(					\
+			side_field_u32("a"),				\
+			side_field_s64("b"),				\
+			side_field_pointer("c"),			\
+			side_field_bool("d"),				\
+		)							\
+	)
+
+DEFINE_BENCH_EVENT(bench_event_disabled, "disabled");
+DEFINE_BENCH_EVENT(bench_event_cb0, "cb0");
+DEFINE_BENCH_EVENT(bench_event_cb1, "cb1");
+DEFINE_BENCH_EVENT(bench_event_cb4, "cb4");
+DEFINE_BENCH_EVENT(bench_event_cb16, "cb16");
+DEFINE_BENCH_EVENT(bench_event_statedump, "statedump");
+
+side_static_event(bench_event_gather, "bench", "gather", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_gather_unsigned_integer("a", 0, sizeof(uint32_t), 0, 0,
+			SIDE_TYPE_GATHER_ACCESS_DIRECT),
+		side_field_gather_signed_integer("b", 0, sizeof(int64_t), 0, 0,
+			SIDE_TYPE_GATHER_ACCESS_DIRECT),
+		side_field_gather_unsigned_integer("c", 0, sizeof(uint64_t), 0, 0,
+			SIDE_TYPE_GATHER_ACCESS_DIRECT),
+		side_field_gather_bool("d", 0, sizeof(uint8_t), 0, 0,
+			SIDE_TYPE_GATHER_ACCESS_DIRECT),
+	)
+);
+
+side_static_event(bench_event_dynamic, "bench", "dynamic", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_dynamic("a"),
+		side_field_dynamic("b"),
+		side_field_dynamic("c"),
+		side_field_dynamic("d"),
+	)
+);
+
+side_static_event_variadic(bench_event_variadic, "bench", "variadic", SIDE_LOGLEVEL_DEBUG,
+	side_field_list()
+);
+
+/* Stack-copied arguments, enabled.cb1 is the baseline of the args cases. */
+#define DEFINE_BENCH_STACK(_identifier)					\
+static									\
+void bench_##_identifier(uint64_t nr)					\
+{									\
+	uint64_t i;							\
+									\
+	for (i = 0; i < nr; i++) {					\
+		side_event(_identifier,					\
+			side_arg_list(					\
+				side_arg_u32((uint32_t) i),		\
+				side_arg_s64(-(int64_t) i),		\
+				side_arg_pointer((void *) (uintptr_t) i), \
+				side_arg_bool(i & 1),			\
+			)						\
+		);							\
+	}								\
+}
+
+DEFINE_BENCH_STACK(bench_event_disabled)
+DEFINE_BENCH_STACK(bench_event_cb1)
+DEFINE_BENCH_STACK(bench_event_cb4)
+DEFINE_BENCH_STACK(bench_event_cb16)
+
+/* Dispatch without the enabled state check, with an empty callback list. */
+static
+void bench_bench_event_cb0(uint64_t nr)
+{
+	uint64_t i;
+
+	for (i = 0; i < nr; i++) {
+		side_event_call(bench_event_cb0,
+			side_arg_list(
+				side_arg_u32((uint32_t) i),
+				side_arg_s64(-(int64_t) i),
+				side_arg_pointer((void *) (uintptr_t) i),
+				side_arg_bool(i & 1),
+			)
+		);
+	}
+}
+
+static
+void bench_bench_event_gather(uint64_t nr)
+{
+	uint64_t i;
+
+	for (i = 0; i < nr; i++) {
+		uint32_t a = (uint32_t) i;
+		int64_t b = -(int64_t) i;
+		uint64_t c = i;
+		uint8_t d = i & 1;
+
+		side_event(bench_event_gather,
+			side_arg_list(
+				side_arg_gather_integer(&a),
+				side_arg_gather_integer(&b),
+				side_arg_gather_integer(&c),
+				side_arg_gather_bool(&d),
+			)
+		);
+	}
+}
+
+static
+void bench_bench_event_dynamic(uint64_t nr)
+{
+	uint64_t i;
+
+	for (i = 0; i < nr; i++) {
+		side_event(bench_event_dynamic,
+			side_arg_list(
+				side_arg_dynamic_u32((uint32_t) i),
+				side_arg_dynamic_s64(-(int64_t) i),
+				side_arg_dynamic_pointer((void *) (uintptr_t) i),
+				side_arg_dynamic_bool(i & 1),
+			)
+		);
+	}
+}
+
+static
+void bench_bench_event_variadic(uint64_t nr)
+{
+	uint64_t i;
+
+	for (i = 0; i < nr; i++) {
+		side_event_variadic(bench_event_variadic,
+			side_arg_list(),
+			side_arg_list(
+				side_arg_dynamic_field("a", side_arg_dynamic_u32((uint32_t) i)),
+				side_arg_dynamic_field("b", side_arg_dynamic_s64(-(int64_t) i)),
+				side_arg_dynamic_field("c", side_arg_dynamic_pointer((void *) (uintptr_t) i)),
+				side_arg_dynamic_field("d", side_arg_dynamic_bool(i & 1)),
+			)
+		);
+	}
+}
+
+static
+void bench_bench_event_statedump(uint64_t nr)
+{
+	uint64_t i;
+
+	for (i = 0; i < nr; i++) {
+		if (side_event_enabled(bench_event_statedump)) {
+			side_statedump_event_call(bench_event_statedump, &tracer_key,
+				side_arg_list(
+					side_arg_u32((uint32_t) i),
+					side_arg_s64(-(int64_t) i),
+					side_arg_pointer((void *) (uintptr_t) i),
+					side_arg_bool(i & 1),
+				)
+			);
+		}
+	}
+}
+
+static
+void register_callbacks(struct side_event_description *desc, int nr_callbacks)
+{
+	int i;
+
+	for (i = 0; i < nr_callbacks; i++) {
+		if (side_tracer_callback_register(desc, noop_call,
+				(void *) (uintptr_t) (i + 1), tracer_key))
+			abort();
+	}
+}
+
+static
+void unregister_callbacks(struct side_event_description *desc, int nr_callbacks)
+{
+	int i;
+
+	for (i = 0; i < nr_callbacks; i++) {
+		if (side_tracer_callback_unregister(desc, noop_call,
+				(void *) (uintptr_t) (i + 1), tracer_key))
+			abort();
+	}
+}
+
+struct thread_ctx {
+	pthread_t thread_id;
+	int cpu;
+	uint64_t ns;
+};
+
+static pthread_barrier_t thread_barrier;
+
+static
+void *bench_thread(void *arg)
+{
+	struct thread_ctx *thread_ctx = (struct thread_ctx *) arg;
+	cpu_set_t set;
+	uint64_t ns;
+
+	CPU_ZERO(&set);
+	CPU_SET(thread_ctx->cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		abort();
+	bench_bench_event_cb1(nr_iterations / 10);	/* Warm up. */
+	pthread_barrier_wait(&thread_barrier);
+	ns = bench_now_ns();
+	bench_bench_event_cb1(nr_iterations);
+	thread_ctx->ns = bench_now_ns() - ns;
+	return NULL;
+}
+
+/*
+ * Each thread is pinned to a distinct CPU and emits nr_iterations
+ * events. The reported cost is the mean per-thread cost of an event.
+ */
+static
+void run_bench_threads(const int *cpus, int nr_threads)
+{
+	struct thread_ctx *thread_ctx;
+	uint64_t ns = 0, cycles;
+	int i, ret;
+
+	thread_ctx = calloc(nr_threads, sizeof(struct thread_ctx));
+	if (!thread_ctx)
+		abort();
+	if (pthread_barrier_init(&thread_barrier, NULL, nr_threads + 1))
+		abort();
+	for (i = 0; i < nr_threads; i++) {
+		thread_ctx[i].cpu = cpus[i];
+		ret = pthread_create(&thread_ctx[i].thread_id, NULL, bench_thread, &thread_ctx[i]);
+		if (ret) {
+			errno = ret;
+			perror("pthread_create");
+			abort();
+		}
+	}
+	pthread_barrier_wait(&thread_barrier);
+	cycles = now_cycles();
+	for (i = 0; i < nr_threads; i++) {
+		ret = pthread_join(thread_ctx[i].thread_id, NULL);
+		if (ret) {
+			errno = ret;
+			perror("pthread_join");
+			abort();
+		}
+		ns += thread_ctx[i].ns;
+	}
+	cycles = now_cycles() - cycles;
+	pthread_barrier_destroy(&thread_barrier);
+	free(thread_ctx);
+	/* Cycles are measured on the wall clock of the slowest thread. */
+	report("threads.cb1", nr_threads, nr_iterations, ns / nr_threads, cycles);
+}
+
+static
+void run_bench_scaling(void)
+{
+	cpu_set_t set;
+	int *cpus, nr_cpus = 0, cpu, nr_threads;
+
+	if (sched_getaffinity(0, sizeof(set), &set))
+		abort();
+	cpus = calloc(CPU_SETSIZE, sizeof(int));
+	if (!cpus)
+		abort();
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &set))
+			cpus[nr_cpus++] = cpu;
+	}
+	if (max_threads > 0 && max_threads < nr_cpus)
+		nr_cpus = max_threads;
+	for (nr_threads = 1; nr_threads < nr_cpus; nr_threads <<= 1)
+		run_bench_threads(cpus, nr_threads);
+	run_bench_threads(cpus, nr_cpus);
+	free(cpus);
+}
+
+static const struct bench_option options[] = {
+	{ 'n', BENCH_OPTION_U64, &nr_iterations, "<iterations> (number of events per case and per thread)" },
+	{ 't', BENCH_OPTION_INT, &max_threads, "<nr_threads> (maximum number of threads, default: number of CPUs)" },
+};
+
+int main(int argc, const char **argv)
+{
+	int ret;
+
+	bench_disable_demo_tracer(argv);
+	ret = bench_parse_cmd_line(argc, argv, options, SIDE_ARRAY_SIZE(options));
+	if (ret < 0)
+		return -1;
+	if (ret > 0)
+		return 0;
+	if (!nr_iterations) {
+		fprintf(stderr, "Invalid command line arguments\n");
+		return -1;
+	}
+
+	plan_no_plan();
+	if (side_tracer_request_key(&tracer_key))
+		abort();
+	register_callbacks(&bench_event_cb1, 1);
+	register_callbacks(&bench_event_cb4, 4);
+	register_callbacks(&bench_event_cb16, 16);
+	register_callbacks(&bench_event_gather, 1);
+	register_callbacks(&bench_event_dynamic, 1);
+	register_callbacks(&bench_event_statedump, 1);
+	if (side_tracer_callback_variadic_register(&bench_event_variadic,
+			noop_call_variadic, NULL, tracer_key))
+		abort();
+
+	run_bench("disabled", bench_bench_event_disabled);
+	run_bench("enabled.cb0", bench_bench_event_cb0);
+	run_bench("enabled.cb1", bench_bench_event_cb1);
+	run_bench("enabled.cb4", bench_bench_event_cb4);
+	run_bench("enabled.cb16", bench_bench_event_cb16);
+	run_bench("args.gather", bench_bench_event_gather);
+	run_bench("args.dynamic", bench_bench_event_dynamic);
+	run_bench("args.variadic", bench_bench_event_variadic);
+	run_bench("statedump", bench_bench_event_statedump);
+	run_bench_scaling();
+
+	if (side_tracer_callback_variadic_unregister(&bench_event_variadic,
+			noop_call_variadic, NULL, tracer_key))
+		abort();
+	unregister_callbacks(&bench_event_statedump, 1);
+	unregister_callbacks(&bench_event_dynamic, 1);
+	unregister_callbacks(&bench_event_gather, 1);
+	unregister_callbacks(&bench_event_cb16, 16);
+	unregister_callbacks(&bench_event_cb4, 4);
+	unregister_callbacks(&bench_event_cb1, 1);
+	return exit_status();
+}
@@ -0,0 +1,391 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+/*
+ * False sharing benchmark of the event enabled words.
+ *
+ * Reader threads, each pinned to a distinct CPU, check the enabled word
+ * of their own disabled event in a loop, while a writer thread updates
+ * the registration state of other events. The "layout" cases emulate
+ * the enabled words being packed with the registration state of the
+ * events (packed) or kept in a separate dense region (dense). The
+ * "side" cases use libside events, with the writer registering and
+ * unregistering a tracer callback on an event which is already enabled.
+ *
+ * Each case is reported as a TAP test point followed by a diagnostic
+ * line of the form:
+ *
+ *   # bench name=<case> readers=<n> iterations=<n> ns_per_check=<f> writer_ops=<n>
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <side/trace.h>
+
+#include "bench.h"
+#include "tap.h"
+
+#define CACHE_LINE_SIZE		64
+#define MAX_READERS		8
+
+static uint64_t nr_iterations = 100000000;
+static int max_readers = -1;
+static uint64_t tracer_key;
+
+/* Emulation of the event state with the enabled word packed in. */
+struct packed_state {
+	uint32_t version;
+	uint32_t nr_callbacks;
+	uintptr_t enabled;
+	const void *callbacks;
+	void *desc;
+};
+
+/* Emulation of the event state with the enabled word apart. */
+struct dense_state {
+	uint32_t version;
+	uint32_t nr_callbacks;
+	uintptr_t *enabled;
+	const void *callbacks;
+	void *desc;
+};
+
+/* Readers use even entries, the writer updates odd entries. */
+static struct packed_state packed_states[2 * MAX_READERS] __attribute__((aligned(CACHE_LINE_SIZE)));
+static struct dense_state dense_states[2 * MAX_READERS] __attribute__((aligned(CACHE_LINE_SIZE)));
+static uintptr_t dense_enabled[2 * MAX_READERS] __attribute__((aligned(CACHE_LINE_SIZE)));
+
+#define DEFINE_BENCH_EVENT(_identifier, _event)				\
+	side_static_event(_identifier, "bench", _event, SIDE_LOGLEVEL_DEBUG, \
+		side_field_list(					\
+			side_field_u64("a"),				\
+		)							\
+	)
+
+#define DEFINE_HOT_EVENT(_identifier, _event)				\
+	DEFINE_BENCH_EVENT(_identifier, _event);			\
+									\
+	static								\
+	void bench_##_identifier(uint64_t nr)				\
+	{								\
+		uint64_t i;						\
+									\
+		for (i = 0; i < nr; i++)				\
+			side_event(_identifier, side_arg_list(side_arg_u64(i))); \
+	}
+
+/*
+ * Hot events are disabled, and interleaved with cold events, which
+ * are enabled, so their states are adjacent in the side_event_state
+ * section.
+ */
+DEFINE_HOT_EVENT(bench_event_hot0, "hot0")
+DEFINE_BENCH_EVENT(bench_event_cold0, "cold0");
+DEFINE_HOT_EVENT(bench_event_hot1, "hot1")
+DEFINE_BENCH_EVENT(bench_event_cold1, "cold1");
+DEFINE_HOT_EVENT(bench_event_hot2, "hot2")
+DEFINE_BENCH_EVENT(bench_event_cold2, "cold2");
+DEFINE_HOT_EVENT(bench_event_hot3, "hot3")
+DEFINE_BENCH_EVENT(bench_event_cold3, "cold3");
+DEFINE_HOT_EVENT(bench_event_hot4, "hot4")
+DEFINE_BENCH_EVENT(bench_event_cold4, "cold4");
+DEFINE_HOT_EVENT(bench_event_hot5, "hot5")
+DEFINE_BENCH_EVENT(bench_event_cold5, "cold5");
+DEFINE_HOT_EVENT(bench_event_hot6, "hot6")
+DEFINE_BENCH_EVENT(bench_event_cold6, "cold6");
+DEFINE_HOT_EVENT(bench_event_hot7, "hot7")
+DEFINE_BENCH_EVENT(bench_event_cold7, "cold7");
+
+static void (*bench_hot[MAX_READERS])(uint64_t nr) = {
+	bench_bench_event_hot0, bench_bench_event_hot1,
+	bench_bench_event_hot2, bench_bench_event_hot3,
+	bench_bench_event_hot4, bench_bench_event_hot5,
+	bench_bench_event_hot6, bench_bench_event_hot7,
+};
+
+static struct side_event_description *bench_cold[MAX_READERS] = {
+	&bench_event_cold0, &bench_event_cold1,
+	&bench_event_cold2, &bench_event_cold3,
+	&bench_event_cold4, &bench_event_cold5,
+	&bench_event_cold6, &bench_event_cold7,
+};
+
+enum bench_mode {
+	BENCH_MODE_PACKED,
+	BENCH_MODE_DENSE,
+	BENCH_MODE_SIDE,
+};
+
+static
+void noop_call(const struct side_event_description *desc __attribute__((unused)),
+		const struct side_arg_vec *side_arg_vec __attribute__((unused)),
+		void *priv __attribute__((unused)),
+		void *caller_addr __attribute__((unused)))
+{
+}
+
+static
+void read_enabled(uintptr_t *enabled, uint64_t nr)
+{
+	uint64_t i;
+
+	for (i = 0; i < nr; i++) {
+		if (__atomic_load_n(enabled, __ATOMIC_RELAXED))
+			abort();
+	}
+}
+
+struct reader_ctx {
+	pthread_t thread_id;
+	enum bench_mode mode;
+	int index;
+	int cpu;
+	uint64_t ns;
+};
+
+struct writer_ctx {
+	pthread_t thread_id;
+	enum bench_mode mode;
+	int nr_readers;
+	int cpu;
+	uint64_t nr_ops;
+};
+
+static pthread_barrier_t thread_barrier;
+static bool writer_stop;
+
+static
+void pin_thread(int cpu)
+{
+	cpu_set_t set;
+
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+		abort();
+}
+
+static
+void reader_run(struct reader_ctx *reader_ctx, uint64_t nr)
+{
+	switch (reader_ctx->mode) {
+	case BENCH_MODE_PACKED:
+		read_enabled(&packed_states[2 * reader_ctx->index].enabled, nr);
+		break;
+	case BENCH_MODE_DENSE:
+		read_enabled(dense_states[2 * reader_ctx->index].enabled, nr);
+		break;
+	case BENCH_MODE_SIDE:
+		bench_hot[reader_ctx->index](nr);
+		break;
+	}
+}
+
+static
+void *reader_thread(void *arg)
+{
+	struct reader_ctx *reader_ctx = (struct reader_ctx *) arg;
+	uint64_t ns;
+
+	pin_thread(reader_ctx->cpu);
+	reader_run(reader_ctx, nr_iterations / 10);	/* Warm up. */
+	pthread_barrier_wait(&thread_barrier);
+	ns = bench_now_ns();
+	reader_run(reader_ctx, nr_iterations);
+	reader_ctx->ns = bench_now_ns() - ns;
+	return NULL;
+}
+
+static
+void writer_op(struct writer_ctx *writer_ctx, uint64_t op)
+{
+	int index = op % writer_ctx->nr_readers;
+
+	switch (writer_ctx->mode) {
+	case BENCH_MODE_PACKED:
+	{
+		struct packed_state *state = &packed_states[2 * index + 1];
+
+		__atomic_store_n(&state->nr_callbacks, (uint32_t) op, __ATOMIC_RELAXED);
+		__atomic_store_n(&state->callbacks, (const void *) (uintptr_t) op, __ATOMIC_RELEASE);
+		break;
+	}
+	case BENCH_MODE_DENSE:
+	{
+		struct dense_state *state = &dense_states[2 * index + 1];
+
+		__atomic_store_n(&state->nr_callbacks, (uint32_t) op, __ATOMIC_RELAXED);
+		__atomic_store_n(&state->callbacks, (const void *) (uintptr_t) op, __ATOMIC_RELEASE);
+		break;
+	}
+	case BENCH_MODE_SIDE:
+		if (side_tracer_callback_register(bench_cold[index], noop_call,
+				(void *) (uintptr_t) 2, tracer_key))
+			abort();
+		if (side_tracer_callback_unregister(bench_cold[index], noop_call,
+				(void *) (uintptr_t) 2, tracer_key))
+			abort();
+		break;
+	}
+}
+
+static
+void *writer_thread(void *arg)
+{
+	struct writer_ctx *writer_ctx = (struct writer_ctx *) arg;
+	uint64_t op = 0;
+
+	pin_thread(writer_ctx->cpu);
+	pthread_barrier_wait(&thread_barrier);
+	while (!__atomic_load_n(&writer_stop, __ATOMIC_RELAXED))
+		writer_op(writer_ctx, op++);
+	writer_ctx->nr_ops = op;
+	return NULL;
+}
+
+static
+void thread_create(pthread_t *thread_id, void *(*fct)(void *), void *arg)
+{
+	int ret;
+
+	ret = pthread_create(thread_id, NULL, fct, arg);
+	if (ret) {
+		errno = ret;
+		perror("pthread_create");
+		abort();
+	}
+}
+
+static
+void thread_join(pthread_t thread_id)
+{
+	int ret;
+
+	ret = pthread_join(thread_id, NULL);
+	if (ret) {
+		errno = ret;
+		perror("pthread_join");
+		abort();
+	}
+}
+
+/*
+ * The first nr_readers CPUs run readers, the last CPU runs the writer.
+ * The reported cost is the mean per-reader cost of an enabled check.
+ */
+static
+void run_bench(const char *name, enum bench_mode mode, bool writer,
+		const int *cpus, int nr_readers)
+{
+	struct reader_ctx reader_ctx[MAX_READERS];
+	struct writer_ctx writer_ctx = {
+		.mode = mode,
+		.nr_readers = nr_readers,
+		.cpu = cpus[nr_readers],
+	};
+	uint64_t ns = 0;
+	int i;
+
+	if (pthread_barrier_init(&thread_barrier, NULL, nr_readers + 1 + writer))
+		abort();
+	writer_stop = false;
+	if (writer)
+		thread_create(&writer_ctx.thread_id, writer_thread, &writer_ctx);
+	for (i = 0; i < nr_readers; i++) {
+		reader_ctx[i].mode = mode;
+		reader_ctx[i].index = i;
+		reader_ctx[i].cpu = cpus[i];
+		thread_create(&reader_ctx[i].thread_id, reader_thread, &reader_ctx[i]);
+	}
+	pthread_barrier_wait(&thread_barrier);
+	for (i = 0; i < nr_readers; i++) {
+		thread_join(reader_ctx[i].thread_id);
+		ns += reader_ctx[i].ns;
+	}
+	__atomic_store_n(&writer_stop, true, __ATOMIC_RELAXED);
+	if (writer)
+		thread_join(writer_ctx.thread_id);
+	pthread_barrier_destroy(&thread_barrier);
+
+	ok(1, "%s readers=%d", name, nr_readers);
+	diag("bench name=%s readers=%d iterations=%" PRIu64 " ns_per_check=%.3f writer_ops=%" PRIu64,
+		name, nr_readers, nr_iterations,
+		(double) ns / nr_readers / nr_iterations, writer_ctx.nr_ops);
+}
+
+static
+void layout_init(void)
+{
+	int i;
+
+	for (i = 0; i < 2 * MAX_READERS; i++)
+		dense_states[i].enabled = &dense_enabled[i];
+}
+
+static const struct bench_option options[] = {
+	{ 'n', BENCH_OPTION_U64, &nr_iterations, "<iterations> (number of enabled checks per reader and per case)" },
+	{ 't', BENCH_OPTION_INT, &max_readers,
+		"<nr_readers> (maximum number of reader threads, default: number of CPUs - 1, at most "
+		SIDE_STR(MAX_READERS) ")" },
+};
+
+int main(int argc, const char **argv)
+{
+	int cpus[MAX_READERS + 1], nr_cpus = 0, cpu, nr_readers, i, ret;
+	cpu_set_t set;
+
+	bench_disable_demo_tracer(argv);
+	ret = bench_parse_cmd_line(argc, argv, options, SIDE_ARRAY_SIZE(options));
+	if (ret < 0)
+		return -1;
+	if (ret > 0)
+		return 0;
+	if (!nr_iterations || !max_readers) {
+		fprintf(stderr, "Invalid command line arguments\n");
+		return -1;
+	}
+
+	if (sched_getaffinity(0, sizeof(set), &set))
+		abort();
+	for (cpu = 0; cpu < CPU_SETSIZE && nr_cpus < MAX_READERS + 1; cpu++) {
+		if (CPU_ISSET(cpu, &set))
+			cpus[nr_cpus++] = cpu;
+	}
+	if (nr_cpus < 2)
+		plan_skip_all("At least 2 CPUs are required");
+	nr_readers = nr_cpus - 1;
+	if (max_readers > 0 && max_readers < nr_readers)
+		nr_readers = max_readers;
+	plan_no_plan();
+	if (side_tracer_request_key(&tracer_key))
+		abort();
+	layout_init();
+	for (i = 0; i < MAX_READERS; i++) {
+		if (side_tracer_callback_register(bench_cold[i], noop_call,
+				(void *) (uintptr_t) 1, tracer_key))
+			abort();
+	}
+
+	run_bench("layout.packed.idle", BENCH_MODE_PACKED, false, cpus, nr_readers);
+	run_bench("layout.packed.writer", BENCH_MODE_PACKED, true, cpus, nr_readers);
+	run_bench("layout.dense.idle", BENCH_MODE_DENSE, false, cpus, nr_readers);
+	run_bench("layout.dense.writer", BENCH_MODE_DENSE, true, cpus, nr_readers);
+	run_bench("side.idle", BENCH_MODE_SIDE, false, cpus, nr_readers);
+	run_bench("side.registration", BENCH_MODE_SIDE, true, cpus, nr_readers);
+
+	for (i = 0; i < MAX_READERS; i++) {
+		if (side_tracer_callback_unregister(bench_cold[i], noop_call,
+				(void *) (uintptr_t) 1, tracer_key))
+			abort();
+	}
+	return exit_status();
+}
@@ -0,0 +1,332 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+/*
+ * Benchmark of the libside RCU read-side critical sections and grace
+ * periods.
+ *
+ * Each case runs reader threads in a loop of side_rcu_read_begin() and
+ * side_rcu_read_end(), concurrently with writer threads replacing an
+ * RCU-protected pointer and waiting for grace periods. Cases cover
+ * reader counts (powers of two up to the number of CPUs), writer
+ * counts, and threads pinned to distinct CPUs or not.
+ *
+ * Results are printed as CSV, one line per case:
+ *
+ *   path,readers,writers,pinned,duration_ms,reads,read_ns,
+ *   read_p50_ns,read_p99_ns,read_p999_ns,grace_periods,gp_p50_ns,
+ *   gp_p99_ns,gp_p999_ns,gp_max_ns
+ *
+ * "path" is "rseq" when the rseq and membarrier read-side fast-path is
+ * used, and "fallback" otherwise. Set SIDE_RCU_FALLBACK in the
+ * environment to force the fallback. Read-side percentiles are
+ * computed on the mean cost of batches of READ_BATCH critical sections.
+ */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../src/compiler.h"
+#include "../../src/rcu.h"
+
+#include "bench.h"
+
+#define READ_BATCH		256
+#define MAX_SAMPLES		(1UL << 20)
+
+static int duration_ms = 500;
+static int max_readers = -1;
+static int max_writers = 2;
+
+static struct side_rcu_gp_state bench_rcu_gp;
+
+struct bench_data {
+	int v;
+};
+
+static struct bench_data *rcu_p;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static bool start_bench, stop_bench;
+
+struct samples {
+	uint64_t *v;
+	size_t nr;
+};
+
+struct thread_ctx {
+	pthread_t thread_id;
+	int cpu;		/* -1: not pinned. */
+	uint64_t count;
+	struct samples samples;
+};
+
+static
+void samples_add(struct samples *samples, uint64_t v)
+{
+	if (samples->nr < MAX_SAMPLES)
+		samples->v[samples->nr++] = v;
+}
+
+static
+int compare_u64(const void *a, const void *b)
+{
+	uint64_t va = *(const uint64_t *) a, vb = *(const uint64_t *) b;
+
+	if (va == vb)
+		return 0;
+	return va < vb ? -1 : 1;
+}
+
+/* samples must be sorted. */
+static
+uint64_t percentile(const struct samples *samples, unsigned int per_mille)
+{
+	size_t idx;
+
+	if (!samples->nr)
+		return 0;
+	idx = (samples->nr * per_mille) / 1000;
+	if (idx >= samples->nr)
+		idx = samples->nr - 1;
+	return samples->v[idx];
+}
+
+static
+void thread_init(struct thread_ctx *thread_ctx)
+{
+	if (thread_ctx->cpu >= 0) {
+		cpu_set_t set;
+
+		CPU_ZERO(&set);
+		CPU_SET(thread_ctx->cpu, &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set))
+			abort();
+	}
+	while (!__atomic_load_n(&start_bench, __ATOMIC_ACQUIRE))
+		side_cpu_relax();
+}
+
+static
+void *reader_thread(void *arg)
+{
+	struct thread_ctx *thread_ctx = (struct thread_ctx *) arg;
+	uint64_t count = 0;
+
+	thread_init(thread_ctx);
+	while (!__atomic_load_n(&stop_bench, __ATOMIC_RELAXED)) {
+		uint64_t ns = bench_now_ns();
+		int i;
+
+		for (i = 0; i < READ_BATCH; i++) {
+			struct side_rcu_read_state rcu_read_state;
+			struct bench_data *p;
+
+			side_rcu_read_begin(&bench_rcu_gp, &rcu_read_state);
+			p = side_rcu_dereference(rcu_p);
+			if (p && p->v != 0 && p->v != 1)
+				abort();
+			side_rcu_read_end(&bench_rcu_gp, &rcu_read_state);
+		}
+		samples_add(&thread_ctx->samples, (bench_now_ns() - ns) / READ_BATCH);
+		count += READ_BATCH;
+	}
+	thread_ctx->count = count;
+	return NULL;
+}
+
+static
+void *writer_thread(void *arg)
+{
+	struct thread_ctx *thread_ctx = (struct thread_ctx *) arg;
+	uint64_t count = 0;
+
+	thread_init(thread_ctx);
+	while (!__atomic_load_n(&stop_bench, __ATOMIC_RELAXED)) {
+		struct bench_data *new_data, *old_data;
+		uint64_t ns;
+
+		new_data = calloc(1, sizeof(struct bench_data));
+		if (!new_data)
+			abort();
+		pthread_mutex_lock(&lock);
+		old_data = rcu_p;
+		if (old_data)
+			new_data->v = old_data->v ^ 1;
+		side_rcu_assign_pointer(rcu_p, new_data);
+		pthread_mutex_unlock(&lock);
+
+		ns = bench_now_ns();
+		side_rcu_wait_grace_period(&bench_rcu_gp);
+		samples_add(&thread_ctx->samples, bench_now_ns() - ns);
+
+		free(old_data);
+		count++;
+	}
+	thread_ctx->count = count;
+	return NULL;
+}
+
+static
+void threads_create(struct thread_ctx *thread_ctx, int nr, void *(*fct)(void *))
+{
+	int i, ret;
+
+	for (i = 0; i < nr; i++) {
+		thread_ctx[i].samples.v = calloc(MAX_SAMPLES, sizeof(uint64_t));
+		if (!thread_ctx[i].samples.v)
+			abort();
+		ret = pthread_create(&thread_ctx[i].thread_id, NULL, fct, &thread_ctx[i]);
+		if (ret) {
+			errno = ret;
+			perror("pthread_create");
+			abort();
+		}
+	}
+}
+
+/* Join threads and merge their samples. */
+static
+uint64_t threads_join(struct thread_ctx *thread_ctx, int nr, struct samples *samples)
+{
+	uint64_t count = 0;
+	int i, ret;
+
+	for (i = 0; i < nr; i++) {
+		size_t j;
+
+		ret = pthread_join(thread_ctx[i].thread_id, NULL);
+		if (ret) {
+			errno = ret;
+			perror("pthread_join");
+			abort();
+		}
+		count += thread_ctx[i].count;
+		for (j = 0; j < thread_ctx[i].samples.nr; j++)
+			samples_add(samples, thread_ctx[i].samples.v[j]);
+		free(thread_ctx[i].samples.v);
+	}
+	qsort(samples->v, samples->nr, sizeof(uint64_t), compare_u64);
+	return count;
+}
+
+static
+void run_bench(const int *cpus, int nr_cpus, int nr_readers, int nr_writers, bool pinned)
+{
+	struct thread_ctx *reader_ctx, *writer_ctx;
+	struct samples read_samples = {}, gp_samples = {};
+	uint64_t nr_reads, nr_gps, read_ns = 0;
+	size_t j;
+	struct timespec delay = {
+		.tv_sec = duration_ms / 1000,
+		.tv_nsec = (long) (duration_ms % 1000) * 1000000L,
+	};
+	int i;
+
+	reader_ctx = calloc(nr_readers, sizeof(struct thread_ctx));
+	writer_ctx = calloc(nr_writers ? nr_writers : 1, sizeof(struct thread_ctx));
+	read_samples.v = calloc(MAX_SAMPLES, sizeof(uint64_t));
+	gp_samples.v = calloc(MAX_SAMPLES, sizeof(uint64_t));
+	if (!reader_ctx || !writer_ctx || !read_samples.v || !gp_samples.v)
+		abort();
+	/* Readers on the first CPUs, writers on the following ones. */
+	for (i = 0; i < nr_readers; i++)
+		reader_ctx[i].cpu = pinned ? cpus[i % nr_cpus] : -1;
+	for (i = 0; i < nr_writers; i++)
+		writer_ctx[i].cpu = pinned ? cpus[(nr_readers + i) % nr_cpus] : -1;
+
+	side_rcu_gp_init(&bench_rcu_gp);
+	start_bench = false;
+	stop_bench = false;
+	threads_create(reader_ctx, nr_readers, reader_thread);
+	threads_create(writer_ctx, nr_writers, writer_thread);
+	__atomic_store_n(&start_bench, true, __ATOMIC_RELEASE);
+	while (nanosleep(&delay, &delay) && errno == EINTR) { }
+	__atomic_store_n(&stop_bench, true, __ATOMIC_RELAXED);
+	nr_reads = threads_join(reader_ctx, nr_readers, &read_samples);
+	nr_gps = threads_join(writer_ctx, nr_writers, &gp_samples);
+	for (j = 0; j < read_samples.nr; j++)
+		read_ns += read_samples.v[j];
+
+	printf("%s,%d,%d,%d,%d,%" PRIu64 ",%.2f,%" PRIu64 ",%" PRIu64 ",%" PRIu64
+		",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+		side_rcu_rseq_membarrier_available ? "rseq" : "fallback",
+		nr_readers, nr_writers, pinned, duration_ms, nr_reads,
+		read_samples.nr ? (double) read_ns / read_samples.nr : 0.0,
+		percentile(&read_samples, 500), percentile(&read_samples, 990),
+		percentile(&read_samples, 999),
+		nr_gps,
+		percentile(&gp_samples, 500), percentile(&gp_samples, 990),
+		percentile(&gp_samples, 999),
+		gp_samples.nr ? gp_samples.v[gp_samples.nr - 1] : 0);
+	fflush(stdout);
+
+	side_rcu_gp_exit(&bench_rcu_gp);
+	free(rcu_p);
+	rcu_p = NULL;
+	free(gp_samples.v);
+	free(read_samples.v);
+	free(writer_ctx);
+	free(reader_ctx);
+}
+
+static const struct bench_option options[] = {
+	{ 'd', BENCH_OPTION_INT, &duration_ms, "<milliseconds> (duration of each case)" },
+	{ 'r', BENCH_OPTION_INT, &max_readers, "<nr_readers> (maximum number of reader threads, default: number of CPUs)" },
+	{ 'w', BENCH_OPTION_INT, &max_writers, "<nr_writers> (maximum number of writer threads, default: 2)" },
+};
+
+int main(int argc, const char **argv)
+{
+	int *cpus, nr_cpus = 0, cpu, nr_readers, nr_writers, ret;
+	cpu_set_t set;
+
+	ret = bench_parse_cmd_line(argc, argv, options, SIDE_ARRAY_SIZE(options));
+	if (ret < 0)
+		return -1;
+	if (ret > 0) {
+		printf("Set SIDE_RCU_FALLBACK in the environment to force the read-side fallback path.\n");
+		return 0;
+	}
+	if (duration_ms <= 0 || !max_readers || max_writers < 0) {
+		fprintf(stderr, "Invalid command line arguments\n");
+		return -1;
+	}
+
+	if (sched_getaffinity(0, sizeof(set), &set))
+		abort();
+	cpus = calloc(CPU_SETSIZE, sizeof(int));
+	if (!cpus)
+		abort();
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &set))
+			cpus[nr_cpus++] = cpu;
+	}
+	if (max_readers < 0)
+		max_readers = nr_cpus;
+
+	printf("path,readers,writers,pinned,duration_ms,reads,read_ns,"
+		"read_p50_ns,read_p99_ns,read_p999_ns,grace_periods,gp_p50_ns,"
+		"gp_p99_ns,gp_p999_ns,gp_max_ns\n");
+	for (nr_readers = 1;; nr_readers <<= 1) {
+		if (nr_readers > max_readers)
+			nr_readers = max_readers;
+		for (nr_writers = 0; nr_writers <= max_writers; nr_writers++) {
+			run_bench(cpus, nr_cpus, nr_readers, nr_writers, false);
+			run_bench(cpus, nr_cpus, nr_readers, nr_writers, true);
+		}
+		if (nr_readers == max_readers)
+			break;
+	}
+	free(cpus);
+	return 0;
+}
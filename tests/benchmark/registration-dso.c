@@ -0,0 +1,29 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+/*
+ * Instrumented shared object loaded and unloaded by the registration
+ * benchmark. Its events are registered by the side constructor on
+ * dlopen() and unregistered by the side destructor on dlclose().
+ */
+
+#include <side/trace.h>
+
+#define DEFINE_DSO_EVENT(_identifier, _event)				\
+	side_static_event(_identifier, "bench_dso", _event, SIDE_LOGLEVEL_DEBUG, \
+		side_field_list(					\
+			side_field_u32("a"),				\
+			side_field_s64("b"),				\
+		)							\
+	)
+
+DEFINE_DSO_EVENT(dso_event_0, "event_0");
+DEFINE_DSO_EVENT(dso_event_1, "event_1");
+DEFINE_DSO_EVENT(dso_event_2, "event_2");
+DEFINE_DSO_EVENT(dso_event_3, "event_3");
+DEFINE_DSO_EVENT(dso_event_4, "event_4");
+DEFINE_DSO_EVENT(dso_event_5, "event_5");
+DEFINE_DSO_EVENT(dso_event_6, "event_6");
+DEFINE_DSO_EVENT(dso_event_7, "event_7");
@@ -0,0 +1,393 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+/*
+ * Benchmark of event registration, tracer callback attach/detach, and
+ * instrumented shared object load/unload, while reader threads emit
+ * events at full rate.
+ *
+ * Each phase is reported as a TAP test point followed by a diagnostic
+ * line of the form:
+ *
+ *   # bench name=<phase> events=<n> tracers=<n> wall_ms=<f> grace_periods=<n> membarrier=<n> emit_samples=<n> emit_p99_ns=<n>
+ *
+ * emit_p99_ns is the 99th percentile of the emit_samples reader threads
+ * event emission latencies during the phase, "-" without samples.
+ */
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <side/trace.h>
+
+#include "bench.h"
+#include "tap.h"
+
+#define MAX_TRACERS		8
+#define NR_LATENCY_SAMPLES	(1U << 20)
+
+static const char *dso_path = BENCH_DSO_PATH;
+static int nr_reader_threads = 2;
+static int nr_events_per_handle = 100;
+static int nr_dso_iterations = 100;
+static unsigned long max_events = 100000;
+
+static volatile int stop_readers, record_latency;
+
+struct thread_ctx {
+	pthread_t thread_id;
+	uint32_t nr_samples;
+	uint32_t *samples;
+};
+
+static struct thread_ctx *reader_ctx;
+
+side_static_event(bench_event_reader, "bench", "reader", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("a"),
+		side_field_s64("b"),
+	)
+);
+
+/* Template copied into the dynamically allocated events. */
+side_static_event(bench_event_template, "bench", "template", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("a"),
+		side_field_s64("b"),
+	)
+);
+
+static
+void noop_call(const struct side_event_description *desc __attribute__((unused)),
+		const struct side_arg_vec *side_arg_vec __attribute__((unused)),
+		void *priv __attribute__((unused)),
+		void *caller_addr __attribute__((unused)))
+{
+}
+
+static
+void *reader_thread(void *arg)
+{
+	struct thread_ctx *thread_ctx = (struct thread_ctx *) arg;
+	uint32_t i = 0;
+
+	while (!stop_readers) {
+		uint64_t t0, t1;
+
+		t0 = bench_now_ns();
+		side_event(bench_event_reader, side_arg_list(side_arg_u32(i), side_arg_s64(-(int64_t) i)));
+		t1 = bench_now_ns();
+		if (record_latency && thread_ctx->nr_samples < NR_LATENCY_SAMPLES)
+			thread_ctx->samples[thread_ctx->nr_samples++] = (uint32_t) (t1 - t0);
+		i++;
+	}
+	return NULL;
+}
+
+static
+int compare_u32(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+	return (x > y) - (x < y);
+}
+
+static
+void start_recording(void)
+{
+	int i;
+
+	for (i = 0; i < nr_reader_threads; i++)
+		reader_ctx[i].nr_samples = 0;
+	__atomic_store_n(&record_latency, 1, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * Returns the p99 emission latency of the reader threads, in ns, and
+ * their number of samples in "nr_samples_p". The latency is only
+ * meaningful if there are samples.
+ */
+static
+uint32_t stop_recording(uint32_t *nr_samples_p)
+{
+	uint32_t *samples, nr_samples = 0, p99;
+	int i;
+
+	__atomic_store_n(&record_latency, 0, __ATOMIC_SEQ_CST);
+	usleep(1000);	/* Let readers observe record_latency. */
+	for (i = 0; i < nr_reader_threads; i++)
+		nr_samples += reader_ctx[i].nr_samples;
+	*nr_samples_p = nr_samples;
+	if (!nr_samples)
+		return 0;
+	samples = calloc(nr_samples, sizeof(uint32_t));
+	if (!samples)
+		abort();
+	nr_samples = 0;
+	for (i = 0; i < nr_reader_threads; i++) {
+		memcpy(&samples[nr_samples], reader_ctx[i].samples,
+			reader_ctx[i].nr_samples * sizeof(uint32_t));
+		nr_samples += reader_ctx[i].nr_samples;
+	}
+	qsort(samples, nr_samples, sizeof(uint32_t), compare_u32);
+	p99 = samples[(uint64_t) nr_samples * 99 / 100];
+	free(samples);
+	return p99;
+}
+
+struct phase {
+	uint64_t ns;
+	uint64_t nr_grace_periods;
+	uint64_t nr_membarrier;
+};
+
+static
+void phase_begin(struct phase *phase)
+{
+	start_recording();
+	side_tracer_rcu_stats(&phase->nr_grace_periods, &phase->nr_membarrier);
+	phase->ns = bench_now_ns();
+}
+
+static
+void phase_end(struct phase *phase, const char *name, unsigned long nr_events, int nr_tracers)
+{
+	uint64_t nr_grace_periods, nr_membarrier;
+	uint32_t p99, nr_samples;
+	char p99_str[16] = "-";
+
+	phase->ns = bench_now_ns() - phase->ns;
+	side_tracer_rcu_stats(&nr_grace_periods, &nr_membarrier);
+	p99 = stop_recording(&nr_samples);
+	if (nr_samples)
+		snprintf(p99_str, sizeof(p99_str), "%" PRIu32, p99);
+	ok(1, "%s events=%lu tracers=%d", name, nr_events, nr_tracers);
+	diag("bench name=%s events=%lu tracers=%d wall_ms=%.3f grace_periods=%" PRIu64 " membarrier=%" PRIu64 " emit_samples=%" PRIu32 " emit_p99_ns=%s",
+		name, nr_events, nr_tracers, (double) phase->ns / 1000000.0,
+		nr_grace_periods - phase->nr_grace_periods,
+		nr_membarrier - phase->nr_membarrier, nr_samples, p99_str);
+}
+
+struct event_set {
+	unsigned long nr_events;
+	struct side_event_description *descs;
+	struct side_event_state_1 *states;
+	uintptr_t *enabled;
+	struct side_event_description **desc_ptrs;
+	unsigned long nr_handles;
+	struct side_events_register_handle **handles;
+};
+
+static
+void event_set_init(struct event_set *set, unsigned long nr_events)
+{
+	unsigned long i;
+
+	set->nr_events = nr_events;
+	set->descs = calloc(nr_events, sizeof(struct side_event_description));
+	set->states = calloc(nr_events, sizeof(struct side_event_state_1));
+	set->enabled = calloc(nr_events, sizeof(uintptr_t));
+	set->desc_ptrs = calloc(nr_events, sizeof(struct side_event_description *));
+	set->nr_handles = (nr_events + nr_events_per_handle - 1) / nr_events_per_handle;
+	set->handles = calloc(set->nr_handles, sizeof(struct side_events_register_handle *));
+	if (!set->descs || !set->states || !set->enabled || !set->desc_ptrs || !set->handles)
+		abort();
+	for (i = 0; i < nr_events; i++) {
+		set->descs[i] = bench_event_template;
+		set->states[i] = side_event_state__bench_event_template;
+		set->states[i].enabled = &set->enabled[i];
+		set->states[i].desc = &set->descs[i];
+		side_ptr_set(set->descs[i].state, &set->states[i].parent);
+		set->desc_ptrs[i] = &set->descs[i];
+	}
+}
+
+static
+void event_set_fini(struct event_set *set)
+{
+	free(set->handles);
+	free(set->desc_ptrs);
+	free(set->enabled);
+	free(set->states);
+	free(set->descs);
+}
+
+static
+void event_set_register(struct event_set *set)
+{
+	unsigned long i;
+
+	for (i = 0; i < set->nr_handles; i++) {
+		unsigned long first = i * nr_events_per_handle;
+		unsigned long nr = set->nr_events - first;
+
+		if (nr > (unsigned long) nr_events_per_handle)
+			nr = nr_events_per_handle;
+		set->handles[i] = side_events_register(&set->desc_ptrs[first], nr);
+		if (!set->handles[i])
+			abort();
+	}
+}
+
+static
+void event_set_unregister(struct event_set *set)
+{
+	unsigned long i;
+
+	for (i = 0; i < set->nr_handles; i++)
+		side_events_unregister(set->handles[i]);
+}
+
+static
+void tracer_attach(struct event_set *set, uint64_t key)
+{
+	unsigned long i;
+
+	for (i = 0; i < set->nr_events; i++) {
+		if (side_tracer_callback_register(&set->descs[i], noop_call, NULL, key))
+			abort();
+	}
+}
+
+static
+void tracer_detach(struct event_set *set, uint64_t key)
+{
+	unsigned long i;
+
+	for (i = 0; i < set->nr_events; i++) {
+		if (side_tracer_callback_unregister(&set->descs[i], noop_call, NULL, key))
+			abort();
+	}
+}
+
+static
+void run_bench_events(unsigned long nr_events, const uint64_t *keys)
+{
+	struct event_set set;
+	struct phase phase;
+	int nr_tracers, i;
+
+	event_set_init(&set, nr_events);
+
+	phase_begin(&phase);
+	event_set_register(&set);
+	phase_end(&phase, "register", nr_events, 0);
+
+	for (nr_tracers = 1; nr_tracers <= MAX_TRACERS; nr_tracers <<= 1) {
+		phase_begin(&phase);
+		for (i = 0; i < nr_tracers; i++)
+			tracer_attach(&set, keys[i]);
+		phase_end(&phase, "attach", nr_events, nr_tracers);
+
+		phase_begin(&phase);
+		for (i = 0; i < nr_tracers; i++)
+			tracer_detach(&set, keys[i]);
+		phase_end(&phase, "detach", nr_events, nr_tracers);
+	}
+
+	phase_begin(&phase);
+	event_set_unregister(&set);
+	phase_end(&phase, "unregister", nr_events, 0);
+
+	event_set_fini(&set);
+}
+
+static
+void run_bench_dso(void)
+{
+	struct phase phase;
+	int i;
+
+	phase_begin(&phase);
+	for (i = 0; i < nr_dso_iterations; i++) {
+		void *handle;
+
+		handle = dlopen(dso_path, RTLD_NOW | RTLD_LOCAL);
+		if (!handle) {
+			fprintf(stderr, "dlopen: %s\n", dlerror());
+			abort();
+		}
+		if (dlclose(handle)) {
+			fprintf(stderr, "dlclose: %s\n", dlerror());
+			abort();
+		}
+	}
+	phase_end(&phase, "dlopen_dlclose", (unsigned long) nr_dso_iterations, 0);
+}
+
+static const struct bench_option options[] = {
+	{ 'e', BENCH_OPTION_ULONG, &max_events, "<nr_events> (maximum number of events, default: 100000)" },
+	{ 'p', BENCH_OPTION_INT, &nr_events_per_handle, "<nr_events_per_handle> (default: 100)" },
+	{ 'r', BENCH_OPTION_INT, &nr_reader_threads, "<nr_readers> (number of reader threads, default: 2)" },
+	{ 'l', BENCH_OPTION_INT, &nr_dso_iterations, "<iterations> (number of dlopen/dlclose iterations, default: 100)" },
+	{ 'd', BENCH_OPTION_STRING, &dso_path, "<path> (instrumented shared object)" },
+};
+
+int main(int argc, const char **argv)
+{
+	uint64_t keys[MAX_TRACERS];
+	unsigned long nr_events;
+	int i, ret;
+
+	bench_disable_demo_tracer(argv);
+	ret = bench_parse_cmd_line(argc, argv, options, SIDE_ARRAY_SIZE(options));
+	if (ret < 0)
+		return -1;
+	if (ret > 0)
+		return 0;
+	if (nr_events_per_handle <= 0 || nr_reader_threads < 0) {
+		fprintf(stderr, "Invalid command line arguments\n");
+		return -1;
+	}
+
+	plan_no_plan();
+	for (i = 0; i < MAX_TRACERS; i++) {
+		if (side_tracer_request_key(&keys[i]))
+			abort();
+	}
+	if (side_tracer_callback_register(&bench_event_reader, noop_call, NULL, keys[0]))
+		abort();
+
+	reader_ctx = calloc(nr_reader_threads, sizeof(struct thread_ctx));
+	if (!reader_ctx)
+		abort();
+	for (i = 0; i < nr_reader_threads; i++) {
+		reader_ctx[i].samples = calloc(NR_LATENCY_SAMPLES, sizeof(uint32_t));
+		if (!reader_ctx[i].samples)
+			abort();
+		ret = pthread_create(&reader_ctx[i].thread_id, NULL, reader_thread, &reader_ctx[i]);
+		if (ret) {
+			errno = ret;
+			perror("pthread_create");
+			abort();
+		}
+	}
+
+	for (nr_events = 1000; nr_events <= max_events; nr_events *= 10)
+		run_bench_events(nr_events, keys);
+	run_bench_dso();
+
+	stop_readers = 1;
+	for (i = 0; i < nr_reader_threads; i++) {
+		ret = pthread_join(reader_ctx[i].thread_id, NULL);
+		if (ret) {
+			errno = ret;
+			perror("pthread_join");
+			abort();
+		}
+		free(reader_ctx[i].samples);
+	}
+	free(reader_ctx);
+	if (side_tracer_callback_unregister(&bench_event_reader, noop_call, NULL, keys[0]))
+		abort();
+	return exit_status();
+}
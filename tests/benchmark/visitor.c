@@ -0,0 +1,615 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+/*
+ * Throughput benchmark of type_visitor_event() with a no-op visitor
+ * and with a serializing visitor, for the event shapes covered by the
+ * unit tests, at varying sizes.
+ *
+ * Each shape is emitted once. Its callback visits the received
+ * argument vector in a loop, so the dispatch cost is not accounted.
+ * Each measurement is reported as a TAP test point followed by a
+ * diagnostic line of the form:
+ *
+ *   # bench name=<shape> size=<n> visitor=<noop|serialize> iterations=<n> events_per_s=<f> bytes_per_s=<f> bytes_per_event=<n>
+ *
+ * bytes_per_event is the size of the serialized payload, also used to
+ * compute bytes_per_s for the no-op visitor.
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * Variable-size stack-copy arguments are built at runtime, which the
+ * static checker cannot follow.
+ */
+#define SIDE_STATIC_CHECK_DISABLE
+
+#include <side/trace.h>
+
+#include "bench.h"
+#include "tap.h"
+#include "../../src/visit-arg-vec.h"
+
+#define SERIALIZE_BUF_LEN	65536
+
+static uint64_t nr_iterations = 100000;
+
+static const uint32_t sizes[] = { 1, 16, 256 };
+
+/* Serializing visitor: copies the raw field values into a buffer. */
+
+struct serialize_ctx {
+	size_t offset;
+	uint64_t len;
+	char buf[SERIALIZE_BUF_LEN];
+};
+
+static
+void serialize(void *priv, const void *p, size_t len)
+{
+	struct serialize_ctx *ctx = (struct serialize_ctx *) priv;
+
+	if (len > SERIALIZE_BUF_LEN)
+		abort();
+	if (len > SERIALIZE_BUF_LEN - ctx->offset)
+		ctx->offset = 0;
+	memcpy(&ctx->buf[ctx->offset], p, len);
+	ctx->offset += len;
+	ctx->len += len;
+}
+
+static
+size_t string_len(const void *p, uint8_t unit_size)
+{
+	size_t i;
+
+	switch (unit_size) {
+	case 1:
+		for (i = 0; ((const uint8_t *) p)[i]; i++);
+		break;
+	case 2:
+		for (i = 0; ((const uint16_t *) p)[i]; i++);
+		break;
+	case 4:
+		for (i = 0; ((const uint32_t *) p)[i]; i++);
+		break;
+	default:
+		abort();
+	}
+	return (i + 1) * unit_size;
+}
+
+static
+void serialize_before_event(const struct side_event_description *desc __attribute__((unused)),
+		const struct side_arg_vec *side_arg_vec __attribute__((unused)),
+		const struct side_arg_dynamic_struct *var_struct __attribute__((unused)),
+		void *caller_addr __attribute__((unused)), void *priv)
+{
+	((struct serialize_ctx *) priv)->offset = 0;
+}
+
+static
+void serialize_bool(const struct side_type *type_desc, const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_static.bool_value, type_desc->u.side_bool.bool_size);
+}
+
+static
+void serialize_integer(const struct side_type *type_desc, const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_static.integer_value, type_desc->u.side_integer.integer_size);
+}
+
+static
+void serialize_byte(const struct side_type *type_desc __attribute__((unused)),
+		const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_static.byte_value, 1);
+}
+
+static
+void serialize_float(const struct side_type *type_desc, const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_static.float_value, type_desc->u.side_float.float_size);
+}
+
+static
+void serialize_string(const struct side_type *type_desc, const struct side_arg *item, void *priv)
+{
+	const void *p = side_ptr_get(item->u.side_static.string_value);
+
+	serialize(priv, p, string_len(p, type_desc->u.side_string.unit_size));
+}
+
+static
+void serialize_enum(const struct side_type *type_desc, const struct side_arg *item, void *priv)
+{
+	const struct side_type *elem_type = side_ptr_get(type_desc->u.side_enum.elem_type);
+
+	serialize(priv, &item->u.side_static.integer_value, elem_type->u.side_integer.integer_size);
+}
+
+static
+void serialize_gather_bool(const struct side_type_gather_bool *type, const union side_bool_value *value, void *priv)
+{
+	serialize(priv, value, type->type.bool_size);
+}
+
+static
+void serialize_gather_byte(const struct side_type_gather_byte *type __attribute__((unused)),
+		const uint8_t *_ptr, void *priv)
+{
+	serialize(priv, _ptr, 1);
+}
+
+static
+void serialize_gather_integer(const struct side_type_gather_integer *type, const union side_integer_value *value, void *priv)
+{
+	serialize(priv, value, type->type.integer_size);
+}
+
+static
+void serialize_gather_float(const struct side_type_gather_float *type, const union side_float_value *value, void *priv)
+{
+	serialize(priv, value, type->type.float_size);
+}
+
+static
+void serialize_gather_string(const struct side_type_gather_string *type __attribute__((unused)),
+		const void *p, uint8_t unit_size,
+		enum side_type_label_byte_order byte_order __attribute__((unused)),
+		size_t strlen_with_null, void *priv)
+{
+	serialize(priv, p, strlen_with_null * unit_size);
+}
+
+static
+void serialize_gather_enum(const struct side_type_gather_enum *type, const union side_integer_value *value, void *priv)
+{
+	const struct side_type *elem_type = side_ptr_get(type->elem_type);
+
+	serialize(priv, value, elem_type->u.side_gather.u.side_integer.type.integer_size);
+}
+
+static
+void serialize_dynamic_bool(const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_dynamic.side_bool.value, item->u.side_dynamic.side_bool.type.bool_size);
+}
+
+static
+void serialize_dynamic_integer(const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_dynamic.side_integer.value, item->u.side_dynamic.side_integer.type.integer_size);
+}
+
+static
+void serialize_dynamic_byte(const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_dynamic.side_byte.value, 1);
+}
+
+static
+void serialize_dynamic_float(const struct side_arg *item, void *priv)
+{
+	serialize(priv, &item->u.side_dynamic.side_float.value, item->u.side_dynamic.side_float.type.float_size);
+}
+
+static
+void serialize_dynamic_string(const struct side_arg *item, void *priv)
+{
+	const void *p = (const void *) (uintptr_t) item->u.side_dynamic.side_string.value;
+
+	serialize(priv, p, string_len(p, item->u.side_dynamic.side_string.type.unit_size));
+}
+
+static struct side_type_visitor serialize_visitor = {
+	.before_event_func = serialize_before_event,
+	.bool_type_func = serialize_bool,
+	.integer_type_func = serialize_integer,
+	.byte_type_func = serialize_byte,
+	.pointer_type_func = serialize_integer,
+	.float_type_func = serialize_float,
+	.string_type_func = serialize_string,
+	.enum_type_func = serialize_enum,
+	.gather_bool_type_func = serialize_gather_bool,
+	.gather_byte_type_func = serialize_gather_byte,
+	.gather_integer_type_func = serialize_gather_integer,
+	.gather_pointer_type_func = serialize_gather_integer,
+	.gather_float_type_func = serialize_gather_float,
+	.gather_string_type_func = serialize_gather_string,
+	.gather_enum_type_func = serialize_gather_enum,
+	.dynamic_bool_func = serialize_dynamic_bool,
+	.dynamic_integer_func = serialize_dynamic_integer,
+	.dynamic_byte_func = serialize_dynamic_byte,
+	.dynamic_pointer_func = serialize_dynamic_integer,
+	.dynamic_float_func = serialize_dynamic_float,
+	.dynamic_string_func = serialize_dynamic_string,
+};
+
+/* No-op visitor: only walks the types. */
+static struct side_type_visitor noop_visitor;
+
+/* Benchmark run state, passed to the event callbacks. */
+struct bench_run {
+	const struct side_type_visitor *visitor;
+	void *visitor_priv;
+	uint64_t nr;
+	uint64_t ns;
+};
+
+static
+void bench_call(const struct side_event_description *desc,
+		const struct side_arg_vec *side_arg_vec,
+		void *priv, void *caller_addr)
+{
+	struct bench_run *run = (struct bench_run *) priv;
+	uint64_t i, ns;
+
+	ns = bench_now_ns();
+	for (i = 0; i < run->nr; i++)
+		type_visitor_event(run->visitor, desc, side_arg_vec, NULL, caller_addr, run->visitor_priv);
+	run->ns = bench_now_ns() - ns;
+}
+
+static struct bench_run run;
+static struct serialize_ctx serialize_ctx;
+
+/* Event shapes. */
+
+side_static_event(bench_event_basic, "bench", "basic", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("u32"),
+		side_field_s64("s64"),
+		side_field_float_binary64("f64"),
+		side_field_bool("bool"),
+		side_field_string("string"),
+	)
+);
+
+static side_define_struct(bench_inner_struct,
+	side_field_list(
+		side_field_u32("x"),
+		side_field_s64("y"),
+	)
+);
+
+static side_define_struct(bench_outer_struct,
+	side_field_list(
+		side_field_struct("inner", bench_inner_struct),
+		side_field_u8("z"),
+	)
+);
+
+side_static_event(bench_event_struct, "bench", "struct", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_struct("outer", bench_outer_struct),
+		side_field_u16("w"),
+	)
+);
+
+static side_define_vla(bench_vla_u32,
+	side_elem(side_type_u32()),
+	side_elem(side_type_u32())
+);
+
+side_static_event(bench_event_vla, "bench", "vla", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_vla("vla", bench_vla_u32),
+	)
+);
+
+struct app_visitor_ctx {
+	const uint32_t *ptr;
+	uint32_t length;
+};
+
+static
+enum side_visitor_status bench_visitor(const struct side_tracer_visitor_ctx *tracer_ctx, struct app_visitor_ctx *ctx)
+{
+	uint32_t length = ctx->length, i;
+
+	for (i = 0; i < length; i++) {
+		const struct side_arg elem = side_visit_dynamic_arg(side_arg_u32, ctx->ptr[i]);
+
+		if (tracer_ctx->write_elem(tracer_ctx, &elem) != SIDE_VISITOR_STATUS_OK)
+			return SIDE_VISITOR_STATUS_ERROR;
+	}
+	return SIDE_VISITOR_STATUS_OK;
+}
+
+side_define_static_vla_visitor(bench_vla_visitor,
+			side_elem(side_type_u32()), side_elem(side_type_u32()),
+			bench_visitor, struct app_visitor_ctx);
+
+side_static_event(bench_event_vla_visitor, "bench", "vla_visitor", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_vla_visitor("vlavisit", bench_vla_visitor),
+	)
+);
+
+side_static_event(bench_event_gather_vla, "bench", "gather_vla", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_gather_vla("vla",
+			side_elem(side_type_gather_unsigned_integer(0, sizeof(uint32_t), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT)),
+			0, SIDE_TYPE_GATHER_ACCESS_DIRECT,
+			side_length(side_type_gather_unsigned_integer(0, sizeof(uint32_t), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT))
+		),
+	)
+);
+
+static side_define_enum(bench_enum,
+	side_enum_mapping_list(
+		side_enum_mapping_range("one-ten", 1, 10),
+		side_enum_mapping_range("100-200", 100, 200),
+		side_enum_mapping_value("300", 300),
+	)
+);
+
+side_static_event(bench_event_enum, "bench", "enum", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_enum("e32", &bench_enum, side_elem(side_type_u32())),
+		side_field_enum("e64", &bench_enum, side_elem(side_type_u64())),
+		side_field_enum("e8", &bench_enum, side_elem(side_type_u8())),
+		side_field_enum("es8", &bench_enum, side_elem(side_type_s8())),
+	)
+);
+
+static side_define_variant(bench_variant,
+	side_type_u32(),
+	side_option_list(
+		side_option_range(1, 3, side_type_u16()),
+		side_option(5, side_type_string()),
+	)
+);
+
+side_static_event(bench_event_variant, "bench", "variant", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_variant("variant1", bench_variant),
+		side_field_variant("variant2", bench_variant),
+	)
+);
+
+side_static_event(bench_event_dynamic_struct, "bench", "dynamic_struct", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_dynamic("dynamic"),
+	)
+);
+
+static struct side_event_description *bench_events[] = {
+	&bench_event_basic,
+	&bench_event_struct,
+	&bench_event_vla,
+	&bench_event_vla_visitor,
+	&bench_event_gather_vla,
+	&bench_event_enum,
+	&bench_event_variant,
+	&bench_event_dynamic_struct,
+};
+
+static
+void emit_basic(uint32_t size __attribute__((unused)))
+{
+	side_event_call(bench_event_basic,
+		side_arg_list(
+			side_arg_u32(1),
+			side_arg_s64(-2),
+			side_arg_float_binary64(3.0),
+			side_arg_bool(true),
+			side_arg_string("string"),
+		)
+	);
+}
+
+static
+void emit_struct(uint32_t size __attribute__((unused)))
+{
+	side_arg_define_struct(inner, side_arg_list(side_arg_u32(1), side_arg_s64(-2)));
+	side_arg_define_struct(outer, side_arg_list(side_arg_struct(inner), side_arg_u8(3)));
+
+	side_event_call(bench_event_struct,
+		side_arg_list(side_arg_struct(outer), side_arg_u16(4)));
+}
+
+static
+void emit_vla(uint32_t size)
+{
+	struct side_arg *sav;
+	struct side_arg_vec vla = {};
+	uint32_t i;
+
+	sav = calloc(size, sizeof(struct side_arg));
+	if (!sav)
+		abort();
+	for (i = 0; i < size; i++) {
+		const struct side_arg elem = side_visit_dynamic_arg(side_arg_u32, i);
+
+		memcpy(&sav[i], &elem, sizeof(elem));
+	}
+	side_ptr_set(vla.sav, sav);
+	vla.len = size;
+	side_event_call(bench_event_vla, side_arg_list(side_arg_vla(vla)));
+	free(sav);
+}
+
+static
+void emit_vla_visitor(uint32_t size)
+{
+	struct app_visitor_ctx ctx;
+	uint32_t *array, i;
+
+	array = calloc(size, sizeof(uint32_t));
+	if (!array)
+		abort();
+	for (i = 0; i < size; i++)
+		array[i] = i;
+	ctx.ptr = array;
+	ctx.length = size;
+	{
+		side_arg_define_vla_visitor(side_visitor, &ctx);
+		side_event_call(bench_event_vla_visitor,
+			side_arg_list(side_arg_vla_visitor(side_visitor)));
+	}
+	free(array);
+}
+
+static
+void emit_gather_vla(uint32_t size)
+{
+	uint32_t *array, i;
+
+	array = calloc(size, sizeof(uint32_t));
+	if (!array)
+		abort();
+	for (i = 0; i < size; i++)
+		array[i] = i;
+	side_event_call(bench_event_gather_vla,
+		side_arg_list(side_arg_gather_vla(array, &size)));
+	free(array);
+}
+
+static
+void emit_enum(uint32_t size __attribute__((unused)))
+{
+	side_event_call(bench_event_enum,
+		side_arg_list(
+			side_arg_u32(5),
+			side_arg_u64(150),
+			side_arg_u8(200),
+			side_arg_s8(-100),
+		)
+	);
+}
+
+static
+void emit_variant(uint32_t size __attribute__((unused)))
+{
+	side_arg_define_variant(variant1, side_arg_u32(2), side_arg_u16(4));
+	side_arg_define_variant(variant2, side_arg_u32(5), side_arg_string("abc"));
+
+	side_event_call(bench_event_variant,
+		side_arg_list(side_arg_variant(variant1), side_arg_variant(variant2)));
+}
+
+static
+void emit_dynamic_struct(uint32_t size)
+{
+	struct side_arg_dynamic_struct dynamic_struct = {};
+	struct side_arg_dynamic_field *fields;
+	uint32_t i;
+
+	fields = calloc(size, sizeof(struct side_arg_dynamic_field));
+	if (!fields)
+		abort();
+	for (i = 0; i < size; i++) {
+		const struct side_arg_dynamic_field field = {
+			.field_name = SIDE_PTR_INIT("field"),
+			.elem = side_visit_dynamic_arg(side_arg_dynamic_u32, i),
+		};
+
+		memcpy(&fields[i], &field, sizeof(field));
+	}
+	side_ptr_set(dynamic_struct.fields, fields);
+	dynamic_struct.len = size;
+	side_event_call(bench_event_dynamic_struct,
+		side_arg_list(side_arg_dynamic_struct(&dynamic_struct)));
+	free(fields);
+}
+
+static
+void report(const char *name, uint32_t size, const char *visitor,
+		uint64_t ns, uint64_t bytes_per_event)
+{
+	double events_per_s = (double) nr_iterations * 1000000000.0 / (double) (ns ? ns : 1);
+
+	ok(1, "%s size=%" PRIu32 " visitor=%s", name, size, visitor);
+	diag("bench name=%s size=%" PRIu32 " visitor=%s iterations=%" PRIu64 " events_per_s=%.0f bytes_per_s=%.0f bytes_per_event=%" PRIu64,
+		name, size, visitor, nr_iterations, events_per_s,
+		events_per_s * (double) bytes_per_event, bytes_per_event);
+}
+
+static
+void run_shape(const char *name, void (*emit)(uint32_t size), uint32_t size)
+{
+	uint64_t bytes_per_event;
+
+	/* Size of the serialized payload. */
+	run.visitor = &serialize_visitor;
+	run.visitor_priv = &serialize_ctx;
+	run.nr = 1;
+	serialize_ctx.len = 0;
+	emit(size);
+	bytes_per_event = serialize_ctx.len;
+
+	run.visitor = &noop_visitor;
+	run.visitor_priv = NULL;
+	run.nr = nr_iterations;
+	emit(size);
+	report(name, size, "noop", run.ns, bytes_per_event);
+
+	run.visitor = &serialize_visitor;
+	run.visitor_priv = &serialize_ctx;
+	emit(size);
+	report(name, size, "serialize", run.ns, bytes_per_event);
+}
+
+static
+void run_shape_sizes(const char *name, void (*emit)(uint32_t size))
+{
+	unsigned int i;
+
+	for (i = 0; i < SIDE_ARRAY_SIZE(sizes); i++)
+		run_shape(name, emit, sizes[i]);
+}
+
+static const struct bench_option options[] = {
+	{ 'n', BENCH_OPTION_U64, &nr_iterations, "<iterations> (number of visits per shape and size)" },
+};
+
+int main(int argc, const char **argv)
+{
+	uint64_t key;
+	unsigned int i;
+	int ret;
+
+	bench_disable_demo_tracer(argv);
+	ret = bench_parse_cmd_line(argc, argv, options, SIDE_ARRAY_SIZE(options));
+	if (ret < 0)
+		return -1;
+	if (ret > 0)
+		return 0;
+	if (!nr_iterations) {
+		fprintf(stderr, "Invalid command line arguments\n");
+		return -1;
+	}
+
+	plan_no_plan();
+	if (side_tracer_request_key(&key))
+		abort();
+	for (i = 0; i < SIDE_ARRAY_SIZE(bench_events); i++) {
+		if (side_tracer_callback_register(bench_events[i], bench_call, &run, key))
+			abort();
+	}
+
+	run_shape("basic", emit_basic, 1);
+	run_shape("struct", emit_struct, 1);
+	run_shape_sizes("vla", emit_vla);
+	run_shape_sizes("vla_visitor", emit_vla_visitor);
+	run_shape_sizes("gather_vla", emit_gather_vla);
+	run_shape("enum", emit_enum, 1);
+	run_shape("variant", emit_variant, 1);
+	run_shape_sizes("dynamic_struct", emit_dynamic_struct);
+
+	for (i = 0; i < SIDE_ARRAY_SIZE(bench_events); i++) {
+		if (side_tracer_callback_unregister(bench_events[i], bench_call, &run, key))
+			abort();
+	}
+	return exit_status();
+}
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "../../src/smp.h"
+
+static char sysfs_root[] = "/tmp/side-cpu-topology-XXXXXX";
+
+/* Create the parent directories of "path" and write "content" to it. */
+static
+void write_file(const char *path, const char *content)
+{
+	char dir[PATH_MAX], *p;
+	FILE *f;
+
+	if (snprintf(dir, sizeof(dir), "%s", path) >= (int) sizeof(dir))
+		abort();
+	for (p = dir + strlen(sysfs_root) + 1; (p = strchr(p, '/')); p++) {
+		*p = '\0';
+		if (mkdir(dir, 0700) && access(dir, F_OK))
+			abort();
+		*p = '/';
+	}
+	f = fopen(path, "w");
+	if (!f)
+		abort();
+	if (fputs(content, f) < 0)
+		abort();
+	if (fclose(f))
+		abort();
+}
+
+static
+void check_ranges(void)
+{
+	int nr_cpus = get_possible_cpus_array_len(), cpu;
+
+	if (nr_cpus <= 0)
+		abort();
+	if (get_nr_cpu_nodes() <= 0 || get_nr_cpu_llcs() <= 0)
+		abort();
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		int node = get_cpu_node(cpu), llc = get_cpu_llc(cpu);
+
+		if (node < 0 || node >= get_nr_cpu_nodes())
+			abort();
+		if (llc < 0 || llc >= get_nr_cpu_llcs())
+			abort();
+	}
+	if (get_cpu_node(-1) || get_cpu_node(nr_cpus))
+		abort();
+	if (get_cpu_llc(-1) || get_cpu_llc(nr_cpus))
+		abort();
+}
+
+/* Topology of the running system. */
+static
+void test_system_topology(void)
+{
+	check_ranges();
+}
+
+/* Without sysfs topology: a single node holding a single LLC. */
+static
+void test_missing_sysfs(void)
+{
+	int nr_cpus = get_possible_cpus_array_len(), cpu;
+
+	reload_cpu_topology(sysfs_root);
+	check_ranges();
+	if (get_nr_cpu_nodes() != 1 || get_nr_cpu_llcs() != 1)
+		abort();
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		if (get_cpu_node(cpu) || get_cpu_llc(cpu))
+			abort();
+	}
+}
+
+/*
+ * NUMA nodes without cache topology: one LLC per node. CPU 0 is on
+ * node 0, the other CPUs on node 1.
+ */
+static
+void test_missing_cache_topology(void)
+{
+	int nr_cpus = get_possible_cpus_array_len(), cpu;
+	char path[PATH_MAX], buf[32];
+
+	snprintf(path, sizeof(path), "%s/node/node0/cpulist", sysfs_root);
+	write_file(path, "0\n");
+	if (nr_cpus > 1) {
+		snprintf(path, sizeof(path), "%s/node/node1/cpulist", sysfs_root);
+		snprintf(buf, sizeof(buf), "1-%d\n", nr_cpus - 1);
+		write_file(path, buf);
+	}
+	reload_cpu_topology(sysfs_root);
+	check_ranges();
+	if (get_nr_cpu_nodes() != (nr_cpus > 1 ? 2 : 1))
+		abort();
+	if (get_nr_cpu_llcs() != get_nr_cpu_nodes())
+		abort();
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		if (get_cpu_node(cpu) != (cpu ? 1 : 0))
+			abort();
+		if (get_cpu_llc(cpu) != get_cpu_node(cpu))
+			abort();
+	}
+}
+
+/*
+ * Cache topology: each CPU pair shares its highest level cache, listed
+ * after a private lower level cache.
+ */
+static
+void test_cache_topology(void)
+{
+	int nr_cpus = get_possible_cpus_array_len(), cpu;
+	char path[PATH_MAX], buf[32];
+
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		int first = cpu & ~1, last = first + 1 < nr_cpus ? first + 1 : first;
+
+		snprintf(path, sizeof(path), "%s/cpu/cpu%d/cache/index0/level", sysfs_root, cpu);
+		write_file(path, "1\n");
+		snprintf(path, sizeof(path), "%s/cpu/cpu%d/cache/index0/shared_cpu_list", sysfs_root, cpu);
+		snprintf(buf, sizeof(buf), "%d\n", cpu);
+		write_file(path, buf);
+		snprintf(path, sizeof(path), "%s/cpu/cpu%d/cache/index1/level", sysfs_root, cpu);
+		write_file(path, "3\n");
+		snprintf(path, sizeof(path), "%s/cpu/cpu%d/cache/index1/shared_cpu_list", sysfs_root, cpu);
+		snprintf(buf, sizeof(buf), "%d-%d\n", first, last);
+		write_file(path, buf);
+	}
+	reload_cpu_topology(sysfs_root);
+	check_ranges();
+	if (get_nr_cpu_llcs() != (nr_cpus + 1) / 2)
+		abort();
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		if (get_cpu_llc(cpu) != cpu / 2)
+			abort();
+	}
+}
+
+/*
+ * Shared CPU list not including the CPU itself: CPU 0 shares its highest
+ * level cache with the last CPU only, the other CPUs have an LLC of
+ * their own. Overwrites the lists of test_cache_topology().
+ */
+static
+void test_cache_topology_first_after(void)
+{
+	int nr_cpus = get_possible_cpus_array_len(), cpu;
+	char path[PATH_MAX], buf[32];
+
+	if (nr_cpus < 2)
+		return;
+	for (cpu = 0; cpu < nr_cpus; cpu++) {
+		snprintf(path, sizeof(path), "%s/cpu/cpu%d/cache/index1/shared_cpu_list", sysfs_root, cpu);
+		snprintf(buf, sizeof(buf), "%d\n", cpu ? cpu : nr_cpus - 1);
+		write_file(path, buf);
+	}
+	reload_cpu_topology(sysfs_root);
+	check_ranges();
+	if (get_nr_cpu_llcs() != nr_cpus - 1)
+		abort();
+	for (cpu = 0; cpu < nr_cpus - 1; cpu++) {
+		if (get_cpu_llc(cpu) != cpu)
+			abort();
+	}
+	if (get_cpu_llc(nr_cpus - 1) != get_cpu_llc(0))
+		abort();
+}
+
+int main(void)
+{
+	char cmd[PATH_MAX];
+
+	if (!mkdtemp(sysfs_root))
+		abort();
+	test_system_topology();
+	test_missing_sysfs();
+	test_missing_cache_topology();
+	test_cache_topology();
+	test_cache_topology_first_after();
+	snprintf(cmd, sizeof(cmd), "rm -rf '%s'", sysfs_root);
+	if (system(cmd))
+		abort();
+	return 0;
+}
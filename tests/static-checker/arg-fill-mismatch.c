@@ -0,0 +1,18 @@
+side_static_event(event, "provider", "event", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("a"),
+		side_field_u32("b"),
+	)
+);
+
+static void fill(struct side_arg *sav, uint32_t len, void *priv)
+{
+	(void) priv;
+	side_arg_fill(event, sav, len, side_arg_list(side_arg_u32(1), side_arg_u64(2)));
+}
+
+int main(void)
+{
+	side_event_lazy(event, fill, NULL);
+	return 0;
+}
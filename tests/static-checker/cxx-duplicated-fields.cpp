@@ -0,0 +1,5 @@
+#include <side/instrumentation-cxx-api.h>
+
+using event = side::event<"provider", "event", side::u32<"a">, side::u32<"a">>;
+
+int main() { event::emit(1, 2); return 0; }
@@ -0,0 +1,5 @@
+#include <side/instrumentation-cxx-api.h>
+
+using event = side::event<"provider", "event", side::u32<"a">, side::u32<"b">>;
+
+int main() { event::emit(1, "b"); return 0; }
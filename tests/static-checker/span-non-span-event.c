@@ -0,0 +1,12 @@
+side_static_event(event, "provider", "event", SIDE_LOGLEVEL_ERR,
+	side_field_list(
+		side_field_u64("start"),
+		side_field_u64("duration"),
+	)
+);
+
+int main()
+{
+	side_span(event);
+	return 0;
+}
@@ -0,0 +1,96 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <side/trace.h>
+
+/*
+ * Fast exit mode enabled through SIDE_FAST_EXIT: tracers which opted in
+ * are sent a single exit notification, and no event removal follows it.
+ * Other tracers are not sent the exit notification.
+ */
+
+side_static_event(my_provider_event_fast_exit, "myprovider", "myevent_fast_exit", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(side_field_u32("value"))
+);
+
+static unsigned int nr_exit, nr_remove_after_exit, nr_exit_no_flag;
+
+static
+void fast_exit_notification(enum side_tracer_notification notif,
+		struct side_event_description **events __attribute__((unused)),
+		uint32_t nr_events __attribute__((unused)),
+		void *priv __attribute__((unused)))
+{
+	switch (notif) {
+	case SIDE_TRACER_NOTIFICATION_EXIT:
+		nr_exit++;
+		break;
+	case SIDE_TRACER_NOTIFICATION_REMOVE_EVENTS:
+		if (nr_exit)
+			nr_remove_after_exit++;
+		break;
+	default:
+		break;
+	}
+}
+
+static
+void no_exit_notification(enum side_tracer_notification notif,
+		struct side_event_description **events __attribute__((unused)),
+		uint32_t nr_events __attribute__((unused)),
+		void *priv __attribute__((unused)))
+{
+	if (notif == SIDE_TRACER_NOTIFICATION_EXIT)
+		nr_exit_no_flag++;
+}
+
+/*
+ * Runs after the main program's event unregistration destructors, once
+ * the exit handler has notified tracers.
+ */
+static
+void __attribute__((destructor(101))) check_fast_exit(void)
+{
+	if (nr_exit != 1 || nr_remove_after_exit || nr_exit_no_flag) {
+		fprintf(stderr, "fast exit: %u exit notifications, %u removals after exit, %u without flag\n",
+			nr_exit, nr_remove_after_exit, nr_exit_no_flag);
+		_exit(EXIT_FAILURE);
+	}
+}
+
+int main(int argc __attribute__((unused)), char **argv)
+{
+	/* Empty registrations: my_provider_event_fast_exit is already registered. */
+	struct side_event_description *descs[] = { NULL };
+	int i;
+
+	/* SIDE_FAST_EXIT is read by the library constructor. */
+	if (!getenv("SIDE_FAST_EXIT")) {
+		if (setenv("SIDE_FAST_EXIT", "1", 1))
+			abort();
+		execv("/proc/self/exe", argv);
+		abort();
+	}
+	if (!side_tracer_event_notification_register_flags(fast_exit_notification, NULL,
+			SIDE_TRACER_NOTIFICATION_FLAG_EXIT))
+		abort();
+	if (!side_tracer_event_notification_register(no_exit_notification, NULL))
+		abort();
+	/* Registrations past the first do not register exit handlers. */
+	for (i = 0; i < 1000; i++) {
+		struct side_events_register_handle *handle;
+
+		handle = side_events_register(descs, 1);
+		if (!handle)
+			abort();
+		side_events_unregister(handle);
+	}
+	return 0;
+}
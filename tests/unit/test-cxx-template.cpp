@@ -0,0 +1,119 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+#include <side/instrumentation-cxx-api.h>
+
+/* User code example */
+
+using my_provider_event = side::event<"myprovider", "mycxxevent",
+	side::u32<"abc">,
+	side::s64<"def">,
+	side::pointer<"ptr">,
+	side::string<"str">,
+	side::boolean<"bool">
+>;
+
+using my_provider_event_info = side::basic_event<SIDE_LOGLEVEL_INFO, "myprovider", "mycxxeventinfo",
+	side::u8<"a">,
+	side::float_binary64<"b">
+>;
+
+using my_provider_event_empty = side::event<"myprovider", "mycxxeventempty">;
+
+using my_provider_event_span = side::span_event<"myprovider", "mycxxspan">;
+
+using my_provider_event_range = side::event<"myprovider", "mycxxeventrange",
+	side::span<"vec", uint32_t>,
+	side::span<"arr", int16_t>,
+	side::span<"dbl", double>,
+	side::string_view<"sv">,
+	side::string_view<"str">
+>;
+
+static
+void test_cxx_event(void)
+{
+	my_provider_event::emit(42, -500, (const void *) 0x1, "hello", true);
+	if (my_provider_event::enabled())
+		my_provider_event::call(43, -501, nullptr, "world", false);
+}
+
+static
+void test_cxx_event_info(void)
+{
+	my_provider_event_info::emit(1, 2.5);
+}
+
+static
+void test_cxx_event_range(void)
+{
+	std::vector<uint32_t> vec = { 1, 2, 3 };
+	std::array<int16_t, 2> arr = { -1, -2 };
+	double dbl[] = { 1.5, 2.5 };
+	std::string str = "string";
+
+	my_provider_event_range::emit(vec, arr, std::span<const double>(dbl), std::string_view("view"), str);
+}
+
+static
+void test_cxx_event_empty(void)
+{
+	my_provider_event_empty::emit();
+}
+
+static
+void test_cxx_event_span(void)
+{
+	for (int i = 0; i < 3; i++) {
+		my_provider_event_span::scope span;
+
+		my_provider_event_info::emit(i, 0.5);
+	}
+}
+
+static
+void test_cxx_event_lazy(void)
+{
+	int calls = 0;
+
+	/* The lambda is only invoked when the event is enabled. */
+	my_provider_event_info::emit_lazy([&] {
+		calls++;
+		return std::tuple(7, 1.25);
+	});
+	if (calls != (my_provider_event_info::enabled() ? 1 : 0))
+		abort();
+}
+
+static
+void test_cxx_event_fingerprint(void)
+{
+	uint64_t fingerprint;
+
+	/* Template events are registered with the C events. */
+	if (side_event_description_fingerprint(my_provider_event::description(), &fingerprint))
+		abort();
+}
+
+int main()
+{
+	test_cxx_event();
+	test_cxx_event_info();
+	test_cxx_event_range();
+	test_cxx_event_empty();
+	test_cxx_event_span();
+	test_cxx_event_lazy();
+	test_cxx_event_fingerprint();
+	return 0;
+}
@@ -0,0 +1,2 @@
+#define SIDE_EVENT_OUTLINE
+#include "test-cxx.cpp"
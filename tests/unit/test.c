@@ -9,6 +9,8 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <string.h>
+#include <pthread.h>
 
 #include <side/trace.h>
 
@@ -276,6 +278,60 @@ void test_dynamic_basic_type(void)
 		side_arg_list(side_arg_dynamic_s16(-33)));
 }
 
+static
+void test_dynamic_loop(void)
+{
+	int i;
+
+	/* Dynamic literals are recycled by side_call in C++. */
+	for (i = 0; i < 1000; i++) {
+		side_event(my_provider_event_dynamic_basic,
+			side_arg_list(side_arg_dynamic_s32(i,
+				side_dynamic_attr_list(side_attr("iteration", side_attr_s32(i))))));
+	}
+}
+
+static
+bool check_bytes(const char *p, char c, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		if (p[i] != c)
+			return false;
+	}
+	return true;
+}
+
+static
+void test_arena_overflow(void)
+{
+	const size_t len = 8192;
+	char *a, *b, *c;
+
+	side_arena_scope_begin();
+	/* Allocations beyond the arena size must not reuse live memory. */
+	a = (char *) side_arena_alloc(len, 16);
+	memset(a, 1, len);
+	b = (char *) side_arena_alloc(len, 16);
+	memset(b, 2, len);
+	c = (char *) side_arena_alloc(len, 16);
+	memset(c, 3, len);
+	if (!check_bytes(a, 1, len) || !check_bytes(b, 2, len))
+		abort();
+	/* Emitting an event from within the scope does not recycle the arena. */
+	side_event(my_provider_event_dynamic_basic,
+		side_arg_list(side_arg_dynamic_s32(0)));
+	if (!check_bytes(a, 1, len) || !check_bytes(b, 2, len))
+		abort();
+	/* Ending the outermost scope recycles the arena. */
+	side_arena_scope_end();
+	if ((char *) side_arena_alloc(len, 16) != a)
+		abort();
+	side_arena_scope_begin();
+	side_arena_scope_end();
+}
+
 side_static_event(my_provider_event_dynamic_vla,
 	"myprovider", "mydynamicvla", SIDE_LOGLEVEL_DEBUG,
 	side_field_list(
@@ -333,6 +389,88 @@ void test_dynamic_struct(void)
 		side_arg_list(side_arg_dynamic_struct(&mystruct)));
 }
 
+side_static_event(my_provider_event_dynamic_struct_schema,
+	"myprovider", "mydynamicstructschema", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_dynamic("dynamic"),
+	)
+);
+
+/*
+ * The shape and its attributes are only valid within this function:
+ * registration copies them.
+ */
+static
+const struct side_dynamic_struct_schema *register_dynamic_struct_schema(void)
+{
+	side_arg_dynamic_define_struct(shape,
+		side_arg_list(
+			side_arg_dynamic_field("a", side_arg_dynamic_u32(0,
+				side_dynamic_attr_list(side_attr("unit", side_attr_string("ms"))))),
+			side_arg_dynamic_field("b", side_arg_dynamic_string("")),
+			side_arg_dynamic_field("c", side_arg_dynamic_bool(false)),
+		),
+		side_dynamic_attr_list(side_attr("source", side_attr_string("test")))
+	);
+
+	return side_dynamic_struct_schema_register(&shape);
+}
+
+static
+void check_attr_string(const struct side_attr *attr, const char *key, const char *value)
+{
+	struct side_attr_value attr_value = attr->value;
+
+	if (strcmp((const char *) side_ptr_get(attr->key.p), key))
+		abort();
+	if (side_enum_get(attr_value.type) != SIDE_ATTR_TYPE_STRING)
+		abort();
+	if (strcmp((const char *) side_ptr_get(attr_value.u.string_value.p), value))
+		abort();
+}
+
+static
+void check_dynamic_struct_schema(const struct side_dynamic_struct_schema *schema)
+{
+	const struct side_arg_dynamic_struct *shape = side_ptr_get(schema->shape);
+	const struct side_arg_dynamic_field *fields = side_ptr_get(shape->fields);
+
+	if (shape->len != 3 || side_array_length(&shape->attributes) != 1)
+		abort();
+	check_attr_string(side_array_at(&shape->attributes, 0), "source", "test");
+	if (side_array_length(&fields[0].elem.u.side_dynamic.side_integer.type.attributes) != 1)
+		abort();
+	check_attr_string(side_array_at(&fields[0].elem.u.side_dynamic.side_integer.type.attributes, 0),
+		"unit", "ms");
+}
+
+static
+void test_dynamic_struct_schema(void)
+{
+	const struct side_dynamic_struct_schema *schema;
+	int i;
+
+	schema = register_dynamic_struct_schema();
+	if (!schema)
+		abort();
+	check_dynamic_struct_schema(schema);
+	for (i = 0; i < 2; i++) {
+		side_arg_dynamic_define_struct_schema_values(values,
+			side_dynamic_value_list(
+				side_dynamic_value_u32(43 + i),
+				side_dynamic_value_string(i ? "yyy" : "zzz"),
+				side_dynamic_value_bool(i),
+			)
+		);
+
+		side_event(my_provider_event_dynamic_struct_schema,
+			side_arg_list(side_arg_dynamic_struct_schema(schema, values)));
+		/* Literals of the emitting statement may reuse their storage. */
+		check_dynamic_struct_schema(schema);
+	}
+	side_dynamic_struct_schema_unregister(schema);
+}
+
 side_static_event(my_provider_event_dynamic_nested_struct,
 	"myprovider", "mydynamicnestedstruct", SIDE_LOGLEVEL_DEBUG,
 	side_field_list(
@@ -1210,6 +1348,32 @@ void test_fmt_string(void)
 	}
 }
 
+side_static_event(my_provider_event_format,
+	"myprovider", "myeventformat", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_string("str"),
+		side_field_s32("int"),
+		side_field_u64("hex"),
+		side_field_double("float"),
+	),
+	side_attr_list(
+		side_attr_format("str: %s int: %d hex: %#lx float: %.2f %%"),
+	)
+);
+
+static
+void test_format_event(void)
+{
+	side_event(my_provider_event_format,
+		side_arg_list(
+			side_arg_string("blah"),
+			side_arg_s32(-123),
+			side_arg_u64(0xdeadbeef),
+			side_arg_double(3.14159),
+		)
+	);
+}
+
 side_static_event_variadic(my_provider_event_endian, "myprovider", "myevent_endian", SIDE_LOGLEVEL_DEBUG,
 	side_field_list(
 		side_field_u16_le("u16_le"),
@@ -1862,6 +2026,120 @@ void test_gather_vla_flex(void)
 	}
 }
 
+struct testgathervlanest {
+	uint32_t *p;
+	uint16_t len;
+	uint64_t tag;
+};
+
+static uint32_t gathervlanest0[] = { 1, 2 };
+static uint32_t gathervlanest1[] = { 3, 4, 5 };
+
+/*
+ * Records holding a gather VLA, described as gather structures giving
+ * the record size, followed by a field which is not part of the VLA.
+ */
+static side_define_struct(mystructgathervlanest,
+	side_field_list(
+		side_field_gather_vla("values",
+			side_elem(side_type_gather_unsigned_integer(0, sizeof(uint32_t), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT)),
+			offsetof(struct testgathervlanest, p),
+			SIDE_TYPE_GATHER_ACCESS_POINTER,
+			side_length(side_type_gather_unsigned_integer(offsetof(struct testgathervlanest, len),
+					sizeof(uint16_t), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT))
+		),
+		side_field_gather_unsigned_integer("tag", offsetof(struct testgathervlanest, tag),
+			side_struct_field_sizeof(struct testgathervlanest, tag), 0, 0,
+			SIDE_TYPE_GATHER_ACCESS_DIRECT),
+	)
+);
+
+side_static_event(my_provider_event_gathervlanest,
+	"myprovider", "myeventgathervlanest", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_gather_array("arrayvla",
+			side_elem(side_type_gather_struct(mystructgathervlanest, 0,
+				sizeof(struct testgathervlanest), SIDE_TYPE_GATHER_ACCESS_DIRECT)),
+			2, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT
+		),
+		side_field_gather_vla("vlavla",
+			side_elem(side_type_gather_struct(mystructgathervlanest, 0,
+				sizeof(struct testgathervlanest), SIDE_TYPE_GATHER_ACCESS_DIRECT)),
+			0, SIDE_TYPE_GATHER_ACCESS_DIRECT,
+			side_length(side_type_gather_unsigned_integer(0, sizeof(uint16_t), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT))
+		),
+	)
+);
+
+static
+void test_gather_vla_nest(void)
+{
+	if (side_event_enabled(my_provider_event_gathervlanest)) {
+		struct testgathervlanest array[2] = {
+			{ .p = gathervlanest0, .len = SIDE_ARRAY_SIZE(gathervlanest0), .tag = 10, },
+			{ .p = gathervlanest1, .len = SIDE_ARRAY_SIZE(gathervlanest1), .tag = 11, },
+		};
+		uint16_t nr_records = SIDE_ARRAY_SIZE(array);
+
+		side_event_call(my_provider_event_gathervlanest,
+			side_arg_list(
+				side_arg_gather_array(array),
+				side_arg_gather_vla(array, &nr_records),
+			)
+		);
+	}
+}
+
+static char gatheriovec0[] = "hel";
+static char gatheriovec1[] = "lo, ";
+static char gatheriovec2[] = "world";
+
+struct testgatheriovec {
+	struct side_iovec *iov;
+	int iovcnt;
+};
+
+side_static_event(my_provider_event_gatheriovec,
+	"myprovider", "myeventgatheriovec", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_gather_iovec("iov",
+			0, SIDE_TYPE_GATHER_ACCESS_DIRECT,
+			side_length(side_type_gather_signed_integer(0, sizeof(int), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT)),
+			0
+		),
+		side_field_gather_iovec("iovcap",
+			offsetof(struct testgatheriovec, iov), SIDE_TYPE_GATHER_ACCESS_POINTER,
+			side_length(side_type_gather_signed_integer(offsetof(struct testgatheriovec, iovcnt),
+					sizeof(int), 0, 0, SIDE_TYPE_GATHER_ACCESS_DIRECT)),
+			5
+		),
+	)
+);
+
+static
+void test_gather_iovec(void)
+{
+	if (side_event_enabled(my_provider_event_gatheriovec)) {
+		struct side_iovec iov[3] = {
+			{ .base = SIDE_PTR_INIT(gatheriovec0), .len = strlen(gatheriovec0), },
+			{ .base = SIDE_PTR_INIT(gatheriovec1), .len = strlen(gatheriovec1), },
+			{ .base = SIDE_PTR_INIT(gatheriovec2), .len = strlen(gatheriovec2), },
+		};
+		struct testgatheriovec mystruct = {
+			.iov = iov,
+			.iovcnt = 3,
+		};
+		int iovcnt = 3;
+
+		side_event_call(my_provider_event_gatheriovec,
+			side_arg_list(
+				side_arg_gather_iovec(iov, &iovcnt),
+				side_arg_gather_iovec(&mystruct, &mystruct),
+			)
+		);
+	}
+}
+
 side_static_event(my_provider_event_gatherbyte,
 	"myprovider", "myeventgatherbyte", SIDE_LOGLEVEL_DEBUG,
 	side_field_list(
@@ -2362,6 +2640,488 @@ static void test_vla_of_struct(void)
 	}
 }
 
+static side_define_struct(my_struct_fingerprint,
+	side_field_list(
+		side_field_u32("x"),
+	)
+);
+
+side_static_event(my_provider_event_fingerprint1, "myprovider", "myeventfingerprint", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_struct("struct", my_struct_fingerprint),
+		side_field_string("s", side_attr_list(side_attr("user_attribute_a", side_attr_string("val1")))),
+	)
+);
+
+side_static_event(my_provider_event_fingerprint2, "myprovider", "myeventfingerprint", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_struct("struct", my_struct_fingerprint),
+		side_field_string("s", side_attr_list(side_attr("user_attribute_a", side_attr_string("val1")))),
+	)
+);
+
+side_static_event(my_provider_event_fingerprint3, "myprovider", "myeventfingerprint", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_struct("struct", my_struct_fingerprint),
+		side_field_string("s", side_attr_list(side_attr("user_attribute_a", side_attr_string("val2")))),
+	)
+);
+
+static
+void test_fingerprint(void)
+{
+	uint64_t fp1, fp2, fp3;
+
+	if (side_event_description_fingerprint(&my_provider_event_fingerprint1, &fp1)
+			|| side_event_description_fingerprint(&my_provider_event_fingerprint2, &fp2)
+			|| side_event_description_fingerprint(&my_provider_event_fingerprint3, &fp3))
+		abort();
+	/* Identical descriptions at distinct addresses. */
+	if (fp1 != fp2)
+		abort();
+	/* Descriptions differing only by an attribute value. */
+	if (fp1 == fp3)
+		abort();
+}
+
+side_static_event(my_provider_event_lazy,
+	"myprovider", "mylazy", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("value"),
+		side_field_string("formatted"),
+	)
+);
+
+struct lazy_ctx {
+	uint32_t value;
+	char formatted[32];
+};
+
+static
+void lazy_fill(struct side_arg *sav, uint32_t len, void *priv)
+{
+	struct lazy_ctx *ctx = (struct lazy_ctx *) priv;
+
+	/* Only formatted when the event has consumers. */
+	snprintf(ctx->formatted, sizeof(ctx->formatted), "value=%" PRIu32, ctx->value);
+	side_arg_fill(my_provider_event_lazy, sav, len, side_arg_list(side_arg_u32(ctx->value), side_arg_string(ctx->formatted)));
+}
+
+static
+void test_event_lazy(void)
+{
+	struct lazy_ctx ctx = { .value = 42, .formatted = "" };
+
+	side_event_lazy(my_provider_event_lazy, lazy_fill, &ctx);
+}
+
+side_static_event(my_provider_event_batch,
+	"myprovider", "mybatch", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("index"),
+		side_field_s64("value"),
+	)
+);
+
+static
+void test_event_batch(void)
+{
+	struct side_arg sav[4][2];
+	struct side_arg_vec vecs[4];
+	uint32_t i;
+
+	if (!side_event_enabled(my_provider_event_batch))
+		return;
+	for (i = 0; i < 4; i++) {
+		side_arg_fill(my_provider_event_batch, sav[i], 2, side_arg_list(side_arg_u32(i), side_arg_s64(-(int64_t) i)));
+		side_ptr_set(vecs[i].sav, sav[i]);
+		vecs[i].len = 2;
+	}
+	side_event_call_batch(my_provider_event_batch, vecs, 4);
+}
+
+side_static_event(my_provider_event_callback_stats,
+	"myprovider", "mycallbackstats", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("value"),
+	)
+);
+
+struct callback_stats_counter {
+	const struct side_event_description *desc;
+	uint64_t nr_samples;
+};
+
+static
+void callback_stats_count(const struct side_callback_stats *stats, void *priv)
+{
+	struct callback_stats_counter *count = (struct callback_stats_counter *) priv;
+
+	if (stats->desc == count->desc)
+		count->nr_samples += stats->nr_samples;
+}
+
+static unsigned int nr_callback_stats_event_inserted;
+
+static
+void callback_stats_event_notification(enum side_tracer_notification notif,
+		struct side_event_description **events, uint32_t nr_events,
+		void *priv __attribute__((unused)))
+{
+	uint32_t i;
+
+	if (notif != SIDE_TRACER_NOTIFICATION_INSERT_EVENTS)
+		return;
+	for (i = 0; i < nr_events; i++) {
+		if (events[i] && !strcmp(side_ptr_get(events[i]->provider_name), "side") &&
+				!strcmp(side_ptr_get(events[i]->event_name), "callback_stats"))
+			nr_callback_stats_event_inserted++;
+	}
+}
+
+static
+void test_callback_stats(void)
+{
+	struct callback_stats_counter count = { &my_provider_event_callback_stats, 0 };
+	struct callback_stats_counter batch_count = { &my_provider_event_batch, 0 };
+	struct side_tracer_handle *handle;
+	uint32_t i;
+
+	if (!side_event_enabled(my_provider_event_callback_stats))
+		return;
+	/* The statistics event is registered when statistics are first enabled. */
+	handle = side_tracer_event_notification_register(callback_stats_event_notification, NULL);
+	if (!handle)
+		abort();
+	if (nr_callback_stats_event_inserted)
+		abort();
+	if (side_tracer_callback_stats_enable(1))
+		abort();
+	if (nr_callback_stats_event_inserted != 1)
+		abort();
+	side_tracer_event_notification_unregister(handle);
+	for (i = 0; i < 4; i++)
+		side_event(my_provider_event_callback_stats, side_arg_list(side_arg_u32(i)));
+	test_event_batch();
+	if (side_tracer_callback_stats_enable(0))
+		abort();
+	if (side_tracer_callback_stats_iterate(callback_stats_count, &count))
+		abort();
+	/* Every call is sampled, once per registered callback. */
+	if (count.nr_samples < 4)
+		abort();
+	/* Batches are sampled too. */
+	if (side_tracer_callback_stats_iterate(callback_stats_count, &batch_count))
+		abort();
+	if (side_event_enabled(my_provider_event_batch) && !batch_count.nr_samples)
+		abort();
+}
+
+static
+void *arena_thread_fn(void *arg)
+{
+	uint64_t before = *(uint64_t *) arg;
+	struct side_memory_usage usage;
+
+	(void) side_arena_alloc(1, 1);
+	side_tracer_memory_usage(&usage);
+	if (usage.arena <= before)
+		abort();
+	return NULL;
+}
+
+/* The arena buffer is accounted from its first use until thread exit. */
+static
+void test_memory_usage_arena(void)
+{
+	struct side_memory_usage usage;
+	pthread_t thread;
+	uint64_t before;
+
+	side_tracer_memory_usage(&usage);
+	before = usage.arena;
+	if (pthread_create(&thread, NULL, arena_thread_fn, &before))
+		abort();
+	if (pthread_join(thread, NULL))
+		abort();
+	side_tracer_memory_usage(&usage);
+	if (usage.arena != before)
+		abort();
+}
+
+static
+void test_memory_usage(void)
+{
+	struct side_memory_usage usage;
+
+	side_tracer_memory_usage(&usage);
+	/* The test tracer registered its handle, and events are registered. */
+	if (!usage.registration)
+		abort();
+	if (side_event_enabled(my_provider_event_callback_stats) && (!usage.callbacks || !usage.rcu))
+		abort();
+	side_tracer_memory_usage_add(4096);
+	side_tracer_memory_usage(&usage);
+	if (usage.tracer != 4096)
+		abort();
+	side_tracer_memory_usage_add(-4096);
+	side_tracer_memory_usage(&usage);
+	if (usage.tracer)
+		abort();
+	test_memory_usage_arena();
+}
+
+struct testcapture {
+	uint64_t pad;
+	uint32_t a;
+	struct {
+		uint16_t x;
+		uint32_t y;
+	} inner;
+};
+
+static side_define_struct(mystructcaptureinner,
+	side_field_list(
+		side_field_gather_unsigned_integer("y", offsetof(struct testcapture, inner.y) - offsetof(struct testcapture, inner),
+			side_struct_field_sizeof(struct testcapture, inner.y), 0, 0,
+			SIDE_TYPE_GATHER_ACCESS_DIRECT),
+	)
+);
+
+side_static_event(my_provider_event_gather_capture,
+	"myprovider", "myeventgathercapture", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_gather_unsigned_integer("a", offsetof(struct testcapture, a),
+			side_struct_field_sizeof(struct testcapture, a), 0, 0,
+			SIDE_TYPE_GATHER_ACCESS_DIRECT),
+		side_field_gather_struct("inner", mystructcaptureinner, offsetof(struct testcapture, inner),
+			side_struct_field_sizeof(struct testcapture, inner), SIDE_TYPE_GATHER_ACCESS_DIRECT),
+		side_field_u32("count"),
+	)
+);
+
+static struct side_gather_capture_plan *gather_capture_plan;
+static char gather_capture_buf[256];
+static struct side_arg gather_capture_sav[3];
+
+static
+void gather_capture_cb(const struct side_event_description *desc,
+		const struct side_arg_vec *side_arg_vec,
+		void *priv __attribute__((unused)),
+		void *caller_addr __attribute__((unused)))
+{
+	gather_capture_plan = side_gather_capture_plan_create(desc);
+	if (!gather_capture_plan)
+		abort();
+	if (side_gather_capture_plan_size(gather_capture_plan) > sizeof(gather_capture_buf))
+		abort();
+	if (side_gather_capture(gather_capture_plan, side_arg_vec,
+			gather_capture_buf, sizeof(gather_capture_buf)))
+		abort();
+}
+
+/*
+ * Capture an event, modify the application data, then decode the
+ * captured copy and check it holds the values at the time of the event.
+ */
+static
+void test_gather_capture(void)
+{
+	struct testcapture cap = {
+		.pad = 0,
+		.a = 42,
+		.inner = { .x = 1, .y = 0xDEADBEEF },
+	};
+	const struct side_event_description *desc;
+	const struct side_event_field *field;
+	const struct side_type_struct *side_struct;
+	const char *ptr;
+	uint32_t value;
+	uint64_t key;
+
+	if (side_tracer_request_key(&key))
+		abort();
+	if (side_tracer_callback_register(&my_provider_event_gather_capture, gather_capture_cb, NULL, key))
+		abort();
+	side_event(my_provider_event_gather_capture,
+		side_arg_list(
+			side_arg_gather_integer(&cap),
+			side_arg_gather_struct(&cap),
+			side_arg_u32(7),
+		)
+	);
+	if (side_tracer_callback_unregister(&my_provider_event_gather_capture, gather_capture_cb, NULL, key))
+		abort();
+	if (!gather_capture_plan)
+		abort();
+	cap.a = 0;
+	cap.inner.y = 0;
+	if (side_gather_capture_decode(gather_capture_plan, gather_capture_buf, sizeof(gather_capture_buf),
+			gather_capture_sav, 3))
+		abort();
+	desc = side_gather_capture_plan_description(gather_capture_plan);
+	/* Each gather field is captured from its offset to its last referenced byte. */
+	if (side_gather_capture_plan_size(gather_capture_plan) != sizeof(uint32_t) +
+			offsetof(struct testcapture, inner.y) - offsetof(struct testcapture, inner) +
+			sizeof(uint32_t) + sizeof(uint32_t))
+		abort();
+
+	field = side_array_at(&desc->fields, 0);
+	ptr = (const char *) side_ptr_get(gather_capture_sav[0].u.side_static.side_integer_gather_ptr);
+	if (ptr != gather_capture_buf)
+		abort();
+	memcpy(&value, ptr + field->side_type.u.side_gather.u.side_integer.offset, sizeof(value));
+	if (value != 42)
+		abort();
+
+	field = side_array_at(&desc->fields, 1);
+	side_struct = side_ptr_get(field->side_type.u.side_gather.u.side_struct.type);
+	ptr = (const char *) side_ptr_get(gather_capture_sav[1].u.side_static.side_struct_gather_ptr);
+	if (ptr < gather_capture_buf || ptr >= gather_capture_buf + sizeof(gather_capture_buf))
+		abort();
+	memcpy(&value, ptr + field->side_type.u.side_gather.u.side_struct.offset +
+		(side_array_at(&side_struct->fields, 0))->side_type.u.side_gather.u.side_integer.offset,
+		sizeof(value));
+	if (value != 0xDEADBEEF)
+		abort();
+
+	if (side_enum_get(gather_capture_sav[2].type) != SIDE_TYPE_U32 ||
+			gather_capture_sav[2].u.side_static.integer_value.side_u32 != 7)
+		abort();
+
+	/* Arguments which do not match the description are rejected. */
+	{
+		struct side_arg bad_sav[3];
+		const struct side_arg_vec bad_vec = {
+			.sav = SIDE_PTR_INIT(bad_sav),
+			.len = 3,
+		};
+
+		memcpy(bad_sav, gather_capture_sav, sizeof(bad_sav));
+		side_enum_set(bad_sav[1].type, SIDE_TYPE_U32);
+		if (side_gather_capture(gather_capture_plan, &bad_vec,
+				gather_capture_buf, sizeof(gather_capture_buf)) != SIDE_ERROR_INVAL)
+			abort();
+	}
+	side_gather_capture_plan_destroy(gather_capture_plan);
+}
+
+side_static_event(my_provider_event_multi_callback,
+	"myprovider", "myeventmulticallback", SIDE_LOGLEVEL_DEBUG,
+	side_field_list(
+		side_field_u32("value"),
+	)
+);
+
+static
+void multi_callback_cb(const struct side_event_description *desc __attribute__((unused)),
+		const struct side_arg_vec *side_arg_vec,
+		void *priv,
+		void *caller_addr __attribute__((unused)))
+{
+	const struct side_arg *sav = side_ptr_get(side_arg_vec->sav);
+
+	if (side_arg_vec->len != 1 || sav[0].u.side_static.integer_value.side_u32 != 42)
+		abort();
+	(*(unsigned int *) priv)++;
+}
+
+/*
+ * Register several callbacks on one event, and check each of them is
+ * invoked after registrations and after removal of a callback in the
+ * middle of the callback array.
+ */
+static
+void test_multi_callback(void)
+{
+	unsigned int count[3] = { 0, 0, 0 };
+	uint64_t key;
+	int i;
+
+	if (side_tracer_request_key(&key))
+		abort();
+	for (i = 0; i < 3; i++) {
+		if (side_tracer_callback_register(&my_provider_event_multi_callback,
+				multi_callback_cb, &count[i], key))
+			abort();
+	}
+	side_event(my_provider_event_multi_callback, side_arg_list(side_arg_u32(42)));
+	if (count[0] != 1 || count[1] != 1 || count[2] != 1)
+		abort();
+	if (side_tracer_callback_unregister(&my_provider_event_multi_callback,
+			multi_callback_cb, &count[1], key))
+		abort();
+	side_event(my_provider_event_multi_callback, side_arg_list(side_arg_u32(42)));
+	if (count[0] != 2 || count[1] != 1 || count[2] != 2)
+		abort();
+	if (side_tracer_callback_unregister(&my_provider_event_multi_callback,
+			multi_callback_cb, &count[0], key))
+		abort();
+	if (side_tracer_callback_unregister(&my_provider_event_multi_callback,
+			multi_callback_cb, &count[2], key))
+		abort();
+	side_event(my_provider_event_multi_callback, side_arg_list(side_arg_u32(42)));
+	if (count[0] != 2 || count[1] != 1 || count[2] != 2)
+		abort();
+}
+
+/*
+ * Instrumentation built against event state ABI version 0 headers keeps
+ * the enabled word in the event state.
+ */
+static
+void test_event_state_0(void)
+{
+	static struct side_event_state_0 state0;
+	static struct side_event_description desc0;
+	struct side_event_description *descs[] = { &desc0 };
+	struct side_events_register_handle *handle;
+	unsigned int count = 0;
+	uint64_t key;
+
+	state0.parent.version = 0;
+	state0.callbacks = (const struct side_callback *) &side_empty_callback[0];
+	state0.desc = &desc0;
+	desc0 = my_provider_event_multi_callback;
+	side_ptr_set(desc0.state, &state0.parent);
+	handle = side_events_register(descs, 1);
+	if (!handle)
+		abort();
+	if (side_tracer_request_key(&key))
+		abort();
+	if (side_tracer_callback_register(&desc0, multi_callback_cb, &count, key))
+		abort();
+	if (!state0.enabled)
+		abort();
+	{
+		side_arg_define_array(vec, side_arg_list(side_arg_u32(42)));
+
+		side_call(&state0.parent, &vec);
+	}
+	if (count != 1)
+		abort();
+	if (side_tracer_callback_unregister(&desc0, multi_callback_cb, &count, key))
+		abort();
+	side_events_unregister(handle);
+}
+
+side_static_span_event(my_provider_event_span,
+	"myprovider", "myspan", SIDE_LOGLEVEL_DEBUG
+);
+
+static
+void test_span(void)
+{
+	int i;
+
+	for (i = 0; i < 3; i++) {
+		side_span(my_provider_event_span);
+
+		side_event(my_provider_event_dynamic_basic,
+			side_arg_list(side_arg_dynamic_s32(i)));
+	}
+}
+
 int main()
 {
 	test_fields();
@@ -2373,9 +3133,12 @@ int main()
 	test_vla_visitor();
 	test_vla_visitor_2d();
 	test_dynamic_basic_type();
+	test_dynamic_loop();
+	test_arena_overflow();
 	test_dynamic_vla();
 	test_dynamic_null();
 	test_dynamic_struct();
+	test_dynamic_struct_schema();
 	test_dynamic_nested_struct();
 	test_dynamic_vla_struct();
 	test_dynamic_struct_vla();
@@ -2397,6 +3160,7 @@ int main()
 	test_enum_bitmap();
 	test_blob();
 	test_fmt_string();
+	test_format_event();
 	test_endian();
 	test_base();
 	test_struct_gather();
@@ -2406,6 +3170,8 @@ int main()
 	test_gather_structnest();
 	test_gather_vla();
 	test_gather_vla_flex();
+	test_gather_vla_nest();
+	test_gather_iovec();
 	test_gather_byte();
 	test_gather_bool();
 	test_gather_pointer();
@@ -2418,5 +3184,14 @@ int main()
 	test_optional();
 	test_nested_struct();
 	test_vla_of_struct();
+	test_fingerprint();
+	test_span();
+	test_event_lazy();
+	test_event_batch();
+	test_callback_stats();
+	test_memory_usage();
+	test_gather_capture();
+	test_multi_callback();
+	test_event_state_0();
 	return 0;
 }
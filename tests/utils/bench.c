@@ -0,0 +1,100 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+
+static
+void print_help(const struct bench_option *options, unsigned int nr_options)
+{
+	unsigned int i;
+
+	printf("Invoke with command line arguments:\n");
+	for (i = 0; i < nr_options; i++)
+		printf("	-%c %s\n", options[i].name, options[i].help);
+}
+
+static
+void set_option(const struct bench_option *option, const char *arg)
+{
+	switch (option->type) {
+	case BENCH_OPTION_INT:
+		*(int *) option->value = atoi(arg);
+		break;
+	case BENCH_OPTION_ULONG:
+		*(unsigned long *) option->value = strtoul(arg, NULL, 10);
+		break;
+	case BENCH_OPTION_U64:
+		*(uint64_t *) option->value = strtoull(arg, NULL, 10);
+		break;
+	case BENCH_OPTION_STRING:
+		*(const char **) option->value = arg;
+		break;
+	default:
+		abort();
+	}
+}
+
+int bench_parse_cmd_line(int argc, const char **argv,
+		const struct bench_option *options, unsigned int nr_options)
+{
+	const char *arg = NULL;
+	unsigned int j;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		arg = argv[i];
+
+		if (arg[0] != '-' || arg[1] == '\0' || arg[2] != '\0')
+			goto error;
+		if (arg[1] == 'h') {
+			print_help(options, nr_options);
+			return 1;
+		}
+		for (j = 0; j < nr_options; j++) {
+			if (options[j].name == arg[1])
+				break;
+		}
+		if (j == nr_options)
+			goto error;
+		if (i == argc - 1)
+			goto error_extra_arg;
+		set_option(&options[j], argv[++i]);
+	}
+	return 0;
+
+error:
+	fprintf(stderr, "Unknown command line option '%s'\n", arg);
+	return -1;
+error_extra_arg:
+	fprintf(stderr, "Command line option '%s' requires an extra argument\n", arg);
+	return -1;
+}
+
+uint64_t bench_now_ns(void)
+{
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts))
+		abort();
+	return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+void bench_disable_demo_tracer(const char **argv)
+{
+	if (getenv("SIDE_TRACER_DISABLE"))
+		return;
+	if (setenv("SIDE_TRACER_DISABLE", "1", 1))
+		abort();
+	/* Do not cut the demo tracer output of this image mid-line. */
+	fflush(NULL);
+	execv("/proc/self/exe", (char * const *) argv);
+	perror("execv");
+	abort();
+}
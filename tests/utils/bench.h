@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+/*
+ * Copyright 2024 Mathieu Desnoyers <mathieu.desnoyers@efficios.com>
+ */
+
+#ifndef _SIDE_TESTS_BENCH_H
+#define _SIDE_TESTS_BENCH_H
+
+#include <stdint.h>
+
+/*
+ * Helpers shared by the benchmarks.
+ */
+
+enum bench_option_type {
+	BENCH_OPTION_INT,
+	BENCH_OPTION_ULONG,
+	BENCH_OPTION_U64,
+	BENCH_OPTION_STRING,
+};
+
+/*
+ * Command line option "-<name> <argument>", whose argument is stored
+ * into "value", of type int, unsigned long, uint64_t or const char *.
+ * "help" describes the argument, e.g. "<iterations> (number of events)".
+ */
+struct bench_option {
+	char name;
+	enum bench_option_type type;
+	void *value;
+	const char *help;
+};
+
+/*
+ * Parse the command line options. "-h" prints the help of the options.
+ * Returns 0 on success, 1 if the help was printed, or -1 on error.
+ */
+int bench_parse_cmd_line(int argc, const char **argv,
+		const struct bench_option *options, unsigned int nr_options);
+
+/* CLOCK_MONOTONIC time, in nanoseconds. */
+uint64_t bench_now_ns(void);
+
+/*
+ * Re-execute the benchmark with SIDE_TRACER_DISABLE set, which keeps
+ * the demo tracer built into libside out of the measurements. Returns
+ * if it is already set. Call it first in main(), before any output, so
+ * the TAP stream is only produced by the re-executed benchmark.
+ */
+void bench_disable_demo_tracer(const char **argv);
+
+#endif /* _SIDE_TESTS_BENCH_H */